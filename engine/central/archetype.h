@@ -1,8 +1,15 @@
 #pragma once
 #include "engine/central/toolbox.h"
+#include "engine/central/group.h"
 #include "engine/central/storage.h"
+#include "engine/central/thread_pool.h"
 #include "engine/nekolib/templates/type_union.h"
+#include <cassert>
+#include <chrono>
 #include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
 #include <vector>
 
 
@@ -17,17 +24,89 @@ struct Archetype
 	using exclude_types = type_union_t<typename Predicates::exclude_types...>;
 	using consume_types = type_union_t<typename Predicates::consume_types...>;
 	using produce_types = type_union_t<typename Predicates::produce_types...>;
+	using changed_types = type_union_t<typename Predicates::changed_types...>;
+	using added_types = type_union_t<typename Predicates::added_types...>;
+	using owned_types = type_union_t<typename Predicates::owned_types...>;
 
-	static auto iterate(EntityMapping& mapping)
+	// Does the iteration only visit entities with new or changed components?
+	static constexpr bool is_filtered = std::tuple_size_v<changed_types> > 0
+		|| std::tuple_size_v<added_types> > 0;
+
+	// Does the iteration change which components entities have?
+	static constexpr bool is_structural = std::tuple_size_v<consume_types> > 0
+		|| std::tuple_size_v<produce_types> > 0;
+
+	// The components that systems using this archetype read or write.
+	// Structural changes notify listeners shared by all storages, like the
+	// signatures, so structural archetypes also write the entity resource.
+	// Iterating an owning group never reorders the owned storages, groups
+	// are rebuilt by loads and rollbacks, so Own<const T> only reads T.
+	using read_types = type_union_t<include_types, exclude_types>;
+	using write_types = type_union_t<mutable_types_t<iterate_types>, consume_types, produce_types,
+		std::conditional_t<is_structural, std::tuple<Entity>, std::tuple<>>>;
+
+	// Does the iteration scan the packed range of an owning group?
+	static constexpr bool is_grouped = std::tuple_size_v<owned_types> > 0;
+
+	static void prepare(EntityMapping& mapping, uint64_t system)
 	{
-		std::vector<Entity> includes = search_entities<include_types>(mapping);
-		std::vector<Entity> excludes = search_entities<exclude_types>(mapping);
-		std::vector<Entity> entities;
-		std::set_difference(includes.begin(), includes.end(),
-			excludes.begin(), excludes.end(), std::back_inserter(entities));
-		remove_entity_tags<consume_types>(entities);
-		update_entity_tags<produce_types>(entities);
-		return EntityIterator<iterate_types>(mapping, entities, 0);
+		if constexpr (is_grouped) {
+			mapping.group<owned_types, include_types, exclude_types>();
+		} else {
+			mapping.query<include_types, exclude_types>();
+		}
+		if constexpr (is_filtered) {
+			mapping.last_run(typeid(Archetype), system);
+		}
+	}
+
+	static auto iterate(EntityMapping& mapping, uint64_t system)
+	{
+		if constexpr (is_grouped) {
+			static_assert(!is_filtered && !is_structural, "Owned components can't be filtered or tagged");
+			auto start = std::chrono::steady_clock::now();
+			auto& group = mapping.group<owned_types, include_types, exclude_types>();
+			// Groups are rebuilt by loads and rollbacks, so iterating them
+			// only reads them and read-only systems may share a stage.
+			assert(group.packed());
+			group.record_search(elapsed_nanoseconds(start));
+			return GroupIterator<iterate_types, owned_types>(mapping, group.keys(), mapping.tick());
+		} else {
+			auto start = std::chrono::steady_clock::now();
+			auto& query = mapping.query<include_types, exclude_types>();
+			std::pmr::vector<uint64_t> entities = search_entities(mapping, query);
+			uint64_t tick = mapping.tick();
+			if constexpr (is_filtered) {
+				// Changes made by this iteration are stamped with this tick and
+				// are therefore not visible to the next one.
+				tick = mapping.advance();
+				uint64_t last_run = std::exchange(mapping.last_run(typeid(Archetype), system), tick);
+				filter_entities<changed_types, added_types>(mapping, entities, last_run);
+			}
+			query.record_search(elapsed_nanoseconds(start));
+			remove_entity_tags<consume_types>(mapping, entities);
+			update_entity_tags<produce_types>(mapping, entities);
+			return EntityIterator<iterate_types>(mapping, std::move(entities), tick);
+		}
+	}
+
+	static auto columns(EntityMapping& mapping)
+	{
+		static_assert(is_grouped, "Only owned components can be accessed as columns");
+		return iterate(mapping, running_system).columns();
+	}
+
+	template <typename Function>
+	static void par_iterate(EntityMapping& mapping, Function function, uint64_t grain, uint64_t system)
+	{
+		static_assert(!is_structural, "Consume and Produce are not allowed in parallel");
+		auto entities = iterate(mapping, system);
+		entities.unshare();
+		ThreadPool::global().parallel_for(entities.size(), grain, [&](uint64_t begin, uint64_t end) {
+			for (uint64_t i = begin; i < end; i++) {
+				std::apply(function, entities[i]);
+			}
+		});
 	}
 };
 
@@ -35,10 +114,13 @@ template <typename ... T>
 struct Iterate
 {
 	using iterate_types = std::tuple<T...>;
-	using include_types = std::tuple<T...>;
+	using include_types = std::tuple<std::remove_const_t<T>...>;
 	using exclude_types = std::tuple<>;
 	using consume_types = std::tuple<>;
 	using produce_types = std::tuple<>;
+	using changed_types = std::tuple<>;
+	using added_types = std::tuple<>;
+	using owned_types = std::tuple<>;
 };
 
 template <typename ... T>
@@ -49,6 +131,9 @@ struct Require
 	using exclude_types = std::tuple<>;
 	using consume_types = std::tuple<>;
 	using produce_types = std::tuple<>;
+	using changed_types = std::tuple<>;
+	using added_types = std::tuple<>;
+	using owned_types = std::tuple<>;
 };
 
 template <typename ... T>
@@ -59,6 +144,9 @@ struct Exclude
 	using exclude_types = std::tuple<T...>;
 	using consume_types = std::tuple<>;
 	using produce_types = std::tuple<>;
+	using changed_types = std::tuple<>;
+	using added_types = std::tuple<>;
+	using owned_types = std::tuple<>;
 };
 
 template <typename ... T>
@@ -69,6 +157,9 @@ struct Consume
 	using exclude_types = std::tuple<>;
 	using consume_types = std::tuple<T...>;
 	using produce_types = std::tuple<>;
+	using changed_types = std::tuple<>;
+	using added_types = std::tuple<>;
+	using owned_types = std::tuple<>;
 };
 
 template <typename ... T>
@@ -79,6 +170,9 @@ struct Produce
 	using exclude_types = std::tuple<T...>;
 	using consume_types = std::tuple<>;
 	using produce_types = std::tuple<T...>;
+	using changed_types = std::tuple<>;
+	using added_types = std::tuple<>;
+	using owned_types = std::tuple<>;
 };
 
 template <typename ... T>
@@ -86,9 +180,54 @@ struct Calculate
 {
 	using iterate_types = std::tuple<T...>;
 	using include_types = std::tuple<>;
-	using exclude_types = std::tuple<T...>;
+	using exclude_types = std::tuple<std::remove_const_t<T>...>;
 	using consume_types = std::tuple<>;
-	using produce_types = std::tuple<T...>;
+	using produce_types = std::tuple<std::remove_const_t<T>...>;
+	using changed_types = std::tuple<>;
+	using added_types = std::tuple<>;
+	using owned_types = std::tuple<>;
+};
+
+// Only entities whose components changed since the last iteration.
+template <typename ... T>
+struct Changed
+{
+	using iterate_types = std::tuple<>;
+	using include_types = std::tuple<T...>;
+	using exclude_types = std::tuple<>;
+	using consume_types = std::tuple<>;
+	using produce_types = std::tuple<>;
+	using changed_types = std::tuple<T...>;
+	using added_types = std::tuple<>;
+	using owned_types = std::tuple<>;
+};
+
+// Only entities whose components were added since the last iteration.
+template <typename ... T>
+struct Added
+{
+	using iterate_types = std::tuple<>;
+	using include_types = std::tuple<T...>;
+	using exclude_types = std::tuple<>;
+	using consume_types = std::tuple<>;
+	using produce_types = std::tuple<>;
+	using changed_types = std::tuple<>;
+	using added_types = std::tuple<T...>;
+	using owned_types = std::tuple<>;
+};
+
+// Iterates the components like Iterate, packed by an owning group.
+template <typename ... T>
+struct Own
+{
+	using iterate_types = std::tuple<T...>;
+	using include_types = std::tuple<std::remove_const_t<T>...>;
+	using exclude_types = std::tuple<>;
+	using consume_types = std::tuple<>;
+	using produce_types = std::tuple<>;
+	using changed_types = std::tuple<>;
+	using added_types = std::tuple<>;
+	using owned_types = std::tuple<std::remove_const_t<T>...>;
 };
 
 }
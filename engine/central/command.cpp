@@ -0,0 +1,72 @@
+#include "engine/central/command.h"
+#include "engine/central/family.h"
+
+
+namespace kodanuki
+{
+
+Entity CommandBuffer::create(Entity parent)
+{
+	Entity entity = world.reserve();
+	created.emplace_back(entity, parent);
+	return entity;
+}
+
+void CommandBuffer::destroy(Entity entity)
+{
+	destroyed.push_back(entity);
+}
+
+void CommandBuffer::append(CommandBuffer& other)
+{
+	if (other.commands.size() > commands.size()) {
+		commands.resize(other.commands.size());
+	}
+	for (std::size_t id = 0; id < other.commands.size(); id++) {
+		if (!other.commands[id]) {
+			continue;
+		}
+		if (!commands[id]) {
+			std::swap(commands[id], other.commands[id]);
+			continue;
+		}
+		commands[id]->append(*other.commands[id]);
+	}
+	created.insert(created.end(), other.created.begin(), other.created.end());
+	destroyed.insert(destroyed.end(), other.destroyed.begin(), other.destroyed.end());
+	other.created.clear();
+	other.destroyed.clear();
+}
+
+void CommandBuffer::apply()
+{
+	// The parent may be reserved by a buffer that was merged later, so
+	// every entity is created as a root before the parents are linked.
+	for (auto [entity, parent] : created) {
+		world.families.insert(entity.value());
+		world.update<Entity>(entity, entity);
+		world.update<Family>(entity, {world, entity});
+	}
+	for (auto [entity, parent] : created) {
+		// Entities whose parent was removed in the meantime stay roots.
+		if (world.alive(parent) && world.families.contains(parent.value())) {
+			world.families.set_parent(entity.value(), parent.value());
+		}
+	}
+	created.clear();
+	for (std::unique_ptr<BaseCommands>& typed : commands) {
+		if (typed && !typed->empty()) {
+			typed->apply(world);
+		}
+	}
+	world.clear(destroyed);
+	destroyed.clear();
+}
+
+bool CommandBuffer::empty() const noexcept
+{
+	return created.empty() && destroyed.empty() && std::ranges::all_of(commands,
+		[](const auto& typed) { return !typed || typed->empty(); });
+}
+
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include "engine/central/entity.h"
+#include "engine/central/storage.h"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+
+namespace kodanuki
+{
+
+/**
+ * The command buffer records structural changes and applies them later.
+ *
+ * Creating and removing entities or adding and removing components changes
+ * the storages that other systems might be iterating at the same time.
+ * Systems record these changes instead and the world applies them at the
+ * next sync point, see World::commands() and World::flush().
+ *
+ * The changes to one component type are sorted by entity and applied in a
+ * single pass over its storage. Changes to the same entity and component
+ * keep the order in which they were recorded. Entities are created before
+ * and removed after all component changes.
+ */
+class CommandBuffer
+{
+public:
+	/**
+	 * Creates an empty buffer for the given world.
+	 *
+	 * @param world The world in which the commands are applied.
+	 */
+	explicit CommandBuffer(World& world) : world(world) {}
+
+	/**
+	 * Reserves a new entity which is created once the buffer is applied.
+	 *
+	 * The returned identifier can be used by other commands right away.
+	 * Reserving entities is thread-safe.
+	 *
+	 * @param parent The potential parent for this entity.
+	 * @return The reserved entity.
+	 */
+	Entity create(Entity parent = std::nullopt);
+
+	/**
+	 * Records the removal of the entity and all its components.
+	 *
+	 * @param entity The entity that should be removed.
+	 */
+	void destroy(Entity entity);
+
+	/**
+	 * Records the update of the component inside the entity.
+	 *
+	 * @param T The type of the component.
+	 * @param entity The entity to update the component.
+	 * @param component The value of the component.
+	 */
+	template <typename T>
+	void update(Entity entity, T component = {})
+	{
+		get<T>().changes.emplace_back(entity.value(), std::move(component));
+	}
+
+	/**
+	 * Records the component constructed from the arguments.
+	 *
+	 * The component is constructed right away and moved into the storage
+	 * once the buffer is applied.
+	 *
+	 * @param T The type of the component.
+	 * @param entity The entity to update the component.
+	 * @param args The arguments for the constructor of the component.
+	 */
+	template <typename T, typename ... Args>
+	void emplace(Entity entity, Args&& ... args)
+	{
+		get<T>().changes.emplace_back(std::piecewise_construct, std::forward_as_tuple(entity.value()),
+			std::forward_as_tuple(std::in_place, std::forward<Args>(args)...));
+	}
+
+	/**
+	 * Records the removal of the component from the entity.
+	 *
+	 * Removing the Entity component removes the entity, see destroy().
+	 *
+	 * @param T The type of the component.
+	 * @param entity The entity to remove the component.
+	 */
+	template <typename T>
+	void remove(Entity entity)
+	{
+		if constexpr (std::is_same<T, Entity>()) {
+			destroy(entity);
+		} else {
+			get<T>().changes.emplace_back(entity.value(), std::nullopt);
+		}
+	}
+
+	/**
+	 * Moves the commands of the other buffer behind the ones of this buffer.
+	 *
+	 * @param other The buffer whose commands are moved.
+	 */
+	void append(CommandBuffer& other);
+
+	/**
+	 * Applies all recorded commands and clears the buffer.
+	 *
+	 * Commands for entities that were removed in the meantime are skipped.
+	 * Reserved entities are linked to their parents once all of them were
+	 * created, so a parent may be reserved by any of the merged buffers.
+	 */
+	void apply();
+
+	/**
+	 * @return Does the buffer contain no commands?
+	 */
+	bool empty() const noexcept;
+
+private:
+	struct BaseCommands
+	{
+		virtual ~BaseCommands() = default;
+		virtual void append(BaseCommands& other) = 0;
+		virtual void apply(World& world) = 0;
+		virtual bool empty() const noexcept = 0;
+	};
+
+	// The recorded changes of one component type, nullopt means removal.
+	template <typename T>
+	struct Commands final : BaseCommands
+	{
+		std::vector<std::pair<uint64_t, std::optional<T>>> changes;
+
+		void append(BaseCommands& other) override
+		{
+			auto& source = static_cast<Commands&>(other).changes;
+			changes.insert(changes.end(), std::make_move_iterator(source.begin()),
+				std::make_move_iterator(source.end()));
+			source.clear();
+		}
+
+		void apply(World& world) override
+		{
+			std::ranges::stable_sort(changes, {}, [](const auto& change) {
+				return handle_index(change.first);
+			});
+			EntityStorage<T>& storage = world.mapping.get<T>();
+			for (auto& [key, component] : changes) {
+				if (!world.alive(key)) {
+					continue;
+				}
+				if (component) {
+					storage.update(key, std::move(*component));
+				} else {
+					storage.remove(key);
+				}
+			}
+			changes.clear();
+		}
+
+		bool empty() const noexcept override
+		{
+			return changes.empty();
+		}
+	};
+
+	template <typename T>
+	Commands<T>& get()
+	{
+		std::size_t id = component_id<T>();
+		if (id >= commands.size()) {
+			commands.resize(id + 1);
+		}
+		if (!commands[id]) {
+			commands[id] = std::make_unique<Commands<T>>();
+		}
+		return static_cast<Commands<T>&>(*commands[id]);
+	}
+
+private:
+	World& world;
+	// The commands of each component type indexed by the component id.
+	std::vector<std::unique_ptr<BaseCommands>> commands;
+	std::vector<std::pair<Entity, Entity>> created;
+	std::vector<Entity> destroyed;
+};
+
+}
@@ -1,32 +1,253 @@
 #include "engine/central/entity.h"
+#include "engine/central/command.h"
 #include "engine/central/family.h"
+#include "engine/central/observer.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 
 namespace kodanuki
 {
 
-Entity ECS::create(Entity parent)
+// Identifies snapshot files, followed by the version of the format.
+static constexpr uint32_t snapshot_magic = 0x4b4e444b;
+static constexpr uint32_t snapshot_version = 2;
+
+World::World()
+{
+	static std::atomic<uint64_t> counter = 0;
+	id = counter++;
+}
+
+World::~World() = default;
+
+Entity World::create(Entity parent)
 {
-	static uint64_t sid = 0;
-	Entity entity = std::make_optional<uint64_t>(++sid);
-	ECS::update<Entity>(entity, entity);
-	ECS::update<Family>(entity, {entity, parent});
+	Entity entity = reserve();
+	families.insert(entity.value(), parent.value_or(null_handle));
+	update<Entity>(entity, entity);
+	update<Family>(entity, {*this, entity});
 	return entity;
 }
 
-void ECS::clear(Entity entity, bool initial)
+std::vector<Entity> World::create_many(uint64_t count, Entity parent)
 {
-	if (!ECS::has<Entity>(entity)) {
-		return;
+	std::vector<Entity> entities;
+	entities.reserve(count);
+	{
+		std::lock_guard lock(handles_mutex);
+		for (uint64_t i = 0; i < count; i++) {
+			entities.push_back(std::make_optional<uint64_t>(handles.create()));
+		}
+	}
+	std::vector<uint64_t> keys = keys_of(entities);
+	families.insert_many(keys, parent.value_or(null_handle));
+	mapping.get<Entity>().update_many(keys, [&](uint64_t i) -> const Entity& {
+		return entities[i];
+	});
+	mapping.get<Family>().update_many(keys, [&](uint64_t i) {
+		return Family(*this, entities[i]);
+	});
+	return entities;
+}
+
+std::vector<uint64_t> World::keys_of(std::span<const Entity> entities)
+{
+	std::vector<uint64_t> keys;
+	keys.reserve(entities.size());
+	for (Entity entity : entities) {
+		keys.push_back(entity.value());
+	}
+	return keys;
+}
+
+bool World::alive(Entity entity) const
+{
+	std::lock_guard lock(handles_mutex);
+	return entity && handles.alive(entity.value());
+}
+
+CommandBuffer& World::commands()
+{
+	// Threads usually record into the same world over and over again.
+	thread_local uint64_t cached_world = ~uint64_t(0);
+	thread_local CommandBuffer* cached_buffer = nullptr;
+	if (cached_world == id) {
+		return *cached_buffer;
 	}
-	Family& family = ECS::get<Family>(entity);
-	if (initial) {
-		family.set_parent(std::nullopt);
+	std::lock_guard lock(buffers_mutex);
+	std::unique_ptr<CommandBuffer>& buffer = buffers[std::this_thread::get_id()];
+	if (!buffer) {
+		buffer = std::make_unique<CommandBuffer>(*this);
+	}
+	cached_world = id;
+	cached_buffer = buffer.get();
+	return *buffer;
+}
+
+void World::flush()
+{
+	{
+		std::lock_guard lock(buffers_mutex);
+		if (!buffers.empty()) {
+			CommandBuffer& merged = *buffers.begin()->second;
+			for (auto& [thread, buffer] : buffers) {
+				if (buffer.get() != &merged) {
+					merged.append(*buffer);
+				}
+			}
+			merged.apply();
+		}
+	}
+	// Callbacks may register new observers, so the vector can grow.
+	for (std::size_t id = 0; id < observers.size(); id++) {
+		if (observers[id]) {
+			observers[id]->deliver();
+		}
+	}
+}
+
+void World::on_destroy(std::function<void(std::span<const Entity>)> callback)
+{
+	observer<Entity>().on_remove(std::move(callback));
+}
+
+Observer& World::observer(std::size_t id, BaseStorage& storage)
+{
+	if (id >= observers.size()) {
+		observers.resize(id + 1);
+	}
+	if (!observers[id]) {
+		observers[id] = std::make_unique<Observer>(storage);
+		storage.subscribe(observers[id].get());
+	}
+	return *observers[id];
+}
+
+void World::save(SnapshotWriter& writer) const
+{
+	writer.write(snapshot_magic);
+	writer.write(snapshot_version);
+	{
+		std::lock_guard lock(handles_mutex);
+		handles.save(writer);
+	}
+	families.save(writer);
+	mapping.save(writer);
+}
+
+void World::save(const std::filesystem::path& path) const
+{
+	SnapshotWriter writer;
+	save(writer);
+	writer.save(path);
+}
+
+void World::load(SnapshotReader& reader)
+{
+	assert(families.size() == 0);
+	if (reader.read<uint32_t>() != snapshot_magic) {
+		throw std::runtime_error("The data is not a snapshot!");
+	}
+	if (reader.read<uint32_t>() != snapshot_version) {
+		throw std::runtime_error("The snapshot has an unsupported version!");
+	}
+	{
+		std::lock_guard lock(handles_mutex);
+		handles.load(reader);
+	}
+	families.load(reader);
+	mapping.load(reader);
+	// The family refers to this world, so it is rebuilt instead.
+	EntityStorage<Family>& storage = mapping.get<Family>();
+	storage.reserve(families.size());
+	for (uint64_t key : families.ordered()) {
+		storage.update(key, {*this, key});
+	}
+}
+
+void World::load(const std::filesystem::path& path)
+{
+	SnapshotFile file(path);
+	SnapshotReader reader(file.data());
+	load(reader);
+}
+
+Checkpoint World::checkpoint()
+{
+	Checkpoint checkpoint;
+	checkpoint.world = id;
+	checkpoint.mapping = mapping.capture();
+	{
+		std::lock_guard lock(handles_mutex);
+		if (!last_handles || last_handles_version != handles.version()) {
+			last_handles = std::make_shared<const HandleAllocator>(handles);
+			last_handles_version = handles.version();
+		}
+	}
+	if (!last_families || last_families_version != families.version()) {
+		last_families = std::make_shared<const Hierarchy>(families);
+		last_families_version = families.version();
+	}
+	checkpoint.handles = last_handles;
+	checkpoint.families = last_families;
+	return checkpoint;
+}
+
+void World::rollback(const Checkpoint& checkpoint)
+{
+	if (checkpoint.world != id) {
+		throw std::logic_error("The checkpoint belongs to another world!");
+	}
+	{
+		std::lock_guard lock(handles_mutex);
+		if (checkpoint.handles != last_handles || last_handles_version != handles.version()) {
+			handles = *checkpoint.handles;
+			last_handles = checkpoint.handles;
+			last_handles_version = handles.version();
+		}
+	}
+	if (checkpoint.families != last_families || last_families_version != families.version()) {
+		families = *checkpoint.families;
+		last_families = checkpoint.families;
+		last_families_version = families.version();
+	}
+	mapping.rollback(checkpoint.mapping);
+}
+
+Entity World::reserve()
+{
+	std::lock_guard lock(handles_mutex);
+	return std::make_optional<uint64_t>(handles.create());
+}
+
+void World::clear(std::span<const Entity> entities)
+{
+	// Collects the sub-trees first, so each storage is visited only once.
+	std::vector<uint64_t> keys;
+	for (Entity entity : entities) {
+		if (!alive(entity) || !families.contains(entity.value())) {
+			continue;
+		}
+		uint64_t first = keys.size();
+		families.collect(entity.value(), keys);
+		// Descendants come after their ancestors, erase them first.
+		for (uint64_t i = keys.size(); i-- > first;) {
+			families.erase(keys[i]);
+		}
+	}
+	if (keys.empty()) {
+		return;
 	}
-	for (Entity child : family.get_children()) {
-		ECS::clear(child, false);
+	mapping.remove_many(keys);
+	std::lock_guard lock(handles_mutex);
+	for (uint64_t key : keys) {
+		handles.destroy(key);
 	}
-	mapping.remove(entity.value());
 }
 
 }
@@ -1,7 +1,24 @@
 #pragma once
+#include "engine/central/handle.h"
+#include "engine/central/hierarchy.h"
+#include "engine/central/memory.h"
+#include "engine/central/stats.h"
 #include "engine/central/storage.h"
+#include <cassert>
 #include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <unordered_map>
+#include <vector>
 
 
 namespace kodanuki
@@ -9,6 +26,10 @@ namespace kodanuki
 
 /**
  * Each entity in the ECS defines a unique identifier.
+ *
+ * The identifier is a handle with a 32-bit slot index and a 32-bit
+ * generation, see handle.h. Slots of removed entities are recycled,
+ * but the generation ensures that old identifiers stay unique.
  * 
  * Multiple components can be attached to an entity. These components are
  * collections of data. One or more components together form an archetype.
@@ -16,26 +37,84 @@ namespace kodanuki
  */
 typedef std::optional<uint64_t> Entity;
 
+class CommandBuffer;
+class Observer;
+class World;
+
+/**
+ * The captured state of a world, see World::checkpoint().
+ *
+ * Checkpoints are immutable and cheap to copy. Consecutive checkpoints of
+ * the same world share all parts that did not change between them, so
+ * keeping one checkpoint per tick costs memory proportional to the
+ * changes made during the ticks.
+ */
+class Checkpoint
+{
+private:
+	friend class World;
+	uint64_t world = ~uint64_t(0);
+	MappingState mapping;
+	std::shared_ptr<const HandleAllocator> handles;
+	std::shared_ptr<const Hierarchy> families;
+};
+
 /**
- * Functions for interating with the ECS directly.
+ * The world owns the entities and components of one simulation.
  * 
  * Entities can be passed throught the program, but each system maintains
  * its own components. Each system must remove these components or provide
  * a cleanup strategy. Neglecting this will impact performance.
+ *
+ * Worlds are independent of each other, entities are only valid inside
+ * the world that created them. Different worlds can be used by different
+ * threads without any synchronization.
  */
-class ECS
+class World
 {
 public:
+	World();
+	~World();
+
+	World(const World&) = delete;
+	World& operator=(const World&) = delete;
+
 	/**
 	 * Creates a new entity with a unique identifier.
 	 *
+	 * The identifier reuses the slot of a previously removed entity
+	 * if possible.
+	 *
 	 * Each entity stores the following components:
 	 *     - Entity
 	 *     - Family
 	 *
 	 * @param parent The potential parent for this entity.
 	 */
-	static Entity create(Entity parent = std::nullopt);
+	Entity create(Entity parent = std::nullopt);
+
+	/**
+	 * Creates multiple entities with the same parent at once.
+	 *
+	 * This is equivalent to calling create() count times, but the storages
+	 * of the default components are only grown once.
+	 *
+	 * @param count The number of entities.
+	 * @param parent The potential parent for these entities.
+	 * @return The new entities in order of creation.
+	 */
+	std::vector<Entity> create_many(uint64_t count, Entity parent = std::nullopt);
+
+	/**
+	 * Returns true iff the entity was created and not yet removed.
+	 *
+	 * This check is O(1) and also rejects identifiers whose slot has
+	 * been recycled by another entity.
+	 *
+	 * @param entity The entity to check.
+	 * @return Is the entity alive?
+	 */
+	bool alive(Entity entity) const;
 
 	/**
 	 * Updates the component inside the entity.
@@ -45,9 +124,66 @@ public:
 	 * @param component The value of the component.
 	 */
 	template <typename T>
-	static void update(Entity entity, T component = {})
+	void update(Entity entity, T component = {})
 	{
-		mapping.get<T>().update(entity.value(), component);
+		mapping.get<T>().update(entity.value(), std::move(component));
+	}
+
+	/**
+	 * Constructs the component inside the entity from the arguments.
+	 *
+	 * The arguments are forwarded to the constructor of the component,
+	 * which is constructed directly inside the storage. If the entity
+	 * already has the component, the new value is assigned to it.
+	 * This also works for components that can only be moved.
+	 *
+	 * @param T The type of the component.
+	 * @param entity The entity to update the component.
+	 * @param args The arguments for the constructor of the component.
+	 * @return The reference to the component.
+	 */
+	template <typename T, typename ... Args>
+	component_reference_t<T> emplace(Entity entity, Args&& ... args)
+	{
+		return mapping.get<T>().emplace(entity.value(), std::forward<Args>(args)...);
+	}
+
+	/**
+	 * Updates the components of multiple entities at once.
+	 *
+	 * The storage is grown once for all new components, which are then
+	 * appended to the end of it. Listeners and signatures are updated
+	 * once for the whole batch.
+	 *
+	 * @param T The type of the components.
+	 * @param entities The entities to update the components.
+	 * @param components The value of the component for each entity.
+	 * @throws std::logic_error if the number of components differs.
+	 */
+	template <typename T>
+	void update_many(std::span<const Entity> entities, std::span<const T> components)
+	{
+		if (entities.size() != components.size()) {
+			throw std::logic_error("Each entity needs exactly one component!");
+		}
+		mapping.get<T>().update_many(keys_of(entities), [&](uint64_t i) -> const T& {
+			return components[i];
+		});
+	}
+
+	/**
+	 * Updates the components of multiple entities to the same value.
+	 *
+	 * @param T The type of the components.
+	 * @param entities The entities to update the components.
+	 * @param component The value of the component for every entity.
+	 */
+	template <typename T>
+	void update_many(std::span<const Entity> entities, const T& component = {})
+	{
+		mapping.get<T>().update_many(keys_of(entities), [&](uint64_t) -> const T& {
+			return component;
+		});
 	}
 
 	/**
@@ -63,39 +199,55 @@ public:
 	 * @param entity The entity to remove the component.
 	 */
 	template <typename T>
-	static void remove(Entity entity)
+	void remove(Entity entity)
 	{
 		if constexpr (std::is_same<T, Entity>()) {
-			clear(entity);
+			clear(std::span<const Entity>(&entity, 1));
 		} else {
 			mapping.get<T>().remove(entity.value());
 		}
 	}
 
 	/**
-	 * Returns true iff the entity has the component.
+	 * Returns true iff the entity has all the components.
 	 *
-	 * @param T The type of the component.
-	 * @param entity The entity to check for the component.
-	 * @return Does the entity contain the component.
+	 * Multiple components are checked at once by the signature of the
+	 * entity, see SignatureTable.
+	 *
+	 * @param T The types of the components.
+	 * @param entity The entity to check for the components.
+	 * @return Does the entity contain every component.
 	 */
-	template <typename T>
-	static bool has(Entity entity)
+	template <typename T, typename ... U>
+	bool has(Entity entity)
 	{
-		return mapping.get<T>().contains(entity.value());
+		if constexpr (sizeof...(U) == 0) {
+			return mapping.get<T>().contains(entity.value());
+		} else {
+			return mapping.contains<T, U...>(entity.value());
+		}
 	}
 
 	/**
 	 * Returns the reference to the component.
 	 *
+	 * Getting a non-const reference counts as a change of the component,
+	 * see Changed. Use a const type to only read the component. Split
+	 * components are returned as proxies, see SplitReference.
+	 *
 	 * @param T The type of the component.
 	 * @param enttiy The entity to get the component.
 	 * @return The reference to the component.
 	 */
 	template <typename T>
-	static T& get(Entity entity)
+	component_reference_t<T> get(Entity entity)
 	{
-		return mapping.get<T>()[entity.value()];
+		auto& storage = mapping.get<std::remove_const_t<T>>();
+		if constexpr (std::is_const_v<T>) {
+			return storage[entity.value()];
+		} else {
+			return storage.touch(entity.value(), mapping.tick());
+		}
 	}
 
 	/**
@@ -107,30 +259,36 @@ public:
 	 * @param target The entity to which to copy the component.
 	 */
 	template <typename T>
-	static void copy(Entity source, Entity target)
+	void copy(Entity source, Entity target)
 	{
 		if (!has<T>(source)) {
 			return;
 		}
-		update<T>(target, get<T>(source));
+		EntityStorage<T>& storage = mapping.get<T>();
+		storage.update(target.value(), storage[source.value()]);
 	}
 
 	/**
 	 * Moves the component from the source entity to the target entity.
 	 * Does nothing if the target entity doesn't have this component.
+	 * The component is moved and not copied, so it may be move-only.
 	 *
 	 * @param T The type of the component.
 	 * @param source The entity that contains the component.
 	 * @param target The entity to which to move the component.
 	 */
 	template <typename T>
-	static void move(Entity source, Entity target)
+	void move(Entity source, Entity target)
 	{
-		if (!has<T>(source)) {
+		if (!has<T>(source) || source == target) {
 			return;
 		}
-		copy<T>(source, target);
-		remove<T>(source);
+		EntityStorage<T>& storage = mapping.get<T>();
+		storage.unshare(source.value());
+		// Inserting might grow the storage, so the value leaves it first.
+		T component = std::move(storage[source.value()]);
+		storage.update(target.value(), std::move(component));
+		storage.remove(source.value());
 	}
 
 	/**
@@ -143,14 +301,15 @@ public:
 	 * @param target The entity containing the target component.
 	 */
 	template <typename T>
-	static void swap(Entity source, Entity target)
+	void swap(Entity source, Entity target)
 	{
 		if (has<T>(source) && has<T>(target)) {
-			std::swap(get<T>(source), get<T>(target));
-			return;
+			mapping.get<T>().swap_values(source.value(), target.value(), mapping.tick());
+		} else if (has<T>(source)) {
+			move<T>(source, target);
+		} else {
+			move<T>(target, source);
 		}
-		move<T>(target, source);
-		move<T>(source, target);
 	}
 
 	/**
@@ -169,29 +328,564 @@ public:
 	 * @param target The entity to which to bind the component.
 	 */
 	template <typename T>
-	static void bind(Entity source, Entity target)
+	void bind(Entity source, Entity target)
 	{
 		mapping.get<T>().bind(source.value(), target.value());
 	}
 
+	/**
+	 * Shares the component of the target entity with the source entity.
+	 *
+	 * Shared components use the same memory until either entity writes
+	 * to it, the writing entity then gets its own copy. Writes are get()
+	 * with a non-const type, iterating a non-const component and update().
+	 * This suits prefab data that most entities only read.
+	 *
+	 * If the target does not contain the component, this will remove
+	 * the source component if present.
+	 *
+	 * @param T The type of the component.
+	 * @param source The entity that shares the component.
+	 * @param target The entity whose component is shared.
+	 */
+	template <typename T>
+	void share(Entity source, Entity target)
+	{
+		EntityStorage<T>& storage = mapping.get<T>();
+		if (storage.contains(target.value())) {
+			storage.share(source.value(), target.value());
+		} else {
+			storage.remove(source.value());
+		}
+	}
+
 	/**
 	 * Iterates over entities with the given archetype.
 	 *
+	 * Archetypes with Changed or Added filters only visit the entities
+	 * that changed since the last iteration of the same system. Inside a
+	 * scheduler each system is identified automatically.
+	 *
 	 * @param Archetype The archetype that defines the iteration.
+	 * @param system The id of the iterating system, see running_system.
 	 * @return An iterator over tuples of components.
 	 */
 	template <typename Archetype>
-	static auto iterate()
+	auto iterate(uint64_t system = running_system)
+	{
+		return Archetype::iterate(mapping, system);
+	}
+
+	/**
+	 * Returns the packed arrays of the components of a grouped archetype.
+	 *
+	 * Each iterated type must be owned or the entity, see Own and
+	 * GroupIterator::columns().
+	 *
+	 * @param Archetype The archetype that defines the columns.
+	 * @return A tuple of spans with one element per matching entity.
+	 */
+	template <typename Archetype>
+	auto columns()
+	{
+		return Archetype::columns(mapping);
+	}
+
+	/**
+	 * Creates the query and storages used by the archetype ahead of time.
+	 *
+	 * Iterating prepares the archetype automatically. Preparing them
+	 * beforehand is required when multiple threads use the world.
+	 *
+	 * @param Archetype The archetype that should be prepared.
+	 * @param system The id of the system that will iterate it.
+	 */
+	template <typename Archetype>
+	void prepare(uint64_t system = running_system)
+	{
+		Archetype::prepare(mapping, system);
+	}
+
+	/**
+	 * Iterates over entities with the given archetype in parallel.
+	 *
+	 * The matching entities are split into chunks which are executed
+	 * on the global thread pool. The function is called with the
+	 * components of each entity as separate arguments. Archetypes that
+	 * consume or produce components are rejected at compile time.
+	 *
+	 * The function must not change which components entities have, these
+	 * changes must be recorded with commands() instead. It also must not
+	 * write to components that are bound to multiple entities.
+	 *
+	 * @param Archetype The archetype that defines the iteration.
+	 * @param function The function that is called for each entity.
+	 * @param grain The maximum number of entities per chunk.
+	 * @param system The id of the iterating system, see iterate().
+	 */
+	template <typename Archetype, typename Function>
+		requires (!Archetype::is_structural)
+	void par_iterate(Function function, uint64_t grain = 1024, uint64_t system = running_system)
+	{
+		Archetype::par_iterate(mapping, function, grain, system);
+	}
+
+	/**
+	 * Returns the command buffer of the calling thread.
+	 *
+	 * Systems record structural changes into this buffer while other
+	 * systems may iterate the storages. The changes are applied by the
+	 * next call to flush(). Include command.h to use the buffer.
+	 *
+	 * @return The command buffer of the calling thread.
+	 */
+	CommandBuffer& commands();
+
+	/**
+	 * Applies the commands recorded by all threads.
+	 *
+	 * The buffers are merged, so each component type is changed in one
+	 * pass. Afterward, the events collected by the observers are delivered.
+	 * This must be called while no system is running.
+	 */
+	void flush();
+
+	/**
+	 * Returns the observer of the component type.
+	 *
+	 * The observer records which entities received or lost the component
+	 * and delivers them in batches, see Observer. Include observer.h to
+	 * use the observer.
+	 *
+	 * @param T The type of the component.
+	 * @return The observer of the component type.
+	 */
+	template <typename T>
+	Observer& observer()
+	{
+		return observer(component_id<T>(), mapping.get<T>());
+	}
+
+	/**
+	 * Registers the callback for entities that received the component.
+	 *
+	 * The entities are collected and delivered by the next flush().
+	 *
+	 * @param T The type of the component.
+	 * @param callback The function called with each batch of entities.
+	 */
+	template <typename T>
+	void on_add(std::function<void(std::span<const Entity>)> callback)
+	{
+		observer<T>().on_add(std::move(callback));
+	}
+
+	/**
+	 * Registers the callback for entities that lost the component.
+	 *
+	 * The entities are collected and delivered by the next flush().
+	 * Removing the entity also reports the removal of its components.
+	 *
+	 * @param T The type of the component.
+	 * @param callback The function called with each batch of entities.
+	 */
+	template <typename T>
+	void on_remove(std::function<void(std::span<const Entity>)> callback)
+	{
+		observer<T>().on_remove(std::move(callback));
+	}
+
+	/**
+	 * Registers the callback for removed entities.
+	 *
+	 * The entities are collected and delivered by the next flush(),
+	 * they are no longer alive at that point.
+	 *
+	 * @param callback The function called with each batch of entities.
+	 */
+	void on_destroy(std::function<void(std::span<const Entity>)> callback);
+
+	/**
+	 * Returns the family tree of all entities.
+	 *
+	 * Use Family::set_parent() to change the tree.
+	 *
+	 * @return The hierarchy containing the entities.
+	 */
+	const Hierarchy& hierarchy() const noexcept
+	{
+		return families;
+	}
+
+	/**
+	 * Returns the resource through which the storages and the temporaries
+	 * of iterations allocate.
+	 *
+	 * The counters stay the same during frames that allocate nothing from
+	 * the heap, for example once the storages stopped growing.
+	 *
+	 * @return The counting resource of this world.
+	 */
+	const CountingResource& memory() const noexcept
+	{
+		return mapping.memory();
+	}
+
+	/**
+	 * Returns the statistics of the storages and cached queries.
+	 *
+	 * The storages report their keys and memory, the queries their
+	 * matches and the searches and changes since the last reset. Use
+	 * write_json() to dump them.
+	 *
+	 * @return The statistics of this world.
+	 */
+	Statistics statistics() const
+	{
+		return mapping.statistics();
+	}
+
+	/**
+	 * Resets the counters of the queries, usually once per frame.
+	 */
+	void reset_statistics() noexcept
+	{
+		mapping.reset_statistics();
+	}
+
+	/**
+	 * Returns the pool of the storage of the component type.
+	 *
+	 * Components can allocate their buffers from it, for example with a
+	 * std::pmr::vector. Buffers that are freed are reused by the next
+	 * allocation of the same size, so they don't reach the heap again.
+	 *
+	 * @param T The type of the component.
+	 * @return The pool resource of the storage.
+	 */
+	template <typename T>
+	std::pmr::memory_resource* resource()
 	{
-		return Archetype::iterate(mapping);
+		return mapping.get<T>().resource();
 	}
 
+	/**
+	 * Writes the entities and components into the snapshot.
+	 *
+	 * The snapshot starts with a version, followed by the handles, the
+	 * family tree and the storages as contiguous blocks. Components are
+	 * only written if their type is serializable, see Serializer. The
+	 * commands that were not flushed yet are not written.
+	 *
+	 * @param writer The writer of the snapshot.
+	 */
+	void save(SnapshotWriter& writer) const;
+
+	/**
+	 * Writes the snapshot of the world into the file.
+	 *
+	 * @param path The path of the file.
+	 * @throws std::runtime_error if the file could not be written.
+	 */
+	void save(const std::filesystem::path& path) const;
+
+	/**
+	 * Restores the entities and components from the snapshot.
+	 *
+	 * The world must not contain any entities. Entities keep their
+	 * identifiers and the families are rebuilt for this world.
+	 *
+	 * @param reader The reader of the snapshot.
+	 * @throws std::runtime_error if the snapshot has a different version.
+	 */
+	void load(SnapshotReader& reader);
+
+	/**
+	 * Restores the world from the snapshot file.
+	 *
+	 * The file is mapped into memory and the blocks are copied from there.
+	 *
+	 * @param path The path of the file.
+	 * @throws std::runtime_error if the file could not be read.
+	 */
+	void load(const std::filesystem::path& path);
+
+	/**
+	 * Captures the entities and components for a later rollback.
+	 *
+	 * The dense storages are captured in chunks, only the chunks written
+	 * since the last checkpoint are copied. Writing through get() or
+	 * iterate() marks the chunks, writing through pointers that were kept
+	 * from earlier ticks does not. All components must be copyable.
+	 *
+	 * @return The checkpoint of this world.
+	 * @throws std::logic_error if any components can't be copied.
+	 */
+	Checkpoint checkpoint();
+
+	/**
+	 * Restores the entities and components of the checkpoint.
+	 *
+	 * Only the chunks that changed since the last checkpoint or rollback
+	 * are copied back. The clock is restored as well, so simulating the
+	 * same ticks again stamps the same changes. The iteration order of
+	 * queries may differ if entities were created or destroyed since.
+	 * Commands that were not flushed yet are kept, flush them beforehand.
+	 * Observers are told about the components added and removed.
+	 *
+	 * @param checkpoint The checkpoint of this world.
+	 * @throws std::logic_error if the checkpoint belongs to another world.
+	 */
+	void rollback(const Checkpoint& checkpoint);
+
+private:
+	friend class CommandBuffer;
+	friend class Family;
+
+	// Returns the observer with the given component id.
+	Observer& observer(std::size_t id, BaseStorage& storage);
+
+	// Reserves the identifier of an entity without creating it.
+	Entity reserve();
+
+	// Strips the entities and their descendants from all their components.
+	void clear(std::span<const Entity> entities);
+
+	// Returns the keys of the entities, see EntityStorage::update_many().
+	static std::vector<uint64_t> keys_of(std::span<const Entity> entities);
+
 private:
-	// Strips the entity from all its components.
-	static void clear(Entity entity, bool initial = true);
+	EntityMapping mapping;
+	HandleAllocator handles;
+	mutable std::mutex handles_mutex;
+	Hierarchy families;
+	// The command buffer of each thread that recorded commands.
+	std::unordered_map<std::thread::id, std::unique_ptr<CommandBuffer>> buffers;
+	std::mutex buffers_mutex;
+	// The observer of each component type indexed by the component id.
+	std::vector<std::unique_ptr<Observer>> observers;
+	// The handles and families of the last checkpoint and their versions.
+	std::shared_ptr<const HandleAllocator> last_handles;
+	std::shared_ptr<const Hierarchy> last_families;
+	uint64_t last_handles_version = 0;
+	uint64_t last_families_version = 0;
+	// The unique id of this world, used to cache the command buffers.
+	uint64_t id;
+};
+
+/**
+ * Functions for interating with the default world directly.
+ *
+ * Each function forwards to the function of the same name inside the
+ * default world, see World for the documentation. Independent worlds
+ * can be created as additional World objects.
+ */
+class ECS
+{
+public:
+	using World = kodanuki::World;
+
+	/**
+	 * @return The default world used by the static functions.
+	 */
+	static World& world() noexcept
+	{
+		return default_world;
+	}
+
+	static Entity create(Entity parent = std::nullopt)
+	{
+		return default_world.create(parent);
+	}
+
+	static std::vector<Entity> create_many(uint64_t count, Entity parent = std::nullopt)
+	{
+		return default_world.create_many(count, parent);
+	}
+
+	static bool alive(Entity entity)
+	{
+		return default_world.alive(entity);
+	}
+
+	template <typename T>
+	static void update(Entity entity, T component = {})
+	{
+		default_world.update<T>(entity, std::move(component));
+	}
+
+	template <typename T, typename ... Args>
+	static component_reference_t<T> emplace(Entity entity, Args&& ... args)
+	{
+		return default_world.emplace<T>(entity, std::forward<Args>(args)...);
+	}
+
+	template <typename T>
+	static void update_many(std::span<const Entity> entities, std::span<const T> components)
+	{
+		default_world.update_many<T>(entities, components);
+	}
+
+	template <typename T>
+	static void update_many(std::span<const Entity> entities, const T& component = {})
+	{
+		default_world.update_many<T>(entities, component);
+	}
+
+	template <typename T>
+	static void remove(Entity entity)
+	{
+		default_world.remove<T>(entity);
+	}
+
+	template <typename T, typename ... U>
+	static bool has(Entity entity)
+	{
+		return default_world.has<T, U...>(entity);
+	}
+
+	template <typename T>
+	static component_reference_t<T> get(Entity entity)
+	{
+		return default_world.get<T>(entity);
+	}
+
+	template <typename T>
+	static void copy(Entity source, Entity target)
+	{
+		default_world.copy<T>(source, target);
+	}
+
+	template <typename T>
+	static void move(Entity source, Entity target)
+	{
+		default_world.move<T>(source, target);
+	}
+
+	template <typename T>
+	static void swap(Entity source, Entity target)
+	{
+		default_world.swap<T>(source, target);
+	}
+
+	template <typename T>
+	static void bind(Entity source, Entity target)
+	{
+		default_world.bind<T>(source, target);
+	}
+
+	template <typename T>
+	static void share(Entity source, Entity target)
+	{
+		default_world.share<T>(source, target);
+	}
+
+	template <typename Archetype>
+	static auto iterate()
+	{
+		return default_world.iterate<Archetype>();
+	}
+
+	template <typename Archetype>
+	static auto columns()
+	{
+		return default_world.columns<Archetype>();
+	}
+
+	template <typename Archetype>
+	static void prepare()
+	{
+		default_world.prepare<Archetype>();
+	}
+
+	template <typename Archetype, typename Function>
+		requires (!Archetype::is_structural)
+	static void par_iterate(Function function, uint64_t grain = 1024)
+	{
+		default_world.par_iterate<Archetype>(function, grain);
+	}
+
+	static CommandBuffer& commands()
+	{
+		return default_world.commands();
+	}
+
+	static void flush()
+	{
+		default_world.flush();
+	}
+
+	template <typename T>
+	static Observer& observer()
+	{
+		return default_world.observer<T>();
+	}
+
+	template <typename T>
+	static void on_add(std::function<void(std::span<const Entity>)> callback)
+	{
+		default_world.on_add<T>(std::move(callback));
+	}
+
+	template <typename T>
+	static void on_remove(std::function<void(std::span<const Entity>)> callback)
+	{
+		default_world.on_remove<T>(std::move(callback));
+	}
+
+	static void on_destroy(std::function<void(std::span<const Entity>)> callback)
+	{
+		default_world.on_destroy(std::move(callback));
+	}
+
+	static const Hierarchy& hierarchy() noexcept
+	{
+		return default_world.hierarchy();
+	}
+
+	static const CountingResource& memory() noexcept
+	{
+		return default_world.memory();
+	}
+
+	static Statistics statistics()
+	{
+		return default_world.statistics();
+	}
+
+	static void reset_statistics() noexcept
+	{
+		default_world.reset_statistics();
+	}
+
+	template <typename T>
+	static std::pmr::memory_resource* resource()
+	{
+		return default_world.resource<T>();
+	}
+
+	static void save(const std::filesystem::path& path)
+	{
+		default_world.save(path);
+	}
+
+	static void load(const std::filesystem::path& path)
+	{
+		default_world.load(path);
+	}
+
+	static Checkpoint checkpoint()
+	{
+		return default_world.checkpoint();
+	}
+
+	static void rollback(const Checkpoint& checkpoint)
+	{
+		default_world.rollback(checkpoint);
+	}
 
 private:
-	static inline EntityMapping mapping;
+	static inline World default_world;
 };
 
 }
@@ -6,45 +6,41 @@
 namespace kodanuki
 {
 
-Family::Family(Entity entity, Entity parent) noexcept
+Family::Family(World& world, Entity entity) noexcept
 {
+	this->world = &world;
 	this->itself = entity;
-	this->parent = parent;
-	
-	if (parent) {
-		ECS::get<Family>(parent).children.insert(entity);
-	}
 }
 
 void Family::set_parent(Entity parent) noexcept
 {
-	this->parent = parent;
+	world->families.set_parent(itself.value(), parent.value_or(null_handle));
 }
 
 Entity Family::get_root() const noexcept
 {
-	return parent ? ECS::get<Family>(parent).get_root() : itself;
+	return world->families.root(itself.value());
 }
 
 Entity Family::get_parent() const noexcept
 {
-	return parent;
+	uint64_t parent = world->families.parent(itself.value());
+	return parent == null_handle ? std::nullopt : Entity(parent);
 }
 
-std::unordered_set<Entity> Family::get_siblings() const noexcept
+uint32_t Family::get_depth() const noexcept
 {
-	if (!parent) {
-		return {};
-	}
-	Family& parent_family = ECS::get<Family>(parent);
-	std::unordered_set<Entity> siblings = parent_family.children;
-	siblings.erase(itself);
-	return siblings;
+	return world->families.depth(itself.value());
 }
 
-std::unordered_set<Entity> Family::get_children() const noexcept
+Hierarchy::Children Family::get_siblings() const noexcept
 {
-	return children;
+	return world->families.siblings(itself.value());
+}
+
+Hierarchy::Children Family::get_children() const noexcept
+{
+	return world->families.children(itself.value());
 }
 
 }
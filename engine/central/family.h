@@ -1,18 +1,18 @@
 #pragma once
 #include "engine/central/entity.h"
-#include <unordered_set>
+#include "engine/central/hierarchy.h"
 
 
 namespace kodanuki
 {
 
 /**
- * The family stores the local family sub-tree.
+ * The family gives access to the family tree around one entity.
  *
  * The family tree is uniquely defined by the parent relationship.
  * You can update the parent of the given entity and all other family
- * members are calculated automatically. Optionally, lazy evaluation
- * can be enabled.
+ * members are calculated automatically. The tree itself is stored by
+ * the world, see Hierarchy, this component only refers to it.
  *
  * The family component should not be removed.
  */
@@ -22,15 +22,17 @@ public:
 	/**
 	 * Creates the family component of the given entity.
 	 *
+	 * @param world The world containing the family tree.
 	 * @param entity The entity at the center of the family sub-tree.
-	 * @param parent The parent of the given entity.
 	 */
-	Family(Entity entity, Entity parent = {}) noexcept;
+	Family(World& world, Entity entity) noexcept;
 
 	/**
 	 * Sets the parent of the given entity and updates the surrounding
 	 * family tree.
 	 *
+	 * Does nothing if the parent is a descendant of the entity.
+	 *
 	 * @param parent The parent of the given entity.
 	 */
 	void set_parent(Entity parent = {}) noexcept;
@@ -39,6 +41,7 @@ public:
 	 * Returns the root of the family tree.
 	 *
 	 * The root is either the entity itself or the root of the parent.
+	 * It is cached, so this is O(1).
 	 *
 	 * @return The root of the family tree.
 	 */
@@ -47,33 +50,48 @@ public:
 	/**
 	 * Returns the parent of the given entity.
 	 *
-	 * The parent may be invalid depending, see constructor.
+	 * The parent is invalid for roots.
 	 *
 	 * @return The parent of the given entity.
 	 */
 	Entity get_parent() const noexcept;
 
+	/**
+	 * Returns the number of ancestors of the given entity.
+	 *
+	 * @return The depth inside the family tree.
+	 */
+	uint32_t get_depth() const noexcept;
+
 	/**
 	 * Returns the siblings of the given entity.
 	 *
 	 * The siblings are all children of the parent except the
 	 * entity itself.
 	 *
-	 * @return The siblings of the given entity.
+	 * @return The range over the siblings of the given entity.
 	 */
-	std::unordered_set<Entity> get_siblings() const noexcept;
+	Hierarchy::Children get_siblings() const noexcept;
 
 	/**
 	 * Returns the children of the given entity.
 	 *
-	 * @return The siblings of the given entity.
+	 * @return The range over the children of the given entity.
 	 */
-	std::unordered_set<Entity> get_children() const noexcept;
+	Hierarchy::Children get_children() const noexcept;
 
 private:
+	World* world;
 	Entity itself;
-	Entity parent;
-	std::unordered_set<Entity> children;
+};
+
+/**
+ * The family refers to its world, the world rebuilds it when loading.
+ */
+template <>
+struct Serializer<Family>
+{
+	static constexpr bool enabled = false;
 };
 
 }
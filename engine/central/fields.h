@@ -0,0 +1,298 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+
+namespace kodanuki
+{
+
+/**
+ * Lists the data members of a component to store each in its own column.
+ *
+ * Components are stored as an array of structs by default. Specializing
+ * this trait stores them as a struct of arrays instead, see SplitPolicy:
+ *
+ *     template <>
+ *     struct kodanuki::component_fields<Particle>
+ *     {
+ *         static constexpr auto members = std::tuple(&Particle::x, &Particle::y);
+ *     };
+ *
+ * The members must cover the whole component, which must be default
+ * constructible, since values are gathered member by member. The trait
+ * must be specialized before the storage of the component is used.
+ *
+ * @param T The type of the component.
+ */
+template <typename T>
+struct component_fields;
+
+/**
+ * Are the members of the component stored in separate columns?
+ */
+template <typename T>
+concept split_component = requires { component_fields<T>::members; };
+
+template <typename Members>
+struct member_types;
+
+template <typename ... C, typename ... F>
+struct member_types<std::tuple<F C::*...>>
+{
+	using type = std::tuple<F...>;
+};
+
+// The types of the members listed by component_fields.
+template <typename T>
+using field_types_t = typename member_types<std::remove_cv_t<decltype(component_fields<T>::members)>>::type;
+
+template <template <typename> typename Container, typename Fields>
+struct transform_fields;
+
+template <template <typename> typename Container, typename ... F>
+struct transform_fields<Container, std::tuple<F...>>
+{
+	using type = std::tuple<Container<F>...>;
+};
+
+// Wraps each field type with the template, e.g. the columns of a storage.
+template <template <typename> typename Container, typename Fields>
+using transform_fields_t = typename transform_fields<Container, Fields>::type;
+
+template <typename T, typename Fields = field_types_t<std::remove_const_t<T>>>
+struct field_pointers;
+
+template <typename T, typename ... F>
+struct field_pointers<T, std::tuple<F...>>
+{
+	using type = std::tuple<std::conditional_t<std::is_const_v<T>, const F, F>*...>;
+};
+
+// The pointers to the fields of one component, read-only for const types.
+template <typename T>
+using field_pointers_t = typename field_pointers<T>::type;
+
+// Compares member pointers of any type, different types never match.
+template <typename A, typename B>
+constexpr bool same_member(A lhs, B rhs) noexcept
+{
+	if constexpr (std::is_same_v<A, B>) {
+		return lhs == rhs;
+	} else {
+		return false;
+	}
+}
+
+/**
+ * Returns the index of the member inside component_fields.
+ *
+ * @param T The type of the component.
+ * @param member The pointer to the member.
+ * @return The index of the member or the number of fields if not listed.
+ */
+template <typename T, typename M>
+constexpr std::size_t field_index(M member) noexcept
+{
+	constexpr std::size_t count = std::tuple_size_v<field_types_t<T>>;
+	std::size_t index = count;
+	[&]<std::size_t ... I>(std::index_sequence<I...>) {
+		((same_member(std::get<I>(component_fields<T>::members), member) ? (index = I) : 0), ...);
+	}(std::make_index_sequence<count>());
+	return index;
+}
+
+/**
+ * The proxy reference to a component whose fields are stored separately.
+ *
+ * The proxy points to the fields of one component inside their columns.
+ * Converting it to the component gathers the fields and assigning a
+ * component scatters it. Single fields are accessed with a pointer to
+ * their member:
+ *
+ *     particle->*&Particle::x += particle->*&Particle::vx;
+ *
+ * Proxies of const components are read-only. Like any reference, the
+ * proxy is invalidated once its storage inserts or removes values.
+ *
+ * @param T The type of the component, const for read-only access.
+ */
+template <typename T>
+class SplitReference
+{
+public:
+	using value_type = std::remove_const_t<T>;
+
+	/**
+	 * Creates the reference from the pointers to the fields.
+	 *
+	 * @param fields The pointer to each field in the order of the trait.
+	 */
+	explicit SplitReference(field_pointers_t<T> fields) noexcept : fields(fields) {}
+
+	SplitReference(const SplitReference&) = default;
+
+	/**
+	 * Assigns the fields of the other component, the proxy is not rebound.
+	 *
+	 * @param other The reference to the other component.
+	 * @return This reference.
+	 */
+	const SplitReference& operator=(const SplitReference& other) const requires (!std::is_const_v<T>)
+	{
+		return *this = value_type(other);
+	}
+
+	/**
+	 * Scatters the value into the fields.
+	 *
+	 * @param value The new value of the component.
+	 * @return This reference.
+	 */
+	const SplitReference& operator=(const value_type& value) const requires (!std::is_const_v<T>)
+	{
+		each([&](auto member, auto* field) { *field = value.*member; });
+		return *this;
+	}
+
+	/**
+	 * Gathers the fields into a value.
+	 *
+	 * @return The copy of the component.
+	 */
+	operator value_type() const
+	{
+		value_type value{};
+		each([&](auto member, auto* field) { value.*member = *field; });
+		return value;
+	}
+
+	/**
+	 * Mutable references convert to read-only ones.
+	 */
+	operator SplitReference<const T>() const noexcept requires (!std::is_const_v<T>)
+	{
+		return SplitReference<const T>(field_pointers_t<const T>(fields));
+	}
+
+	/**
+	 * Returns the reference to a single field.
+	 *
+	 * @param member The pointer to the member of the field.
+	 * @return The reference to the field, const for read-only proxies.
+	 */
+	template <typename F>
+	auto& operator->*(F value_type::* member) const
+	{
+		using Field = std::conditional_t<std::is_const_v<T>, const F, F>;
+		Field* result = nullptr;
+		[&]<std::size_t ... I>(std::index_sequence<I...>) {
+			(match<I>(member, result), ...);
+		}(std::make_index_sequence<std::tuple_size_v<field_pointers_t<T>>>());
+		assert(result && "The member is not a field of the component");
+		return *result;
+	}
+
+	/**
+	 * Swaps the fields of both components.
+	 */
+	friend void swap(SplitReference lhs, SplitReference rhs) requires (!std::is_const_v<T>)
+	{
+		[&]<std::size_t ... I>(std::index_sequence<I...>) {
+			using std::swap;
+			(swap(*std::get<I>(lhs.fields), *std::get<I>(rhs.fields)), ...);
+		}(std::make_index_sequence<std::tuple_size_v<field_pointers_t<T>>>());
+	}
+
+private:
+	// Calls the function with each member pointer and its field.
+	template <typename Function>
+	void each(Function function) const
+	{
+		[&]<std::size_t ... I>(std::index_sequence<I...>) {
+			(function(std::get<I>(component_fields<value_type>::members), std::get<I>(fields)), ...);
+		}(std::make_index_sequence<std::tuple_size_v<field_pointers_t<T>>>());
+	}
+
+	template <std::size_t I, typename M, typename Field>
+	void match(M member, Field*& result) const
+	{
+		if constexpr (std::is_same_v<std::remove_pointer_t<std::tuple_element_t<I, field_pointers_t<T>>>, Field>) {
+			if (same_member(std::get<I>(component_fields<value_type>::members), member)) {
+				result = std::get<I>(fields);
+			}
+		}
+	}
+
+private:
+	field_pointers_t<T> fields;
+};
+
+/**
+ * The columns of consecutive components whose fields are stored separately.
+ *
+ * Each field is a contiguous array, so loops over single fields can be
+ * vectorized:
+ *
+ *     std::span<float> x = particles.field<&Particle::x>();
+ *
+ * @param T The type of the component, const for read-only access.
+ */
+template <typename T>
+class SplitSpan
+{
+public:
+	using value_type = std::remove_const_t<T>;
+
+	/**
+	 * Creates the span from the first element of each column.
+	 *
+	 * @param fields The pointer to each column in the order of the trait.
+	 * @param count The number of components.
+	 */
+	SplitSpan(field_pointers_t<T> fields, std::size_t count) noexcept
+		: fields(fields), count(count) {}
+
+	/**
+	 * Returns the column of a single field.
+	 *
+	 * @param Member The pointer to the member of the field.
+	 * @return The contiguous values of the field.
+	 */
+	template <auto Member>
+	auto field() const noexcept
+	{
+		constexpr std::size_t index = field_index<value_type>(Member);
+		static_assert(index < std::tuple_size_v<field_pointers_t<T>>, "The member is not a field of the component");
+		return std::span(std::get<index>(fields), count);
+	}
+
+	/**
+	 * @param position The position of the component.
+	 * @return The proxy reference to the component.
+	 */
+	SplitReference<T> operator[](std::size_t position) const noexcept
+	{
+		assert(position < count);
+		return SplitReference<T>(std::apply([&](auto* ... field) {
+			return field_pointers_t<T>(field + position...);
+		}, fields));
+	}
+
+	/**
+	 * @return The number of components.
+	 */
+	std::size_t size() const noexcept
+	{
+		return count;
+	}
+
+private:
+	field_pointers_t<T> fields;
+	std::size_t count;
+};
+
+}
@@ -0,0 +1,381 @@
+#pragma once
+#include "engine/central/signature.h"
+#include "engine/central/storage.h"
+#include "engine/nekolib/paged_array.h"
+#include "engine/nekolib/templates/type_name.h"
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+
+namespace kodanuki
+{
+
+/**
+ * The owning group packs the matching entities at the front of the
+ * storages of its owned components.
+ *
+ * Matching entities have all included and none of the excluded components.
+ * The values of the matches occupy the first positions of every owned
+ * dense storage, in the same order for each of them. Iterating the group
+ * therefore scans the owned dense vectors in lockstep without looking up
+ * any keys. Included components that are not owned are looked up by key.
+ *
+ * The group listens to the storages and matches keys by their signatures
+ * like a query. Entities that start matching are swapped to the end of
+ * the packed range, entities that stop matching are swapped out of it, so
+ * each change costs O(1) swaps. Each storage can only be owned by one
+ * group and owned components can't be bound or shared, since every value
+ * needs a position of its own. After an owned storage was restored by a
+ * snapshot or a rollback, the mapping rebuilds the group before it
+ * returns, see regroup(). Iterations therefore never change the group.
+ *
+ * Groups are created once per type combination by the entity mapping and
+ * live as long as the mapping. The group must not change while it is
+ * iterated, record structural changes into command buffers instead.
+ *
+ * @param O The owned component types, they must also be included.
+ * @param I The included component types.
+ * @param X The excluded component types.
+ */
+template <typename ... O, typename ... I, typename ... X>
+class Group<std::tuple<O...>, std::tuple<I...>, std::tuple<X...>> : public CachedQuery
+{
+	template <typename U>
+	static constexpr bool is_included = (std::is_same_v<U, I> || ...);
+
+public:
+	static_assert(sizeof...(O) > 0, "Groups must own at least one component");
+	static_assert((is_included<O> && ...), "Owned components must be included");
+	static_assert(((std::is_same_v<storage_policy_t<O>, DensePolicy>
+		|| std::is_same_v<storage_policy_t<O>, SplitPolicy>) && ...), "Only dense and split storages can be owned");
+
+	/**
+	 * Creates the group and packs all matching entities of the mapping.
+	 *
+	 * @param mapping The mapping containing the storages.
+	 * @throws std::logic_error if a storage is owned or has bound values.
+	 */
+	Group(EntityMapping& mapping)
+		: owned(&mapping.get<O>()...), includes(&mapping.get<I>()...), excludes(&mapping.get<X>()...),
+		table(&mapping.signatures()), include_mask{component_id<I>()...}, exclude_mask{component_id<X>()...},
+		masked(((component_id<I>() < signature_width) && ...) && ((component_id<X>() < signature_width) && ...))
+	{
+		if (!(std::get<EntityStorage<O>*>(owned)->ownable() && ...)) {
+			throw std::logic_error("The components are owned by another group or bound!");
+		}
+		(std::get<EntityStorage<O>*>(owned)->own(this), ...);
+		(std::get<EntityStorage<I>*>(includes)->subscribe(this), ...);
+		(std::get<EntityStorage<X>*>(excludes)->subscribe(this), ...);
+		rebuild();
+	}
+
+	Group(const Group&) = delete;
+	Group& operator=(const Group&) = delete;
+
+	/**
+	 * Moves the key into or out of the packed range if its membership changed.
+	 *
+	 * @param key The key whose membership changed.
+	 */
+	void refresh(uint64_t key) override
+	{
+		if (stale) {
+			return;
+		}
+		uint32_t index = handle_index(key);
+		uint32_t position = positions.get(index);
+		bool grouped = position != null_position && entities[position] == key;
+		if (grouped == matches(key)) {
+			return;
+		}
+		record_change(!grouped);
+		if (!grouped) {
+			insert(key);
+			return;
+		}
+		uint32_t last = static_cast<uint32_t>(entities.size() - 1);
+		uint64_t back = entities[last];
+		(leave(*std::get<EntityStorage<O>*>(owned), key, back, position, last), ...);
+		entities[position] = back;
+		positions[handle_index(back)] = position;
+		entities.pop_back();
+		positions[index] = null_position;
+	}
+
+	/**
+	 * Marks the group for rebuilding, see regroup().
+	 */
+	void invalidate() override
+	{
+		stale = true;
+	}
+
+	/**
+	 * Rebuilds the group if an owned storage was restored.
+	 *
+	 * This is called by the mapping after loads and rollbacks, which must
+	 * not run concurrently with iterations.
+	 */
+	void regroup() override
+	{
+		if (stale) {
+			rebuild();
+		}
+	}
+
+	/**
+	 * @return Are the owned values packed, i.e. was the group rebuilt?
+	 */
+	bool packed() const noexcept
+	{
+		return !stale;
+	}
+
+	/**
+	 * Returns the keys of the matches in the order of the owned values.
+	 *
+	 * @return The packed vector of matching entity keys.
+	 */
+	const std::vector<uint64_t>& keys() const noexcept
+	{
+		return entities;
+	}
+
+	/**
+	 * @return The number of matching entities.
+	 */
+	std::size_t size() const noexcept override
+	{
+		return entities.size();
+	}
+
+	/**
+	 * @return The name of the group type.
+	 */
+	std::string_view name() const noexcept override
+	{
+		return type_name<Group>();
+	}
+
+private:
+	bool matches(uint64_t key) const
+	{
+		if (masked) {
+			return table->matches(key, include_mask, exclude_mask);
+		}
+		return (std::get<EntityStorage<I>*>(includes)->contains(key) && ...)
+			&& !(std::get<EntityStorage<X>*>(excludes)->contains(key) || ...);
+	}
+
+	// Swaps the values of the key to the end of the packed range.
+	void insert(uint64_t key)
+	{
+		uint32_t position = static_cast<uint32_t>(entities.size());
+		((std::get<EntityStorage<O>*>(owned)->swap_positions(
+			std::get<EntityStorage<O>*>(owned)->position(key), position)), ...);
+		positions[handle_index(key)] = position;
+		entities.push_back(key);
+	}
+
+	// Swaps the values of the key out of the packed range.
+	template <typename T>
+	static void leave(EntityStorage<T>& storage, uint64_t key, uint64_t back, uint32_t position, uint32_t last)
+	{
+		if (storage.contains(key)) {
+			storage.swap_positions(position, last);
+		} else if (back != key) {
+			// The storage removed the key and filled its position with its
+			// last value, so the last match is swapped into the gap.
+			storage.swap_positions(position, storage.position(back));
+		}
+	}
+
+	void rebuild()
+	{
+		stale = false;
+		entities.clear();
+		positions.clear();
+		std::vector<uint64_t> candidates;
+		std::get<0>(owned)->each([&](uint64_t key) { candidates.push_back(key); });
+		for (uint64_t key : candidates) {
+			if (matches(key)) {
+				insert(key);
+			}
+		}
+	}
+
+private:
+	// The position of keys that are not inside the packed range.
+	static constexpr uint32_t null_position = ~uint32_t(0);
+
+private:
+	std::tuple<EntityStorage<O>*...> owned;
+	std::tuple<EntityStorage<I>*...> includes;
+	std::tuple<EntityStorage<X>*...> excludes;
+	const SignatureTable* table;
+	Signature include_mask;
+	Signature exclude_mask;
+	// Are all components tracked by the signatures, see Query?
+	bool masked;
+	PagedArray<uint32_t> positions = PagedArray<uint32_t>(null_position);
+	std::vector<uint64_t> entities;
+	bool stale = false;
+};
+
+template <typename Owned, typename Include, typename Exclude>
+Group<Owned, Include, Exclude>& EntityMapping::group()
+{
+	auto type = std::type_index(typeid(Group<Owned, Include, Exclude>));
+	auto& group = queries[type];
+	if (!group) {
+		group = std::make_unique<Group<Owned, Include, Exclude>>(*this);
+	}
+	return static_cast<Group<Owned, Include, Exclude>&>(*group);
+}
+
+template <typename iterate_types, typename owned_types>
+struct GroupIterator;
+
+/**
+ * Iterates over the packed range of a group.
+ *
+ * Owned components are read at the position of the match, the other
+ * components are looked up by the key of the match.
+ */
+template <typename ... T, typename ... O>
+struct GroupIterator<std::tuple<T...>, std::tuple<O...>>
+{
+	GroupIterator(EntityMapping& mapping, std::span<const uint64_t> entities, uint64_t tick)
+		: storages(&mapping.get<std::remove_const_t<T>>()...), entities(entities), tick(tick) {}
+
+	struct iterator
+	{
+		void operator++()
+		{
+			position++;
+		}
+
+		bool operator!=(const iterator& other) const
+		{
+			return position != other.position;
+		}
+
+		std::tuple<component_reference_t<T>...> operator*() const
+		{
+			return {range->template access<T>(position)...};
+		}
+
+		const GroupIterator* range;
+		std::size_t position;
+	};
+
+	iterator begin() const
+	{
+		return {this, 0};
+	}
+
+	iterator end() const
+	{
+		return {this, entities.size()};
+	}
+
+	std::tuple<component_reference_t<T>...> operator[](std::size_t position) const
+	{
+		return *iterator{this, position};
+	}
+
+	std::size_t size() const
+	{
+		return entities.size();
+	}
+
+	/**
+	 * Gives the entities their own copies of shared mutable components.
+	 *
+	 * Owned components are never shared, see EntityIterator::unshare().
+	 */
+	void unshare() const
+	{
+		(unshare_storage<T>(), ...);
+	}
+
+	/**
+	 * Returns the packed arrays of the iterated components.
+	 *
+	 * Each column has one element per match, entities are given by their
+	 * keys. Every element of a mutable column counts as changed, so the
+	 * loops over the columns can be vectorized.
+	 *
+	 * @return The tuple of columns in the order of the iterated types.
+	 */
+	auto columns() const
+	{
+		static_assert(((is_owned<T> || std::is_same_v<std::remove_const_t<T>, Entity>) && ...),
+			"Only owned components and entities can be accessed as columns");
+		return std::tuple(column<T>()...);
+	}
+
+private:
+	template <typename U>
+	static constexpr bool is_owned = (std::is_same_v<std::remove_const_t<U>, O> || ...);
+
+	// Non-const access counts as a change of the component.
+	template <typename U>
+	component_reference_t<U> access(std::size_t position) const
+	{
+		auto storage = std::get<EntityStorage<std::remove_const_t<U>>*>(storages);
+		constexpr bool read_only = std::is_const_v<U> || std::is_same_v<U, Entity>;
+		if constexpr (is_owned<U> && read_only) {
+			return storage->value_at(static_cast<uint32_t>(position));
+		} else if constexpr (is_owned<U>) {
+			return storage->touch_at(static_cast<uint32_t>(position), tick);
+		} else if constexpr (read_only) {
+			return (*storage)[entities[position]];
+		} else {
+			return storage->touch(entities[position], tick);
+		}
+	}
+
+	template <typename U>
+	auto column() const
+	{
+		auto storage = std::get<EntityStorage<std::remove_const_t<U>>*>(storages);
+		uint32_t count = static_cast<uint32_t>(entities.size());
+		if constexpr (std::is_same_v<std::remove_const_t<U>, Entity>) {
+			return entities;
+		} else if constexpr (std::is_const_v<U>) {
+			return std::as_const(*storage).column(count);
+		} else {
+			return storage->touch_column(count, tick);
+		}
+	}
+
+	template <typename U>
+	void unshare_storage() const
+	{
+		if constexpr (!is_owned<U> && !std::is_const_v<U> && !std::is_same_v<U, Entity>) {
+			auto storage = std::get<EntityStorage<U>*>(storages);
+			if (storage->shared()) {
+				for (uint64_t id : entities) {
+					storage->unshare(id);
+				}
+			}
+		}
+	}
+
+private:
+	// The storages are resolved once, not for every element.
+	std::tuple<EntityStorage<std::remove_const_t<T>>*...> storages;
+	std::span<const uint64_t> entities;
+	uint64_t tick;
+};
+
+}
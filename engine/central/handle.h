@@ -0,0 +1,163 @@
+#pragma once
+#include "engine/central/snapshot.h"
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+
+namespace kodanuki
+{
+
+/**
+ * Each handle packs a 32-bit slot index and a 32-bit generation.
+ *
+ * The index is the position of the entity inside the slot indexed arrays
+ * of the storages. The generation is incremented each time the slot is
+ * released. Handles to recycled slots are therefore never equal to the
+ * handle of the new occupant.
+ */
+constexpr uint32_t handle_index(uint64_t handle) noexcept
+{
+	return static_cast<uint32_t>(handle);
+}
+
+/**
+ * @param handle The handle containing the generation.
+ * @return The generation of the handle (upper 32 bits).
+ */
+constexpr uint32_t handle_generation(uint64_t handle) noexcept
+{
+	return static_cast<uint32_t>(handle >> 32);
+}
+
+/**
+ * @param index The slot index of the handle.
+ * @param generation The generation of the slot.
+ * @return The handle packing both values.
+ */
+constexpr uint64_t make_handle(uint32_t index, uint32_t generation) noexcept
+{
+	return static_cast<uint64_t>(generation) << 32 | index;
+}
+
+/**
+ * The handle value that is never given out by the allocator.
+ */
+constexpr uint64_t null_handle = ~uint64_t(0);
+
+/**
+ * The handle allocator recycles released slots.
+ *
+ * Released slots are kept inside a free list and are reused by the next
+ * created handle with an incremented generation. The number of slots is
+ * therefore bounded by the maximum number of handles alive at once.
+ */
+class HandleAllocator
+{
+public:
+	/**
+	 * Creates a new handle, preferring recycled slots.
+	 *
+	 * @return The new handle.
+	 */
+	uint64_t create()
+	{
+		if (free_slots.empty()) {
+			uint32_t index = static_cast<uint32_t>(generations.size());
+			assert(index != handle_index(null_handle));
+			generations.push_back(0);
+			changes++;
+			return make_handle(index, 0);
+		}
+		changes++;
+		uint32_t index = free_slots.back();
+		free_slots.pop_back();
+		return make_handle(index, generations[index]);
+	}
+
+	/**
+	 * Releases the handle so that its slot can be recycled.
+	 *
+	 * Slots whose generation would overflow are retired instead, so that
+	 * no handle is ever given out twice.
+	 *
+	 * @param handle The handle that should be released.
+	 */
+	void destroy(uint64_t handle)
+	{
+		if (!alive(handle)) {
+			return;
+		}
+		changes++;
+		uint32_t index = handle_index(handle);
+		if (++generations[index] != handle_generation(null_handle)) {
+			free_slots.push_back(index);
+		}
+	}
+
+	/**
+	 * Returns true iff the handle was created and not yet released.
+	 *
+	 * @param handle The handle to check.
+	 * @return Is the handle alive?
+	 */
+	bool alive(uint64_t handle) const
+	{
+		uint32_t index = handle_index(handle);
+		return index < generations.size()
+			&& generations[index] == handle_generation(handle);
+	}
+
+	/**
+	 * Returns the number of slots ever used by this allocator.
+	 *
+	 * @return The number of slots.
+	 */
+	uint32_t capacity() const
+	{
+		return static_cast<uint32_t>(generations.size());
+	}
+
+	/**
+	 * Writes the generations and free slots into the snapshot.
+	 *
+	 * @param writer The writer of the snapshot.
+	 */
+	void save(SnapshotWriter& writer) const
+	{
+		writer.write_array<uint32_t>(generations);
+		writer.write_array<uint32_t>(free_slots);
+	}
+
+	/**
+	 * Reads the generations and free slots written by save().
+	 *
+	 * @param reader The reader of the snapshot.
+	 */
+	void load(SnapshotReader& reader)
+	{
+		reader.read_array(generations);
+		reader.read_array(free_slots);
+		changes++;
+	}
+
+	/**
+	 * Returns the number of changes made to the allocator.
+	 *
+	 * Every change increments the number, so comparing it tells whether
+	 * the allocator changed since it was last copied.
+	 *
+	 * @return The number of changes.
+	 */
+	uint64_t version() const noexcept
+	{
+		return changes;
+	}
+
+private:
+	std::vector<uint32_t> generations;
+	std::vector<uint32_t> free_slots;
+	uint64_t changes = 0;
+};
+
+}
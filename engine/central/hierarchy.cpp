@@ -0,0 +1,180 @@
+#include "engine/central/hierarchy.h"
+#include <algorithm>
+
+
+namespace kodanuki
+{
+
+void Hierarchy::insert(uint64_t key, uint64_t parent)
+{
+	assert(!contains(key));
+	uint32_t index = handle_index(key);
+	if (index >= nodes.size()) {
+		nodes.resize(index + 1);
+	}
+	nodes[index] = {.key = key, .root = index};
+	count++;
+	dirty = true;
+	changes++;
+	if (parent != null_handle) {
+		assert(contains(parent));
+		link(index, handle_index(parent));
+	}
+}
+
+void Hierarchy::insert_many(std::span<const uint64_t> keys, uint64_t parent)
+{
+	assert(parent == null_handle || contains(parent));
+	uint32_t last = 0;
+	for (uint64_t key : keys) {
+		last = std::max(last, handle_index(key));
+	}
+	if (!keys.empty() && last >= nodes.size()) {
+		nodes.resize(last + 1);
+	}
+	uint32_t parent_index = parent == null_handle ? null_slot : handle_index(parent);
+	for (uint64_t key : keys) {
+		assert(!contains(key));
+		uint32_t index = handle_index(key);
+		nodes[index] = {.key = key, .root = index};
+		if (parent_index != null_slot) {
+			link(index, parent_index);
+		}
+	}
+	count += keys.size();
+	dirty = true;
+	changes++;
+}
+
+void Hierarchy::erase(uint64_t key)
+{
+	assert(contains(key) && node(key).children == 0);
+	uint32_t index = handle_index(key);
+	unlink(index);
+	nodes[index] = {};
+	count--;
+	dirty = true;
+	changes++;
+}
+
+void Hierarchy::set_parent(uint64_t key, uint64_t parent)
+{
+	assert(contains(key) && (parent == null_handle || contains(parent)));
+	uint32_t index = handle_index(key);
+	uint32_t parent_index = parent == null_handle ? null_slot : handle_index(parent);
+	if (parent_index == nodes[index].parent) {
+		return;
+	}
+	if (parent_index != null_slot && nodes[parent_index].root == nodes[index].root) {
+		// The parent might be a descendant, which would create a cycle.
+		for (uint32_t i = parent_index; i != null_slot; i = nodes[i].parent) {
+			if (i == index) {
+				return;
+			}
+		}
+	}
+	unlink(index);
+	uint32_t root = index;
+	uint32_t depth = 0;
+	if (parent_index != null_slot) {
+		link(index, parent_index);
+		root = nodes[parent_index].root;
+		depth = nodes[parent_index].depth + 1;
+	}
+	dirty = true;
+	changes++;
+	// Parents are visited first, so their depth is already updated.
+	walk(index, [&](uint32_t current) {
+		Node& node = nodes[current];
+		node.root = root;
+		node.depth = current == index ? depth : nodes[node.parent].depth + 1;
+	});
+}
+
+void Hierarchy::collect(uint64_t key, std::vector<uint64_t>& keys) const
+{
+	assert(contains(key));
+	walk(handle_index(key), [&](uint32_t current) {
+		keys.push_back(nodes[current].key);
+	});
+}
+
+std::span<const uint64_t> Hierarchy::ordered() const
+{
+	if (!dirty) {
+		return order;
+	}
+	// Counting sort by depth, nodes of the same depth keep the slot order.
+	std::vector<uint64_t> offsets;
+	for (const Node& node : nodes) {
+		if (node.key != null_handle) {
+			if (node.depth + 1 >= offsets.size()) {
+				offsets.resize(node.depth + 2);
+			}
+			offsets[node.depth + 1]++;
+		}
+	}
+	for (uint64_t depth = 1; depth < offsets.size(); depth++) {
+		offsets[depth] += offsets[depth - 1];
+	}
+	order.resize(count);
+	for (const Node& node : nodes) {
+		if (node.key != null_handle) {
+			order[offsets[node.depth]++] = node.key;
+		}
+	}
+	dirty = false;
+	return order;
+}
+
+void Hierarchy::save(SnapshotWriter& writer) const
+{
+	writer.write(count);
+	writer.write_array<Node>(nodes);
+}
+
+void Hierarchy::load(SnapshotReader& reader)
+{
+	count = reader.read<uint64_t>();
+	reader.read_array(nodes);
+	dirty = true;
+	changes++;
+}
+
+void Hierarchy::link(uint32_t index, uint32_t parent)
+{
+	Node& node = nodes[index];
+	Node& parent_node = nodes[parent];
+	node.parent = parent;
+	node.prev_sibling = null_slot;
+	node.next_sibling = parent_node.first_child;
+	if (parent_node.first_child != null_slot) {
+		nodes[parent_node.first_child].prev_sibling = index;
+	}
+	parent_node.first_child = index;
+	parent_node.children++;
+	node.root = parent_node.root;
+	node.depth = parent_node.depth + 1;
+}
+
+void Hierarchy::unlink(uint32_t index)
+{
+	Node& node = nodes[index];
+	if (node.parent == null_slot) {
+		return;
+	}
+	if (node.prev_sibling != null_slot) {
+		nodes[node.prev_sibling].next_sibling = node.next_sibling;
+	} else {
+		nodes[node.parent].first_child = node.next_sibling;
+	}
+	if (node.next_sibling != null_slot) {
+		nodes[node.next_sibling].prev_sibling = node.prev_sibling;
+	}
+	nodes[node.parent].children--;
+	node.parent = null_slot;
+	node.prev_sibling = null_slot;
+	node.next_sibling = null_slot;
+}
+
+}
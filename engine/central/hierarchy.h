@@ -0,0 +1,356 @@
+#pragma once
+#include "engine/central/handle.h"
+#include "engine/central/snapshot.h"
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+
+namespace kodanuki
+{
+
+/**
+ * The hierarchy stores the parent relationship between entities.
+ *
+ * Each entity is a node inside a contiguous array indexed by the slot
+ * index of its handle. A node links to its parent, its first child and
+ * its previous and next sibling, so the children of an entity form an
+ * intrusive list. Linking and unlinking a node is O(1) and iterating the
+ * children never allocates.
+ *
+ * The depth and the root of each node are cached. Changing the parent
+ * updates them for the whole sub-tree of the node. New children are
+ * added to the front, so the children are iterated newest first.
+ */
+class Hierarchy
+{
+private:
+	// The slot index that marks missing links.
+	static constexpr uint32_t null_slot = handle_index(null_handle);
+
+public:
+	/**
+	 * Iterable range over the children of a node.
+	 *
+	 * The range yields the keys of the children, optionally skipping one
+	 * of them. It stays valid as long as the children don't change.
+	 */
+	class Children
+	{
+	public:
+		class Iterator
+		{
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using difference_type = std::ptrdiff_t;
+			using value_type = uint64_t;
+
+			Iterator() = default;
+			Iterator(const Hierarchy* hierarchy, uint32_t index, uint32_t skip)
+				: hierarchy(hierarchy), index(index), skip(skip)
+			{
+				if (index != null_slot && index == skip) {
+					++*this;
+				}
+			}
+
+			uint64_t operator*() const
+			{
+				return hierarchy->nodes[index].key;
+			}
+
+			Iterator& operator++()
+			{
+				do {
+					index = hierarchy->nodes[index].next_sibling;
+				} while (index != null_slot && index == skip);
+				return *this;
+			}
+
+			Iterator operator++(int)
+			{
+				Iterator copy = *this;
+				++*this;
+				return copy;
+			}
+
+			bool operator==(const Iterator& other) const
+			{
+				return index == other.index;
+			}
+
+		private:
+			const Hierarchy* hierarchy = nullptr;
+			uint32_t index = null_slot;
+			uint32_t skip = null_slot;
+		};
+
+		Children(const Hierarchy& hierarchy, uint32_t parent, uint32_t skip = null_slot)
+			: hierarchy(&hierarchy), parent(parent), skip(skip) {}
+
+		Iterator begin() const
+		{
+			if (parent == null_slot) {
+				return end();
+			}
+			return {hierarchy, hierarchy->nodes[parent].first_child, skip};
+		}
+
+		Iterator end() const
+		{
+			return {};
+		}
+
+		/**
+		 * @return The number of children inside the range.
+		 */
+		uint64_t size() const
+		{
+			if (parent == null_slot) {
+				return 0;
+			}
+			uint64_t count = hierarchy->nodes[parent].children;
+			bool skipped = skip != null_slot && hierarchy->nodes[skip].parent == parent;
+			return count - skipped;
+		}
+
+		/**
+		 * @return Does the range contain no children?
+		 */
+		bool empty() const
+		{
+			return size() == 0;
+		}
+
+	private:
+		const Hierarchy* hierarchy;
+		uint32_t parent;
+		uint32_t skip;
+	};
+
+public:
+	/**
+	 * Inserts the key as a new node.
+	 *
+	 * @param key The key of the new node.
+	 * @param parent The key of the parent or null_handle for a root.
+	 */
+	void insert(uint64_t key, uint64_t parent = null_handle);
+
+	/**
+	 * Inserts the keys as new nodes below the same parent.
+	 *
+	 * The nodes are allocated once and linked in a single pass, the
+	 * result is the same as inserting them one after another.
+	 *
+	 * @param keys The keys of the new nodes.
+	 * @param parent The key of the parent or null_handle for roots.
+	 */
+	void insert_many(std::span<const uint64_t> keys, uint64_t parent = null_handle);
+
+	/**
+	 * Removes the node of the key.
+	 *
+	 * The children of the node must be removed beforehand.
+	 *
+	 * @param key The key of the removed node.
+	 */
+	void erase(uint64_t key);
+
+	/**
+	 * Changes the parent of the node and moves its sub-tree.
+	 *
+	 * Does nothing if the new parent is inside the sub-tree of the node.
+	 *
+	 * @param key The key of the node.
+	 * @param parent The key of the parent or null_handle for a root.
+	 */
+	void set_parent(uint64_t key, uint64_t parent);
+
+	/**
+	 * @param key The key of the node.
+	 * @return Is the key a node of this hierarchy?
+	 */
+	bool contains(uint64_t key) const noexcept
+	{
+		uint32_t index = handle_index(key);
+		return index < nodes.size() && nodes[index].key == key;
+	}
+
+	/**
+	 * @param key The key of the node.
+	 * @return The key of the parent or null_handle for roots.
+	 */
+	uint64_t parent(uint64_t key) const noexcept
+	{
+		uint32_t parent = node(key).parent;
+		return parent == null_slot ? null_handle : nodes[parent].key;
+	}
+
+	/**
+	 * @param key The key of the node.
+	 * @return The key of the root of the tree containing the node.
+	 */
+	uint64_t root(uint64_t key) const noexcept
+	{
+		return nodes[node(key).root].key;
+	}
+
+	/**
+	 * @param key The key of the node.
+	 * @return The number of ancestors of the node.
+	 */
+	uint32_t depth(uint64_t key) const noexcept
+	{
+		return node(key).depth;
+	}
+
+	/**
+	 * @param key The key of the node.
+	 * @return The key of the first child or null_handle if there is none.
+	 */
+	uint64_t first_child(uint64_t key) const noexcept
+	{
+		uint32_t child = node(key).first_child;
+		return child == null_slot ? null_handle : nodes[child].key;
+	}
+
+	/**
+	 * @param key The key of the node.
+	 * @return The children of the node.
+	 */
+	Children children(uint64_t key) const noexcept
+	{
+		assert(contains(key));
+		return {*this, handle_index(key)};
+	}
+
+	/**
+	 * @param key The key of the node.
+	 * @return The other children of the parent of the node.
+	 */
+	Children siblings(uint64_t key) const noexcept
+	{
+		uint32_t index = handle_index(key);
+		return {*this, node(key).parent, index};
+	}
+
+	/**
+	 * Appends the keys of the sub-tree of the node in pre-order.
+	 *
+	 * Each node comes before its descendants. The walk follows the links
+	 * of the nodes, so it needs neither recursion nor a stack.
+	 *
+	 * @param key The key of the node at the top of the sub-tree.
+	 * @param keys The vector to which the keys are appended.
+	 */
+	void collect(uint64_t key, std::vector<uint64_t>& keys) const;
+
+	/**
+	 * Returns the keys of all nodes ordered by depth.
+	 *
+	 * Each parent comes before its children, so propagating values from
+	 * the roots down is a single pass over this list. The list is rebuilt
+	 * lazily after the hierarchy has changed, which is not thread-safe.
+	 *
+	 * @return The keys of all nodes ordered by depth.
+	 */
+	std::span<const uint64_t> ordered() const;
+
+	/**
+	 * @return The number of nodes.
+	 */
+	uint64_t size() const noexcept
+	{
+		return count;
+	}
+
+	/**
+	 * Returns the number of changes made to the hierarchy.
+	 *
+	 * Every change increments the number, so comparing it tells whether
+	 * the hierarchy changed since it was last copied.
+	 *
+	 * @return The number of changes.
+	 */
+	uint64_t version() const noexcept
+	{
+		return changes;
+	}
+
+	/**
+	 * Writes the nodes into the snapshot as one block.
+	 *
+	 * @param writer The writer of the snapshot.
+	 */
+	void save(SnapshotWriter& writer) const;
+
+	/**
+	 * Reads the nodes written by save().
+	 *
+	 * @param reader The reader of the snapshot.
+	 */
+	void load(SnapshotReader& reader);
+
+private:
+	struct Node
+	{
+		uint64_t key = null_handle;
+		uint32_t parent = null_slot;
+		uint32_t first_child = null_slot;
+		uint32_t prev_sibling = null_slot;
+		uint32_t next_sibling = null_slot;
+		uint32_t root = null_slot;
+		uint32_t depth = 0;
+		uint32_t children = 0;
+		// Snapshots write the nodes as they are, so the padding is explicit.
+		uint32_t padding = 0;
+	};
+	static_assert(std::has_unique_object_representations_v<Node>, "Nodes must not have implicit padding");
+
+	const Node& node(uint64_t key) const noexcept
+	{
+		assert(contains(key));
+		return nodes[handle_index(key)];
+	}
+
+	// Calls the function for each node of the sub-tree in pre-order.
+	template <typename Function>
+	void walk(uint32_t index, Function function) const
+	{
+		uint32_t current = index;
+		while (true) {
+			function(current);
+			if (nodes[current].first_child != null_slot) {
+				current = nodes[current].first_child;
+				continue;
+			}
+			while (current != index && nodes[current].next_sibling == null_slot) {
+				current = nodes[current].parent;
+			}
+			if (current == index) {
+				return;
+			}
+			current = nodes[current].next_sibling;
+		}
+	}
+
+	// Adds the node to the front of the children of the parent.
+	void link(uint32_t index, uint32_t parent);
+
+	// Removes the node from the children of its parent.
+	void unlink(uint32_t index);
+
+private:
+	std::vector<Node> nodes;
+	uint64_t count = 0;
+	uint64_t changes = 0;
+	// The cached result of ordered(), only valid if not dirty.
+	mutable std::vector<uint64_t> order;
+	mutable bool dirty = false;
+};
+
+}
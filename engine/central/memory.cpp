@@ -0,0 +1,135 @@
+#include "engine/central/memory.h"
+#include <algorithm>
+#include <cassert>
+
+
+namespace kodanuki
+{
+
+void* CountingResource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+	void* pointer = upstream->allocate(bytes, alignment);
+	allocate_count.fetch_add(1, std::memory_order_relaxed);
+	live_bytes.fetch_add(bytes, std::memory_order_relaxed);
+	return pointer;
+}
+
+void CountingResource::do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment)
+{
+	upstream->deallocate(pointer, bytes, alignment);
+	deallocate_count.fetch_add(1, std::memory_order_relaxed);
+	live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool CountingResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
+
+FrameArena::~FrameArena()
+{
+	assert(allocations_count == 0);
+	while (top) {
+		Block* previous = top->previous;
+		upstream->deallocate(top, top->size, alignof(std::max_align_t));
+		top = previous;
+	}
+}
+
+uint64_t FrameArena::capacity() const
+{
+	std::lock_guard lock(mutex);
+	uint64_t size = 0;
+	for (Block* block = top; block; block = block->previous) {
+		size += block->size;
+	}
+	return size;
+}
+
+uint64_t FrameArena::live() const
+{
+	std::lock_guard lock(mutex);
+	return allocations_count;
+}
+
+void* FrameArena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+	std::lock_guard lock(mutex);
+	if (allocations_count == 0 && blocks_count > 1) {
+		merge();
+	}
+	auto fits = [&] {
+		uintptr_t begin = reinterpret_cast<uintptr_t>(top);
+		uintptr_t aligned = (begin + offset + alignment - 1) / alignment * alignment;
+		if (aligned - begin + bytes > top->size) {
+			return false;
+		}
+		offset = aligned - begin + bytes;
+		return true;
+	};
+	if (!top || !fits()) {
+		grow(sizeof(Block) + alignment + bytes);
+		fits();
+	}
+	allocations_count++;
+	return reinterpret_cast<std::byte*>(top) + offset - bytes;
+}
+
+void FrameArena::do_deallocate(void*, std::size_t, std::size_t)
+{
+	std::lock_guard lock(mutex);
+	assert(allocations_count > 0);
+	// Deallocations never reach the upstream resource, the blocks are
+	// merged by the next allocation instead.
+	if (--allocations_count == 0) {
+		offset = sizeof(Block);
+	}
+}
+
+bool FrameArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
+
+void FrameArena::grow(uint64_t bytes)
+{
+	uint64_t size = std::max(bytes, top ? 2 * top->size : initial_size);
+	Block* block = static_cast<Block*>(upstream->allocate(size, alignof(std::max_align_t)));
+	*block = {top, size};
+	top = block;
+	offset = sizeof(Block);
+	blocks_count++;
+}
+
+void FrameArena::merge()
+{
+	// The next frame probably needs as much memory as this one.
+	uint64_t size = 0;
+	while (top) {
+		Block* previous = top->previous;
+		size += top->size;
+		upstream->deallocate(top, top->size, alignof(std::max_align_t));
+		top = previous;
+	}
+	blocks_count = 0;
+	grow(size);
+}
+
+void* PoolResource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+	std::lock_guard lock(mutex);
+	return pool.allocate(bytes, alignment);
+}
+
+void PoolResource::do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment)
+{
+	std::lock_guard lock(mutex);
+	pool.deallocate(pointer, bytes, alignment);
+}
+
+bool PoolResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
+
+}
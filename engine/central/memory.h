@@ -0,0 +1,174 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+
+
+namespace kodanuki
+{
+
+/**
+ * The counting resource forwards allocations and counts them.
+ *
+ * Each entity mapping passes the allocations of its storages and of its
+ * frame arena through one counting resource. Comparing the counters
+ * before and after a frame tells whether the frame allocated any memory
+ * from the upstream resource, which is the heap by default.
+ *
+ * The counters are atomic, so different threads may allocate at once.
+ */
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+	/**
+	 * Creates the resource on top of the upstream resource.
+	 *
+	 * @param upstream The resource that allocates the memory.
+	 */
+	explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) noexcept
+		: upstream(upstream) {}
+
+	/**
+	 * @return The number of allocations so far.
+	 */
+	uint64_t allocations() const noexcept
+	{
+		return allocate_count.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @return The number of deallocations so far.
+	 */
+	uint64_t deallocations() const noexcept
+	{
+		return deallocate_count.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @return The number of bytes that are currently allocated.
+	 */
+	uint64_t bytes() const noexcept
+	{
+		return live_bytes.load(std::memory_order_relaxed);
+	}
+
+private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+	void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+	std::pmr::memory_resource* upstream;
+	std::atomic<uint64_t> allocate_count = 0;
+	std::atomic<uint64_t> deallocate_count = 0;
+	std::atomic<uint64_t> live_bytes = 0;
+};
+
+/**
+ * The frame arena is a monotonic resource for short-lived temporaries.
+ *
+ * Allocations bump an offset inside the current block and deallocations
+ * only count the allocations that are still alive. Once every allocation
+ * was returned, the arena rewinds to the start of its memory. If the
+ * allocations did not fit into a single block, the next allocation
+ * merges the blocks into one large enough for all of them, so that
+ * deallocations never reach the upstream resource. After the first few
+ * frames the temporaries of each frame therefore reuse the same memory
+ * and nothing is allocated from the upstream resource.
+ *
+ * Temporaries that are kept alive across frames keep the arena from
+ * rewinding, so they should be released at the end of each frame. The
+ * arena is guarded by a mutex, since systems may run on any thread.
+ */
+class FrameArena : public std::pmr::memory_resource
+{
+public:
+	/**
+	 * Creates the arena without any memory.
+	 *
+	 * @param upstream The resource that allocates the blocks.
+	 */
+	explicit FrameArena(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) noexcept
+		: upstream(upstream) {}
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+	~FrameArena() override;
+
+	/**
+	 * @return The number of bytes inside the blocks of the arena.
+	 */
+	uint64_t capacity() const;
+
+	/**
+	 * @return The number of allocations that were not returned yet.
+	 */
+	uint64_t live() const;
+
+private:
+	// Each block starts with this header, the blocks form a stack.
+	struct Block
+	{
+		Block* previous;
+		uint64_t size;
+	};
+
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+	void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+	// Pushes a new block that fits at least the given number of bytes.
+	void grow(uint64_t bytes);
+
+	// Releases all blocks, keeping a single one as large as all of them.
+	void merge();
+
+private:
+	// The size of the first block.
+	static constexpr uint64_t initial_size = 4096;
+
+private:
+	std::pmr::memory_resource* upstream;
+	mutable std::mutex mutex;
+	Block* top = nullptr;
+	uint64_t offset = 0;
+	uint64_t blocks_count = 0;
+	uint64_t allocations_count = 0;
+};
+
+/**
+ * The pool resource recycles small allocations of one storage.
+ *
+ * Each entity storage owns a pool. The dense values and any allocator
+ * aware members of them are allocated from it, see EntityStorage, and
+ * components may allocate their own buffers from it as well. Freed
+ * blocks are kept for the next allocation of the same size, so buffers
+ * that are replaced every frame stop reaching the upstream resource.
+ *
+ * The pool is guarded by a mutex, since components of one storage may
+ * be written from multiple threads during parallel iteration.
+ */
+class PoolResource : public std::pmr::memory_resource
+{
+public:
+	/**
+	 * Creates the pool on top of the upstream resource.
+	 *
+	 * @param upstream The resource that allocates the chunks of the pool.
+	 */
+	explicit PoolResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+		: pool(upstream) {}
+
+private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+	void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+	std::mutex mutex;
+	std::pmr::unsynchronized_pool_resource pool;
+};
+
+}
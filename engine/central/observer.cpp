@@ -0,0 +1,47 @@
+#include "engine/central/observer.h"
+
+
+namespace kodanuki
+{
+
+void Observer::refresh(uint64_t key)
+{
+	if (storage.contains(key)) {
+		if (!add_callbacks.empty()) {
+			added.push_back(key);
+		}
+	} else if (!remove_callbacks.empty()) {
+		removed.push_back(key);
+	}
+}
+
+void Observer::on_add(Callback callback)
+{
+	add_callbacks.push_back(std::move(callback));
+}
+
+void Observer::on_remove(Callback callback)
+{
+	remove_callbacks.push_back(std::move(callback));
+}
+
+void Observer::deliver()
+{
+	// Both arrays are swapped first, so callbacks record into empty ones.
+	added_batch.clear();
+	removed_batch.clear();
+	std::swap(added_batch, added);
+	std::swap(removed_batch, removed);
+	if (!added_batch.empty()) {
+		for (Callback& callback : add_callbacks) {
+			callback(added_batch);
+		}
+	}
+	if (!removed_batch.empty()) {
+		for (Callback& callback : remove_callbacks) {
+			callback(removed_batch);
+		}
+	}
+}
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "engine/central/entity.h"
+#include "engine/central/storage.h"
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+
+namespace kodanuki
+{
+
+/**
+ * The observer collects the entities whose component was added or removed.
+ *
+ * Each observer listens to the storage of one component type. The events
+ * are not delivered immediately, instead the entities are appended to one
+ * contiguous array for additions and one for removals. Delivering hands
+ * each array to the callbacks at once, usually once per frame, see
+ * World::flush().
+ *
+ * Events are only recorded while callbacks for them are registered.
+ * Removal events contain the entity after the removal, the component can
+ * no longer be accessed. Destroyed entities are removed from the storage
+ * of the Entity component, so they are reported as its removals.
+ *
+ * Callbacks must not register further callbacks at the same observer.
+ */
+class Observer final : public StorageListener
+{
+public:
+	// The function called with the entities of one batch.
+	using Callback = std::function<void(std::span<const Entity>)>;
+
+	/**
+	 * Creates the observer for the given storage.
+	 *
+	 * The observer must be subscribed to the storage by the caller.
+	 *
+	 * @param storage The storage that is observed.
+	 */
+	explicit Observer(const BaseStorage& storage) : storage(storage) {}
+
+	Observer(const Observer&) = delete;
+	Observer& operator=(const Observer&) = delete;
+
+	/**
+	 * Records the event for the key.
+	 *
+	 * @param key The key whose membership changed.
+	 */
+	void refresh(uint64_t key) override;
+
+	/**
+	 * Registers the callback for entities that received the component.
+	 *
+	 * @param callback The function called with each batch.
+	 */
+	void on_add(Callback callback);
+
+	/**
+	 * Registers the callback for entities that lost the component.
+	 *
+	 * @param callback The function called with each batch.
+	 */
+	void on_remove(Callback callback);
+
+	/**
+	 * Delivers the recorded events to the callbacks.
+	 *
+	 * Additions are delivered before removals. Events that are recorded
+	 * while delivering are kept for the next delivery.
+	 */
+	void deliver();
+
+private:
+	const BaseStorage& storage;
+	std::vector<Entity> added;
+	std::vector<Entity> removed;
+	// The batches that are currently delivered, swapped with the above.
+	std::vector<Entity> added_batch;
+	std::vector<Entity> removed_batch;
+	std::vector<Callback> add_callbacks;
+	std::vector<Callback> remove_callbacks;
+};
+
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include "engine/central/signature.h"
+#include "engine/central/storage.h"
+#include "engine/nekolib/paged_array.h"
+#include "engine/nekolib/templates/type_name.h"
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <typeindex>
+#include <vector>
+
+
+namespace kodanuki
+{
+
+/**
+ * The query caches the entities that match a combination of components.
+ *
+ * Matching entities have all included and none of the excluded components.
+ * The query listens to the storages of these components and reevaluates
+ * a single key whenever it is inserted into or removed from one of them.
+ * The key is matched against the include and exclude masks of the query
+ * by its signature, see SignatureTable, unless the ids of the components
+ * are too large to be tracked.
+ * The matches are kept inside a packed vector, so iterating them never
+ * has to search the storages.
+ *
+ * Queries are created once per type combination by the entity mapping
+ * and live as long as the mapping. The order of the matches is arbitrary.
+ *
+ * @param I The included component types.
+ * @param X The excluded component types.
+ */
+template <typename ... I, typename ... X>
+class Query<std::tuple<I...>, std::tuple<X...>> : public CachedQuery
+{
+public:
+	/**
+	 * Creates the query and matches all entities inside the mapping.
+	 *
+	 * @param mapping The mapping containing the storages.
+	 */
+	Query(EntityMapping& mapping)
+		: includes(&mapping.get<I>()...), excludes(&mapping.get<X>()...), table(&mapping.signatures()),
+		include_mask{component_id<I>()...}, exclude_mask{component_id<X>()...},
+		masked(((component_id<I>() < signature_width) && ...) && ((component_id<X>() < signature_width) && ...))
+	{
+		(std::get<EntityStorage<I>*>(includes)->subscribe(this), ...);
+		(std::get<EntityStorage<X>*>(excludes)->subscribe(this), ...);
+		auto refresh_key = [this](uint64_t key) { refresh(key); };
+		if constexpr (tag_pair) {
+			std::get<0>(includes)->each_common(*std::get<1>(includes), refresh_key);
+		} else if constexpr (sizeof...(I) > 0) {
+			std::get<0>(includes)->each(refresh_key);
+		}
+	}
+
+	Query(const Query&) = delete;
+	Query& operator=(const Query&) = delete;
+
+	/**
+	 * Reevaluates whether the key matches this query.
+	 *
+	 * @param key The key whose membership changed.
+	 */
+	void refresh(uint64_t key) override
+	{
+		uint32_t index = handle_index(key);
+		uint32_t position = positions.get(index);
+		bool matched = position != null_position && entities[position] == key;
+		if (matched == matches(key)) {
+			return;
+		}
+		record_change(!matched);
+		if (!matched) {
+			positions[index] = static_cast<uint32_t>(entities.size());
+			entities.push_back(key);
+			return;
+		}
+		entities[position] = entities.back();
+		positions[handle_index(entities[position])] = position;
+		entities.pop_back();
+		positions[index] = null_position;
+	}
+
+	/**
+	 * @return The packed vector of matching entity keys.
+	 */
+	const std::vector<uint64_t>& keys() const noexcept
+	{
+		return entities;
+	}
+
+	/**
+	 * @return The number of matching entities.
+	 */
+	std::size_t size() const noexcept override
+	{
+		return entities.size();
+	}
+
+	/**
+	 * @return The name of the query type.
+	 */
+	std::string_view name() const noexcept override
+	{
+		return type_name<Query>();
+	}
+
+private:
+	bool matches(uint64_t key) const
+	{
+		if constexpr (sizeof...(I) == 0) {
+			return false;
+		} else if (masked) {
+			return table->matches(key, include_mask, exclude_mask);
+		} else {
+			return (std::get<EntityStorage<I>*>(includes)->contains(key) && ...)
+				&& !(std::get<EntityStorage<X>*>(excludes)->contains(key) || ...);
+		}
+	}
+
+private:
+	// Are the first two included types tags? Their bitsets are intersected.
+	static constexpr bool tag_pair = [] {
+		if constexpr (sizeof...(I) > 1) {
+			using types = std::tuple<I...>;
+			return std::is_same_v<storage_policy_t<std::tuple_element_t<0, types>>, TagPolicy>
+				&& std::is_same_v<storage_policy_t<std::tuple_element_t<1, types>>, TagPolicy>;
+		}
+		return false;
+	}();
+
+	// The position of keys that are not inside the packed vector.
+	static constexpr uint32_t null_position = ~uint32_t(0);
+
+private:
+	std::tuple<EntityStorage<I>*...> includes;
+	std::tuple<EntityStorage<X>*...> excludes;
+	const SignatureTable* table;
+	Signature include_mask;
+	Signature exclude_mask;
+	// Are all components tracked by the signatures?
+	bool masked;
+	PagedArray<uint32_t> positions = PagedArray<uint32_t>(null_position);
+	std::vector<uint64_t> entities;
+};
+
+template <typename Include, typename Exclude>
+Query<Include, Exclude>& EntityMapping::query()
+{
+	auto type = std::type_index(typeid(Query<Include, Exclude>));
+	auto& query = queries[type];
+	if (!query) {
+		query = std::make_unique<Query<Include, Exclude>>(*this);
+	}
+	return static_cast<Query<Include, Exclude>&>(*query);
+}
+
+}
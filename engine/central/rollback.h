@@ -0,0 +1,184 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+
+namespace kodanuki
+{
+
+/**
+ * The captured state of one entity storage, see World::checkpoint().
+ *
+ * States are immutable once captured, so consecutive checkpoints share
+ * every part of a storage that did not change between them.
+ */
+struct StorageState
+{
+	virtual ~StorageState() = default;
+};
+
+// The number of elements inside each chunk of a captured array.
+inline constexpr uint64_t rollback_chunk_size = 512;
+
+// The immutable chunks of a captured array.
+template <typename T>
+using Chunks = std::vector<std::shared_ptr<const std::vector<T>>>;
+
+/**
+ * Remembers which chunks of the arrays of a storage were written.
+ *
+ * Storages mark every position they write. The marks are relative to the
+ * last capture, so a new capture only copies the marked chunks and shares
+ * the others with the previous one. Storages that were never captured
+ * have no chunks to mark, so marking costs only a comparison.
+ *
+ * Parallel iterations touch values from many threads, so the marks are
+ * atomic. Marking only needs relaxed stores, the captures happen after
+ * the iterations joined. The number of chunks only changes on reset().
+ */
+class DirtyChunks
+{
+public:
+	/**
+	 * Marks the chunk containing the position as written.
+	 *
+	 * @param position The position of the written element.
+	 */
+	void mark(uint64_t position) noexcept
+	{
+		uint64_t chunk = position / rollback_chunk_size;
+		// Reading first keeps the cache line shared while it is marked.
+		if (chunk < count && !dirty[chunk].load(std::memory_order_relaxed)) {
+			dirty[chunk].store(1, std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 * @param chunk The index of the chunk.
+	 * @return Was the chunk written since the last capture?
+	 */
+	bool test(uint64_t chunk) const noexcept
+	{
+		return chunk >= count || dirty[chunk].load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Starts tracking the given number of chunks with no marks.
+	 *
+	 * @param chunks The number of chunks.
+	 */
+	void reset(uint64_t chunks)
+	{
+		if (chunks > capacity) {
+			dirty = std::make_unique<std::atomic<uint8_t>[]>(chunks);
+			capacity = chunks;
+		}
+		for (uint64_t chunk = 0; chunk < chunks; chunk++) {
+			dirty[chunk].store(0, std::memory_order_relaxed);
+		}
+		count = chunks;
+	}
+
+private:
+	std::unique_ptr<std::atomic<uint8_t>[]> dirty;
+	uint64_t count = 0;
+	uint64_t capacity = 0;
+};
+
+/**
+ * Captures the array and shares the unchanged chunks of the previous one.
+ *
+ * @param live The array that is captured.
+ * @param previous The chunks of the last capture of the array.
+ * @param dirty The chunks written since the last capture.
+ * @return The chunks of the array.
+ */
+template <typename T, typename Allocator>
+Chunks<T> capture_chunks(const std::vector<T, Allocator>& live, const Chunks<T>& previous, const DirtyChunks& dirty)
+{
+	uint64_t count = (live.size() + rollback_chunk_size - 1) / rollback_chunk_size;
+	Chunks<T> chunks(count);
+	for (uint64_t chunk = 0; chunk < count; chunk++) {
+		uint64_t begin = chunk * rollback_chunk_size;
+		uint64_t end = std::min<uint64_t>(live.size(), begin + rollback_chunk_size);
+		bool shared = !dirty.test(chunk) && chunk < previous.size()
+			&& previous[chunk]->size() == end - begin;
+		if (shared) {
+			chunks[chunk] = previous[chunk];
+		} else {
+			chunks[chunk] = std::make_shared<const std::vector<T>>(
+				live.begin() + begin, live.begin() + end);
+		}
+	}
+	return chunks;
+}
+
+/**
+ * Restores the array from the captured chunks.
+ *
+ * Only chunks that differ from the last capture or were written since
+ * then are copied back.
+ *
+ * @param live The array that is restored.
+ * @param target The chunks that are restored.
+ * @param previous The chunks of the last capture of the array.
+ * @param dirty The chunks written since the last capture.
+ */
+template <typename T, typename Allocator>
+void restore_chunks(std::vector<T, Allocator>& live, const Chunks<T>& target, const Chunks<T>& previous, const DirtyChunks& dirty)
+{
+	uint64_t size = 0;
+	for (const auto& chunk : target) {
+		size += chunk->size();
+	}
+	if (live.size() > size) {
+		live.erase(live.begin() + size, live.end());
+	}
+	for (uint64_t chunk = 0; chunk < target.size(); chunk++) {
+		uint64_t begin = chunk * rollback_chunk_size;
+		bool unchanged = !dirty.test(chunk) && chunk < previous.size()
+			&& previous[chunk] == target[chunk] && live.size() >= begin + target[chunk]->size();
+		if (unchanged) {
+			continue;
+		}
+		const std::vector<T>& values = *target[chunk];
+		uint64_t overlap = std::min<uint64_t>(values.size(), live.size() - std::min(live.size(), begin));
+		std::copy_n(values.begin(), overlap, live.begin() + begin);
+		live.insert(live.end(), values.begin() + overlap, values.end());
+	}
+}
+
+/**
+ * Calls the function for each key that is only inside one of the vectors.
+ *
+ * Rolling back a storage only changes the membership of these keys, so
+ * only they are reported to the listeners of the storage.
+ *
+ * @param before The keys before the rollback, sorted by this function.
+ * @param after The keys after the rollback, sorted by this function.
+ * @param function The function that is called with each key.
+ */
+template <typename Function>
+void each_difference(std::vector<uint64_t>& before, std::vector<uint64_t>& after, Function function)
+{
+	std::sort(before.begin(), before.end());
+	std::sort(after.begin(), after.end());
+	auto lhs = before.begin();
+	auto rhs = after.begin();
+	while (lhs != before.end() || rhs != after.end()) {
+		if (rhs == after.end() || (lhs != before.end() && *lhs < *rhs)) {
+			function(*lhs++);
+		} else if (lhs == before.end() || *rhs < *lhs) {
+			function(*rhs++);
+		} else {
+			++lhs;
+			++rhs;
+		}
+	}
+}
+
+}
@@ -0,0 +1,98 @@
+#include "engine/central/scheduler.h"
+#include "engine/central/command.h"
+#include "engine/central/thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <utility>
+
+
+namespace kodanuki
+{
+
+void Scheduler::run()
+{
+	for (const std::vector<uint64_t>& stage : stages) {
+		if (stage.size() == 1) {
+			execute(systems[stage.front()]);
+		} else {
+			std::vector<ThreadPool::Task> tasks;
+			for (uint64_t index : stage) {
+				tasks.push_back([this, index] { execute(systems[index]); });
+			}
+			ThreadPool::global().run(std::move(tasks));
+		}
+		world->flush();
+	}
+}
+
+const std::vector<std::vector<uint64_t>>& Scheduler::get_stages() const noexcept
+{
+	return stages;
+}
+
+std::vector<SystemStats> Scheduler::statistics() const
+{
+	std::vector<SystemStats> result;
+	for (const System& system : systems) {
+		result.push_back({system.name, system.runs, system.nanoseconds});
+	}
+	return result;
+}
+
+void Scheduler::reset_statistics() noexcept
+{
+	for (System& system : systems) {
+		system.runs = 0;
+		system.nanoseconds = 0;
+	}
+}
+
+void Scheduler::execute(System& system)
+{
+	auto start = std::chrono::steady_clock::now();
+	// Threads waiting for a stage may run other systems in between.
+	uint64_t previous = std::exchange(running_system, system.id);
+	system.function();
+	running_system = previous;
+	system.nanoseconds += elapsed_nanoseconds(start);
+	system.runs++;
+}
+
+uint64_t Scheduler::next_id() noexcept
+{
+	static std::atomic<uint64_t> counter = 0;
+	return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+bool Scheduler::conflicts(const System& first, const System& second)
+{
+	auto intersects = [](const std::vector<std::size_t>& lhs, const std::vector<std::size_t>& rhs) {
+		return std::ranges::any_of(lhs, [&](std::size_t id) {
+			return std::ranges::find(rhs, id) != rhs.end();
+		});
+	};
+	std::size_t entity = component_id<Entity>();
+	bool exclusive = std::ranges::find(first.writes, entity) != first.writes.end()
+		|| std::ranges::find(second.writes, entity) != second.writes.end();
+	return exclusive
+		|| intersects(first.writes, second.writes)
+		|| intersects(first.writes, second.reads)
+		|| intersects(first.reads, second.writes);
+}
+
+void Scheduler::insert(System system)
+{
+	for (const System& other : systems) {
+		if (conflicts(system, other)) {
+			system.stage = std::max(system.stage, other.stage + 1);
+		}
+	}
+	if (system.stage >= stages.size()) {
+		stages.resize(system.stage + 1);
+	}
+	stages[system.stage].push_back(systems.size());
+	systems.push_back(std::move(system));
+}
+
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include "engine/central/entity.h"
+#include "engine/central/stats.h"
+#include "engine/central/storage.h"
+#include "engine/nekolib/templates/type_name.h"
+#include "engine/nekolib/templates/type_union.h"
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+
+namespace kodanuki
+{
+
+/**
+ * Declares exclusive access to resources outside of the archetypes.
+ *
+ * The types are only used to detect conflicts between systems. Systems
+ * that use the same resource never run concurrently. Declaring the
+ * Entity resource marks a system that creates or removes entities, it
+ * will run without any other system.
+ */
+template <typename ... T>
+struct Resource
+{
+	using read_types = std::tuple<>;
+	using write_types = std::tuple<T...>;
+
+	static void prepare(EntityMapping&, uint64_t) {}
+};
+
+/**
+ * The scheduler runs systems concurrently if their accesses don't conflict.
+ *
+ * Each system is added with the archetypes and resources it uses. The read
+ * and write sets are inferred from them: iterated non-const components,
+ * consumed and produced components are written, all other components are
+ * read. Two systems conflict if one of them writes a component the other
+ * one reads or writes. Systems whose archetypes consume or produce tags
+ * change the membership of storages and run without any other system.
+ *
+ * Systems are ordered as they were added. Each system runs in the stage
+ * after the last earlier system it conflicts with. The systems of one
+ * stage run in parallel on the global thread pool, stages run one after
+ * another. The result is the same as running the systems in order.
+ *
+ * Systems record structural changes into the command buffers, see
+ * World::commands(). The buffers are applied after each stage.
+ *
+ * Each system gets its own id which is set as the running_system while
+ * it runs. Filtered archetypes track their last run per system, so
+ * systems sharing such an archetype don't hide changes from each other.
+ */
+class Scheduler
+{
+public:
+	/**
+	 * Creates the scheduler without any systems.
+	 *
+	 * @param world The world used by the systems.
+	 */
+	explicit Scheduler(World& world = ECS::world()) : world(&world) {}
+
+	/**
+	 * Adds the system that uses the given archetypes and resources.
+	 *
+	 * The archetypes are prepared for the id of the system, so the system
+	 * may run on any thread.
+	 *
+	 * @param Access The archetypes and resources used by the system.
+	 * @param function The system that is called once per run.
+	 */
+	template <typename ... Access>
+	void add(std::function<void()> function)
+	{
+		System system;
+		system.id = next_id();
+		(world->prepare<Access>(system.id), ...);
+		system.function = std::move(function);
+		system.name = type_name<std::tuple<Access...>>();
+		collect(system.reads, std::type_identity<type_union_t<typename Access::read_types...>>());
+		collect(system.writes, std::type_identity<type_union_t<typename Access::write_types...>>());
+		insert(std::move(system));
+	}
+
+	/**
+	 * Runs every system once.
+	 */
+	void run();
+
+	/**
+	 * Returns the systems grouped by their stage.
+	 *
+	 * @return The indices of the systems of each stage.
+	 */
+	const std::vector<std::vector<uint64_t>>& get_stages() const noexcept;
+
+	/**
+	 * Returns the run time of each system in the order they were added.
+	 *
+	 * Systems are named after the archetypes and resources they use.
+	 *
+	 * @return The runs and their time since the last reset.
+	 */
+	std::vector<SystemStats> statistics() const;
+
+	/**
+	 * Sets the runs and the run time of every system to zero.
+	 */
+	void reset_statistics() noexcept;
+
+private:
+	struct System
+	{
+		std::function<void()> function;
+		// Unique among all schedulers, see running_system.
+		uint64_t id = 0;
+		std::vector<std::size_t> reads;
+		std::vector<std::size_t> writes;
+		uint64_t stage = 0;
+		std::string_view name;
+		// Only written by the thread running the system.
+		uint64_t runs = 0;
+		uint64_t nanoseconds = 0;
+	};
+
+	// Runs the system and measures its run time.
+	static void execute(System& system);
+
+	// Returns a new system id, never zero.
+	static uint64_t next_id() noexcept;
+
+	template <typename ... T>
+	static void collect(std::vector<std::size_t>& ids, std::type_identity<std::tuple<T...>>)
+	{
+		(ids.push_back(component_id<T>()), ...);
+	}
+
+	static bool conflicts(const System& first, const System& second);
+
+	void insert(System system);
+
+private:
+	World* world;
+	std::vector<System> systems;
+	std::vector<std::vector<uint64_t>> stages;
+};
+
+}
@@ -0,0 +1,245 @@
+#pragma once
+#include "engine/central/handle.h"
+#include "engine/nekolib/paged_array.h"
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+
+
+namespace kodanuki
+{
+
+// The number of component ids that are tracked by signatures.
+inline constexpr std::size_t signature_width = 256;
+
+/**
+ * The fixed-width bitmask of component ids.
+ *
+ * The signature of an entity has the bit of each component it has set.
+ * Queries compile their included and excluded types into two masks, so
+ * matching an entity is a few word-wise ANDs instead of one lookup per
+ * storage. Only ids below signature_width are tracked.
+ */
+class Signature
+{
+public:
+	Signature() = default;
+
+	/**
+	 * Creates the mask with the given bits set.
+	 *
+	 * @param bits The component ids, each below signature_width.
+	 */
+	Signature(std::initializer_list<std::size_t> bits) noexcept
+	{
+		for (std::size_t bit : bits) {
+			set(bit, true);
+		}
+	}
+
+	/**
+	 * @param bit The component id.
+	 * @param value Is the bit set or cleared?
+	 */
+	void set(std::size_t bit, bool value) noexcept
+	{
+		assert(bit < signature_width);
+		uint64_t flag = uint64_t(1) << (bit % 64);
+		words[bit / 64] = value ? words[bit / 64] | flag : words[bit / 64] & ~flag;
+	}
+
+	/**
+	 * @param bit The component id.
+	 * @return Is the bit set?
+	 */
+	bool test(std::size_t bit) const noexcept
+	{
+		assert(bit < signature_width);
+		return words[bit / 64] >> (bit % 64) & 1;
+	}
+
+	/**
+	 * @param mask The bits that are checked.
+	 * @return Are all bits of the mask set?
+	 */
+	bool contains(const Signature& mask) const noexcept
+	{
+		uint64_t missing = 0;
+		for (std::size_t i = 0; i < word_count; i++) {
+			missing |= mask.words[i] & ~words[i];
+		}
+		return missing == 0;
+	}
+
+	/**
+	 * @param mask The bits that are checked.
+	 * @return Is any bit of the mask set?
+	 */
+	bool intersects(const Signature& mask) const noexcept
+	{
+		uint64_t common = 0;
+		for (std::size_t i = 0; i < word_count; i++) {
+			common |= mask.words[i] & words[i];
+		}
+		return common != 0;
+	}
+
+	/**
+	 * Sets the bits of the other signature as well.
+	 *
+	 * @param other The signature whose bits are added.
+	 * @return This signature.
+	 */
+	Signature& operator|=(const Signature& other) noexcept
+	{
+		for (std::size_t i = 0; i < word_count; i++) {
+			words[i] |= other.words[i];
+		}
+		return *this;
+	}
+
+	/**
+	 * Calls the function for each set bit in ascending order.
+	 *
+	 * @param function The function that is called with each component id.
+	 */
+	template <typename Function>
+	void each(Function function) const
+	{
+		for (std::size_t i = 0; i < word_count; i++) {
+			for (uint64_t word = words[i]; word != 0; word &= word - 1) {
+				function(i * 64 + std::countr_zero(word));
+			}
+		}
+	}
+
+	bool operator==(const Signature& other) const = default;
+
+private:
+	static constexpr std::size_t word_count = (signature_width + 63) / 64;
+
+private:
+	std::array<uint64_t, word_count> words{};
+};
+
+/**
+ * Stores the signature of every entity by its slot index.
+ *
+ * Each storage of the mapping updates its bit whenever it inserts or
+ * removes a key, so the signatures always mirror the storages. Slots
+ * are shared by all generations of a handle, which is why components
+ * must not outlive the entity that was removed from the world.
+ *
+ * The table is shared by the storages of all component types, so
+ * structural changes must never run concurrently, not even for
+ * disjoint components. The scheduler runs structural systems alone,
+ * parallel iterations reject them and command buffers are applied by a
+ * single thread. Debug builds assert that no two writes overlap.
+ */
+class SignatureTable
+{
+public:
+	/**
+	 * @param key The key of the entity.
+	 * @param bit The component id.
+	 * @param value Does the entity have the component?
+	 */
+	void assign(uint64_t key, std::size_t bit, bool value)
+	{
+		[[maybe_unused]] WriteGuard guard(writing);
+		uint32_t index = handle_index(key);
+		if (value || signatures.find(index)) {
+			signatures[index].set(bit, value);
+		}
+	}
+
+	/**
+	 * Sets the bit of every key, e.g. after they were inserted in bulk.
+	 *
+	 * @param keys The keys of the entities.
+	 * @param bit The component id.
+	 */
+	void set(std::span<const uint64_t> keys, std::size_t bit)
+	{
+		[[maybe_unused]] WriteGuard guard(writing);
+		for (uint64_t key : keys) {
+			signatures[handle_index(key)].set(bit, true);
+		}
+	}
+
+	/**
+	 * Clears the bit of every key, e.g. after they were removed in bulk.
+	 *
+	 * @param keys The keys of the entities.
+	 * @param bit The component id.
+	 */
+	void clear(std::span<const uint64_t> keys, std::size_t bit)
+	{
+		[[maybe_unused]] WriteGuard guard(writing);
+		for (uint64_t key : keys) {
+			if (Signature* signature = signatures.find(handle_index(key))) {
+				signature->set(bit, false);
+			}
+		}
+	}
+
+	/**
+	 * @param key The key of the entity.
+	 * @return The signature of the entity, empty if it has no components.
+	 */
+	Signature get(uint64_t key) const noexcept
+	{
+		return signatures.get(handle_index(key));
+	}
+
+	/**
+	 * Only the slot index of the key is used, so callers must reject
+	 * stale keys themselves, see EntityMapping::contains().
+	 *
+	 * @param key The key of the entity.
+	 * @param include The mask of components the entity must have.
+	 * @param exclude The mask of components the entity must not have.
+	 * @return Does the signature of the entity match both masks?
+	 */
+	bool matches(uint64_t key, const Signature& include, const Signature& exclude) const noexcept
+	{
+		const Signature* signature = signatures.find(handle_index(key));
+		if (!signature) {
+			return include == Signature();
+		}
+		return signature->contains(include) && !signature->intersects(exclude);
+	}
+
+private:
+	// Detects concurrent writes in debug builds, see the class comment.
+	struct WriteGuard
+	{
+#ifdef NDEBUG
+		explicit WriteGuard(std::atomic<bool>&) noexcept {}
+#else
+		explicit WriteGuard(std::atomic<bool>& flag) noexcept : flag(flag)
+		{
+			[[maybe_unused]] bool overlapping = flag.exchange(true, std::memory_order_acquire);
+			assert(!overlapping && "Structural changes must not run concurrently");
+		}
+
+		~WriteGuard()
+		{
+			flag.store(false, std::memory_order_release);
+		}
+
+		std::atomic<bool>& flag;
+#endif
+	};
+
+private:
+	PagedArray<Signature, 1024> signatures;
+	std::atomic<bool> writing = false;
+};
+
+}
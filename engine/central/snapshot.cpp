@@ -0,0 +1,54 @@
+#include "engine/central/snapshot.h"
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace kodanuki
+{
+
+void SnapshotWriter::save(const std::filesystem::path& path) const
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		throw std::runtime_error(path.string() + " could not be opened!");
+	}
+	file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+	if (!file) {
+		throw std::runtime_error(path.string() + " could not be written!");
+	}
+}
+
+SnapshotFile::SnapshotFile(const std::filesystem::path& path)
+{
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		throw std::runtime_error(path.string() + " was not found!");
+	}
+	struct stat status;
+	if (fstat(file, &status) != 0) {
+		close(file);
+		throw std::runtime_error(path.string() + " could not be read!");
+	}
+	size = static_cast<uint64_t>(status.st_size);
+	if (size > 0) {
+		memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+	}
+	close(file);
+	if (memory == MAP_FAILED) {
+		memory = nullptr;
+		size = 0;
+		throw std::runtime_error(path.string() + " could not be mapped!");
+	}
+}
+
+SnapshotFile::~SnapshotFile()
+{
+	if (memory) {
+		munmap(memory, size);
+	}
+}
+
+}
@@ -0,0 +1,337 @@
+#pragma once
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+
+namespace kodanuki
+{
+
+/**
+ * The snapshot writer appends raw bytes to an in-memory buffer.
+ *
+ * Values are written in the native byte order without any padding.
+ * Arrays are prefixed with their number of elements and written as one
+ * contiguous block, so reading them back is a single copy.
+ */
+class SnapshotWriter
+{
+public:
+	/**
+	 * Appends the bytes to the buffer.
+	 *
+	 * @param data The pointer to the first byte.
+	 * @param size The number of bytes.
+	 */
+	void write(const void* data, uint64_t size)
+	{
+		const std::byte* bytes = static_cast<const std::byte*>(data);
+		buffer.insert(buffer.end(), bytes, bytes + size);
+	}
+
+	/**
+	 * Appends the bytes of the value to the buffer.
+	 *
+	 * @param value The value that is written.
+	 */
+	template <typename T>
+		requires std::is_trivially_copyable_v<T>
+	void write(const T& value)
+	{
+		write(&value, sizeof(T));
+	}
+
+	/**
+	 * Appends the number of values and their bytes to the buffer.
+	 *
+	 * @param values The values that are written.
+	 */
+	template <typename T>
+		requires std::is_trivially_copyable_v<T>
+	void write_array(std::span<const T> values)
+	{
+		write<uint64_t>(values.size());
+		write(values.data(), values.size_bytes());
+	}
+
+	/**
+	 * Overwrites a value that was written before.
+	 *
+	 * @param position The position of the value inside the buffer.
+	 * @param value The new value.
+	 */
+	template <typename T>
+		requires std::is_trivially_copyable_v<T>
+	void patch(uint64_t position, const T& value)
+	{
+		std::memcpy(buffer.data() + position, &value, sizeof(T));
+	}
+
+	/**
+	 * @return The number of bytes written so far.
+	 */
+	uint64_t position() const noexcept
+	{
+		return buffer.size();
+	}
+
+	/**
+	 * @return The bytes written so far.
+	 */
+	std::span<const std::byte> data() const noexcept
+	{
+		return buffer;
+	}
+
+	/**
+	 * Writes the buffer into the file, replacing its content.
+	 *
+	 * @param path The path of the file.
+	 * @throws std::runtime_error if the file could not be written.
+	 */
+	void save(const std::filesystem::path& path) const;
+
+private:
+	std::vector<std::byte> buffer;
+};
+
+/**
+ * The snapshot reader consumes bytes in the order they were written.
+ *
+ * The reader only views the bytes, see SnapshotFile for reading files.
+ * Reading past the end throws std::runtime_error.
+ */
+class SnapshotReader
+{
+public:
+	/**
+	 * Creates the reader for the given bytes.
+	 *
+	 * @param data The bytes that are read.
+	 */
+	explicit SnapshotReader(std::span<const std::byte> data) : bytes(data) {}
+
+	/**
+	 * Copies the next bytes into the given memory.
+	 *
+	 * @param data The pointer to the first byte of the memory.
+	 * @param size The number of bytes.
+	 */
+	void read(void* data, uint64_t size)
+	{
+		std::span<const std::byte> source = take(size);
+		if (size > 0) {
+			std::memcpy(data, source.data(), size);
+		}
+	}
+
+	/**
+	 * Reads the next value.
+	 *
+	 * @return The value.
+	 */
+	template <typename T>
+		requires std::is_trivially_copyable_v<T> && std::is_default_constructible_v<T>
+	T read()
+	{
+		T value;
+		read(&value, sizeof(T));
+		return value;
+	}
+
+	/**
+	 * Reads the next array into the vector, replacing its content.
+	 *
+	 * @param values The vector that receives the values.
+	 */
+	template <typename T, typename Allocator>
+		requires std::is_trivially_copyable_v<T> && std::is_default_constructible_v<T>
+	void read_array(std::vector<T, Allocator>& values)
+	{
+		uint64_t count = read<uint64_t>();
+		if (count > remaining() / std::max<uint64_t>(sizeof(T), 1)) {
+			throw std::runtime_error("The snapshot is truncated!");
+		}
+		values.resize(count);
+		read(values.data(), count * sizeof(T));
+	}
+
+	/**
+	 * Skips the next bytes and returns them.
+	 *
+	 * @param size The number of bytes.
+	 * @return The skipped bytes.
+	 */
+	std::span<const std::byte> take(uint64_t size)
+	{
+		if (size > remaining()) {
+			throw std::runtime_error("The snapshot is truncated!");
+		}
+		std::span<const std::byte> result = bytes.subspan(offset, size);
+		offset += size;
+		return result;
+	}
+
+	/**
+	 * @return The number of bytes that were not read yet.
+	 */
+	uint64_t remaining() const noexcept
+	{
+		return bytes.size() - offset;
+	}
+
+private:
+	std::span<const std::byte> bytes;
+	uint64_t offset = 0;
+};
+
+/**
+ * Read-only memory mapping of a snapshot file.
+ *
+ * The pages of the file are loaded by the operating system on demand,
+ * so restoring a snapshot copies the blocks straight out of the page
+ * cache without reading the file into a buffer first.
+ */
+class SnapshotFile
+{
+public:
+	/**
+	 * Maps the file into memory.
+	 *
+	 * @param path The path of the file.
+	 * @throws std::runtime_error if the file could not be mapped.
+	 */
+	explicit SnapshotFile(const std::filesystem::path& path);
+	~SnapshotFile();
+
+	SnapshotFile(const SnapshotFile&) = delete;
+	SnapshotFile& operator=(const SnapshotFile&) = delete;
+
+	/**
+	 * @return The bytes of the file.
+	 */
+	std::span<const std::byte> data() const noexcept
+	{
+		return {static_cast<const std::byte*>(memory), size};
+	}
+
+private:
+	void* memory = nullptr;
+	uint64_t size = 0;
+};
+
+/**
+ * Defines how the components of one type are written into snapshots.
+ *
+ * Trivially copyable components are copied as raw bytes. Specialize this
+ * trait for other components with the following members:
+ *
+ *     static constexpr bool enabled = true;
+ *     static void save(SnapshotWriter& writer, const T& value);
+ *     static T load(SnapshotReader& reader);
+ *
+ * Components that are not enabled are not written into snapshots. This
+ * also applies to trivially copyable components that contain pointers,
+ * their specialization should only set enabled to false.
+ *
+ * @param T The type of the component.
+ */
+template <typename T>
+struct Serializer
+{
+	static constexpr bool enabled = std::is_trivially_copyable_v<T>
+		&& std::is_default_constructible_v<T>;
+};
+
+/**
+ * Does the serializer of the type provide custom save and load functions?
+ */
+template <typename T>
+concept custom_serializer = requires(SnapshotWriter& writer, SnapshotReader& reader, const T& value)
+{
+	Serializer<T>::save(writer, value);
+	{ Serializer<T>::load(reader) } -> std::same_as<T>;
+};
+
+/**
+ * Writes the value with the serializer of its type.
+ *
+ * @param writer The writer of the snapshot.
+ * @param value The value that is written.
+ */
+template <typename T>
+void save_value(SnapshotWriter& writer, const T& value)
+{
+	if constexpr (custom_serializer<T>) {
+		Serializer<T>::save(writer, value);
+	} else {
+		writer.write(value);
+	}
+}
+
+/**
+ * Reads the value with the serializer of its type.
+ *
+ * @param reader The reader of the snapshot.
+ * @return The value.
+ */
+template <typename T>
+T load_value(SnapshotReader& reader)
+{
+	if constexpr (custom_serializer<T>) {
+		return Serializer<T>::load(reader);
+	} else {
+		return reader.read<T>();
+	}
+}
+
+/**
+ * Writes the values with the serializer of their type.
+ *
+ * Values without a custom serializer are written as one block.
+ *
+ * @param writer The writer of the snapshot.
+ * @param values The values that are written.
+ */
+template <typename T>
+void save_values(SnapshotWriter& writer, std::span<const T> values)
+{
+	if constexpr (custom_serializer<T>) {
+		writer.write<uint64_t>(values.size());
+		for (const T& value : values) {
+			Serializer<T>::save(writer, value);
+		}
+	} else {
+		writer.write_array(values);
+	}
+}
+
+/**
+ * Reads the values with the serializer of their type.
+ *
+ * @param reader The reader of the snapshot.
+ * @param values The vector that receives the values.
+ */
+template <typename T, typename Allocator>
+void load_values(SnapshotReader& reader, std::vector<T, Allocator>& values)
+{
+	if constexpr (custom_serializer<T>) {
+		uint64_t count = reader.read<uint64_t>();
+		values.clear();
+		values.reserve(std::min(count, reader.remaining()));
+		for (uint64_t i = 0; i < count; i++) {
+			values.push_back(Serializer<T>::load(reader));
+		}
+	} else {
+		reader.read_array(values);
+	}
+}
+
+}
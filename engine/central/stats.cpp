@@ -0,0 +1,71 @@
+#include "engine/central/stats.h"
+#include <cstdio>
+
+
+namespace kodanuki
+{
+
+static void write_string(std::ostream& stream, std::string_view text)
+{
+	stream << '"';
+	for (char letter : text) {
+		if (letter == '"' || letter == '\\') {
+			stream << '\\' << letter;
+		} else if (static_cast<unsigned char>(letter) < 0x20) {
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", letter);
+			stream << escaped;
+		} else {
+			stream << letter;
+		}
+	}
+	stream << '"';
+}
+
+// Writes the elements separated by commas, each by the given function.
+template <typename T, typename Function>
+static void write_array(std::ostream& stream, std::string_view name, const std::vector<T>& elements, Function function)
+{
+	write_string(stream, name);
+	stream << ":[";
+	for (std::size_t i = 0; i < elements.size(); i++) {
+		stream << (i == 0 ? "{" : ",{");
+		function(elements[i]);
+		stream << '}';
+	}
+	stream << ']';
+}
+
+void write_json(std::ostream& stream, const Statistics& statistics)
+{
+	stream << '{';
+	write_array(stream, "storages", statistics.storages, [&](const StorageStats& storage) {
+		stream << "\"name\":";
+		write_string(stream, storage.name);
+		stream << ",\"keys\":" << storage.keys
+			<< ",\"values\":" << storage.values
+			<< ",\"capacity\":" << storage.capacity
+			<< ",\"bytes\":" << storage.bytes
+			<< ",\"load_factor\":" << storage.load_factor;
+	});
+	stream << ',';
+	write_array(stream, "queries", statistics.queries, [&](const QueryStats& query) {
+		stream << "\"name\":";
+		write_string(stream, query.name);
+		stream << ",\"matches\":" << query.matches
+			<< ",\"searches\":" << query.searches
+			<< ",\"search_nanoseconds\":" << query.search_nanoseconds
+			<< ",\"inserted\":" << query.inserted
+			<< ",\"removed\":" << query.removed;
+	});
+	stream << ',';
+	write_array(stream, "systems", statistics.systems, [&](const SystemStats& system) {
+		stream << "\"name\":";
+		write_string(stream, system.name);
+		stream << ",\"runs\":" << system.runs
+			<< ",\"nanoseconds\":" << system.nanoseconds;
+	});
+	stream << '}';
+}
+
+}
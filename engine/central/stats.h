@@ -0,0 +1,100 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+
+namespace kodanuki
+{
+
+/**
+ * The memory layout of one entity storage, see BaseStorage::stats().
+ */
+struct StorageStats
+{
+	// The name of the component type.
+	std::string_view name;
+	// The number of keys, bound and shared keys included.
+	uint64_t keys;
+	// The number of distinct values.
+	uint64_t values;
+	// The number of values that fit without reallocating.
+	uint64_t capacity;
+	// The bytes held by the values, ticks and the sparse index.
+	uint64_t bytes;
+	// The keys per slot of the sparse index or the load of the hash map.
+	double load_factor;
+};
+
+/**
+ * The activity of one cached query or group.
+ *
+ * The counters cover the time since the statistics were last reset,
+ * usually a single frame, see World::reset_statistics().
+ */
+struct QueryStats
+{
+	// The type of the query or group.
+	std::string_view name;
+	// The number of matching entities right now.
+	uint64_t matches;
+	// The number of iterations started over the matches.
+	uint64_t searches;
+	// The time spent collecting and filtering the matches.
+	uint64_t search_nanoseconds;
+	// The number of entities that started matching.
+	uint64_t inserted;
+	// The number of entities that stopped matching.
+	uint64_t removed;
+};
+
+/**
+ * The run time of one system of a scheduler, see Scheduler::statistics().
+ *
+ * The time spent iterating is the run time minus the search time of
+ * the queries used by the system.
+ */
+struct SystemStats
+{
+	// The archetypes and resources used by the system.
+	std::string_view name;
+	// The number of runs since the last reset.
+	uint64_t runs;
+	// The total time of these runs.
+	uint64_t nanoseconds;
+};
+
+/**
+ * The statistics of a world and optionally of its scheduler.
+ */
+struct Statistics
+{
+	std::vector<StorageStats> storages;
+	std::vector<QueryStats> queries;
+	std::vector<SystemStats> systems;
+};
+
+/**
+ * @param start The time point at which the measurement started.
+ * @return The nanoseconds passed since then.
+ */
+inline uint64_t elapsed_nanoseconds(std::chrono::steady_clock::time_point start) noexcept
+{
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+/**
+ * Writes the statistics as a single JSON object.
+ *
+ * The object has the arrays "storages", "queries" and "systems" whose
+ * elements have the members of the corresponding structs.
+ *
+ * @param stream The stream that receives the JSON text.
+ * @param statistics The statistics that are written.
+ */
+void write_json(std::ostream& stream, const Statistics& statistics);
+
+}
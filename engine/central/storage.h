@@ -1,13 +1,30 @@
 #pragma once
-#include "engine/nekolib/dense_map.h"
+#include "engine/central/fields.h"
+#include "engine/central/handle.h"
+#include "engine/central/memory.h"
+#include "engine/central/rollback.h"
+#include "engine/central/signature.h"
+#include "engine/central/snapshot.h"
+#include "engine/central/stats.h"
+#include "engine/nekolib/hierarchical_bitset.h"
+#include "engine/nekolib/paged_array.h"
+#include "engine/nekolib/templates/type_name.h"
 #include <algorithm>
-#include <any>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
-#include <functional>
+#include <map>
+#include <memory>
+#include <memory_resource>
 #include <set>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
 #include <typeindex>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 
@@ -15,182 +32,3248 @@ namespace kodanuki
 {
 
 /**
- * The entity storage is a unordered sparse-dense map.
+ * Interface for objects that observe the keys of entity storages.
+ */
+class StorageListener
+{
+public:
+	virtual ~StorageListener() = default;
+
+	/**
+	 * Called after the key was inserted into or removed from a storage.
+	 *
+	 * @param key The key whose membership changed.
+	 */
+	virtual void refresh(uint64_t key) = 0;
+
+	/**
+	 * Called once after the keys were inserted into a storage in bulk.
+	 *
+	 * @param keys The keys that were inserted, each of them only once.
+	 */
+	virtual void refresh_inserted(std::span<const uint64_t> keys)
+	{
+		for (uint64_t key : keys) {
+			refresh(key);
+		}
+	}
+
+	/**
+	 * Called once after the keys were removed from a storage in bulk.
+	 *
+	 * @param keys The keys that were removed, each of them only once.
+	 */
+	virtual void refresh_removed(std::span<const uint64_t> keys)
+	{
+		for (uint64_t key : keys) {
+			refresh(key);
+		}
+	}
+
+	/**
+	 * Called after the storage was restored from a snapshot or checkpoint.
+	 *
+	 * The values may be at different positions afterward. Keys whose
+	 * membership changed are still reported through refresh().
+	 */
+	virtual void invalidate() {}
+};
+
+/**
+ * Interface of the queries and groups cached by the entity mapping.
+ *
+ * Each cached query counts its searches and the keys that entered or
+ * left its matches, see QueryStats. The counters are atomic, since the
+ * systems of one stage may search the same query concurrently.
+ */
+class CachedQuery : public StorageListener
+{
+public:
+	/**
+	 * @return The number of matching entities.
+	 */
+	virtual std::size_t size() const noexcept = 0;
+
+	/**
+	 * @return The name of the query type.
+	 */
+	virtual std::string_view name() const noexcept = 0;
+
+	/**
+	 * Rebuilds the matches after the storages were restored.
+	 *
+	 * The mapping calls this at the end of each load and rollback, so
+	 * iterations never rebuild the matches concurrently.
+	 */
+	virtual void regroup() {}
+
+	/**
+	 * Counts one search of the matches.
+	 *
+	 * @param nanoseconds The time spent collecting and filtering them.
+	 */
+	void record_search(uint64_t nanoseconds) noexcept
+	{
+		searches.fetch_add(1, std::memory_order_relaxed);
+		search_time.fetch_add(nanoseconds, std::memory_order_relaxed);
+	}
+
+	/**
+	 * @return The counters since the last reset and the current matches.
+	 */
+	QueryStats stats() const noexcept
+	{
+		return {name(), size(), searches.load(std::memory_order_relaxed),
+			search_time.load(std::memory_order_relaxed),
+			inserted.load(std::memory_order_relaxed), removed.load(std::memory_order_relaxed)};
+	}
+
+	/**
+	 * Sets all counters to zero.
+	 */
+	void reset_stats() noexcept
+	{
+		searches = 0;
+		search_time = 0;
+		inserted = 0;
+		removed = 0;
+	}
+
+protected:
+	// Counts the key that started or stopped matching.
+	void record_change(bool matched) noexcept
+	{
+		(matched ? inserted : removed).fetch_add(1, std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<uint64_t> searches = 0;
+	std::atomic<uint64_t> search_time = 0;
+	std::atomic<uint64_t> inserted = 0;
+	std::atomic<uint64_t> removed = 0;
+};
+
+/**
+ * Type-erased interface of the entity storages.
+ *
+ * Each storage owns a pool resource on top of the resource of its
+ * mapping, see PoolResource.
+ */
+class BaseStorage
+{
+public:
+	/**
+	 * Creates the storage and its pool.
+	 *
+	 * @param upstream The resource from which the pool allocates.
+	 */
+	explicit BaseStorage(std::pmr::memory_resource* upstream) : pool(upstream) {}
+	virtual ~BaseStorage() = default;
+
+	BaseStorage(const BaseStorage&) = delete;
+	BaseStorage& operator=(const BaseStorage&) = delete;
+
+	/**
+	 * Removes the given element from the storage.
+	 *
+	 * @param key The key of the removed value.
+	 */
+	virtual void remove(uint64_t key) = 0;
+
+	/**
+	 * Removes the given elements from the storage.
+	 *
+	 * Keys that are not inside the storage are skipped.
+	 *
+	 * @param keys The keys of the removed values.
+	 */
+	virtual void remove_many(std::span<const uint64_t> keys) = 0;
+
+	/**
+	 * @param key The key that points to the value.
+	 * @return Is the value inside this storage?
+	 */
+	virtual bool contains(uint64_t key) const = 0;
+
+	/**
+	 * @return The number of keys inside the storage.
+	 */
+	virtual uint64_t size() const = 0;
+
+	/**
+	 * Registers the listener for key insertions and removals.
+	 *
+	 * @param listener The listener that should be notified.
+	 */
+	virtual void subscribe(StorageListener* listener) = 0;
+
+	/**
+	 * @return The name of the component type, see storage_factories().
+	 */
+	virtual std::string_view name() const = 0;
+
+	/**
+	 * @return The number of keys and values and the memory they use.
+	 */
+	virtual StorageStats stats() const = 0;
+
+	/**
+	 * @return Can the storage be written into snapshots, see Serializer?
+	 */
+	virtual bool serializable() const = 0;
+
+	/**
+	 * Writes the keys, values and ticks into the snapshot.
+	 *
+	 * @param writer The writer of the snapshot.
+	 */
+	virtual void save(SnapshotWriter& writer) const = 0;
+
+	/**
+	 * Reads the keys, values and ticks written by save().
+	 *
+	 * The storage must be empty beforehand.
+	 *
+	 * @param reader The reader of the snapshot.
+	 */
+	virtual void load(SnapshotReader& reader) = 0;
+
+	/**
+	 * Captures the keys, values and ticks for a later rollback.
+	 *
+	 * @return The state, sharing unchanged parts with the previous one.
+	 * @throws std::logic_error if the components can't be copied.
+	 */
+	virtual std::shared_ptr<const StorageState> capture() = 0;
+
+	/**
+	 * Restores the keys, values and ticks of a captured state.
+	 *
+	 * Listeners are notified about the keys that were inserted or
+	 * removed by the rollback.
+	 *
+	 * @param state The captured state, nullptr for an empty storage.
+	 */
+	virtual void rollback(const std::shared_ptr<const StorageState>& state) = 0;
+
+	/**
+	 * Sets the clock whose value stamps inserted and changed values.
+	 *
+	 * Storages without a clock stamp every value with zero.
+	 *
+	 * @param clock The clock of the entity mapping.
+	 */
+	void set_clock(const std::atomic<uint64_t>* clock) noexcept
+	{
+		this->clock = clock;
+	}
+
+	/**
+	 * Returns the pool of this storage.
+	 *
+	 * Components with heap buffers can allocate them from the pool, so
+	 * that replacing the buffers recycles the memory of the old ones.
+	 *
+	 * @return The pool resource.
+	 */
+	std::pmr::memory_resource* resource() noexcept
+	{
+		return &pool;
+	}
+
+protected:
+	// Returns the current value of the clock.
+	uint64_t now() const noexcept
+	{
+		return clock ? clock->load(std::memory_order_relaxed) : 0;
+	}
+
+private:
+	const std::atomic<uint64_t>* clock = nullptr;
+	PoolResource pool;
+};
+
+template <typename Include, typename Exclude>
+class Query;
+
+template <typename Owned, typename Include, typename Exclude>
+class Group;
+
+class EntityMapping;
+
+// Creates the storage of one component type inside the mapping.
+using StorageFactory = BaseStorage& (*)(EntityMapping& mapping);
+
+/**
+ * Returns the storage factory of each component type by its name.
+ *
+ * Every storage type registers itself before main() is entered, so
+ * snapshots can restore components whose storage does not exist yet.
+ *
+ * @return The factories by the name of the component type.
+ */
+inline std::unordered_map<std::string_view, StorageFactory>& storage_factories()
+{
+	static std::unordered_map<std::string_view, StorageFactory> factories;
+	return factories;
+}
+
+template <typename T>
+BaseStorage& create_storage(EntityMapping& mapping);
+
+// Registers the storage factory of the type under its name.
+template <typename T>
+struct StorageRegistration
+{
+	static inline const std::string_view name = [] {
+		storage_factories().try_emplace(type_name<T>(), &create_storage<T>);
+		return type_name<T>();
+	}();
+};
+
+// Stores the values inside a contiguous vector, see EntityStorage.
+struct DensePolicy {};
+// Stores the values inside a hash map, for rare and large components.
+struct HashedPolicy {};
+// Stores only the keys inside a bitset, for empty components.
+struct TagPolicy {};
+// Stores each member inside its own vector, see component_fields.
+struct SplitPolicy {};
+
+/**
+ * Selects how the components of the given type are stored.
+ *
+ * Empty types are stored as tags, types that list their fields with
+ * component_fields are split into columns, all other types are stored
+ * densely. Specialize this trait to choose a different policy for a type.
+ *
+ * @param T The type of the component.
+ */
+template <typename T>
+struct storage_policy
+{
+	using type = std::conditional_t<std::is_empty_v<T>, TagPolicy,
+		std::conditional_t<split_component<T>, SplitPolicy, DensePolicy>>;
+};
+
+template <typename T>
+using storage_policy_t = typename storage_policy<T>::type;
+
+// The reference to a stored component, a proxy for split components.
+template <typename T>
+using component_reference_t = std::conditional_t<
+	std::is_same_v<storage_policy_t<std::remove_const_t<T>>, SplitPolicy>, SplitReference<T>, T&>;
+
+/**
+ * The storage for the components of one type.
+ *
+ * Each policy provides the same interface, so the rest of the ECS never
+ * depends on the chosen policy.
+ *
+ * @param T The type of the component.
+ * @param Policy The policy that defines the memory layout.
+ */
+template <typename T, typename Policy = storage_policy_t<T>>
+class EntityStorage;
+
+/**
+ * Assigns the value constructed from the arguments to the target.
+ *
+ * @param target The value that is overwritten.
+ * @param args The arguments for the constructor of the value.
+ */
+template <typename T, typename ... Args>
+void assign(T& target, Args&& ... args)
+{
+	target = T(std::forward<Args>(args)...);
+}
+
+/**
+ * Assigns the value to the target without a temporary.
+ *
+ * @param target The value that is overwritten.
+ * @param value The new value.
+ */
+template <typename T, typename U>
+	requires std::is_assignable_v<T&, U&&>
+void assign(T& target, U&& value)
+{
+	target = std::forward<U>(value);
+}
+
+/**
+ * The dense entity storage is a unordered sparse-dense map.
+ *
+ * It holds (key, value) pairs like a unordered map, but stores the
+ * values as a contiguous vector. Multiple keys for the same value are
+ * allowed.
+ *
+ * The keys are entity handles. Their slot index selects the binding
+ * inside a paged sparse array which contains the position inside the
+ * dense vector. The binding also remembers the full handle, so stale
+ * handles of recycled slots are rejected. Each lookup is therefore two
+ * array loads, one for the binding and one for the value.
+ *
+ * The dense vector is accompanied by the packed vector of owners. The
+ * owner is the first key bound to the value. Further keys of the same
+ * value are chained through their bindings, so that swap-back removes
+ * can move all of them at once. The chain links both ways, so removing
+ * one of many keys doesn't search the chain.
+ *
+ * Using different keys for the same value works with the bind()
+ * method. The value is removed once every key for that value is
+ * removed. Updating that values updates it for all keys since it
+ * points to the same memory.
+ *
+ * The share() method also lets keys use the same value, but the value
+ * is copied on write. Writing through any key of a shared value moves
+ * that key to its own copy, the other keys keep the old value. The
+ * number of keys of each value is stored inside a vector parallel to
+ * the dense one, the sharing mode inside the bindings of its keys.
+ *
+ * Each key should be unique, updating with the same key removes the
+ * old value and inserts the new one.
+ *
+ * Listeners are notified whenever a key is inserted or removed, but
+ * not when the value of an existing key is updated.
+ *
+ * Each value is stamped with the clock when it is added and whenever it
+ * is changed. The ticks are kept in vectors parallel to the dense one,
+ * they belong to the value and are therefore shared by bound keys.
+ *
+ * Captures for rollbacks split the dense vectors into chunks. Writes mark
+ * their chunk, so the next capture only copies the marked chunks and
+ * shares the others. Writing through operator[] is neither stamped nor
+ * marked and doesn't copy shared values, use touch() for that.
+ *
+ * The dense vector allocates from the pool of the storage. Values that
+ * use polymorphic allocators are constructed with the pool as well.
+ */
+template <typename T>
+class EntityStorage<T, DensePolicy> final : public BaseStorage
+{
+public:
+	/**
+	 * Creates the empty storage.
+	 *
+	 * @param upstream The resource from which the pool allocates.
+	 */
+	explicit EntityStorage(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+		: BaseStorage(upstream), dense(resource()) {}
+
+	/**
+	 * Updates the given element or inserts it.
+	 *
+	 * @param key The key of the updated value.
+	 * @param value The new value for the key.
+	 */
+	void update(uint64_t key, const T& value)
+	{
+		emplace(key, value);
+	}
+
+	/**
+	 * Updates the given element or inserts it by moving the value.
+	 *
+	 * @param key The key of the updated value.
+	 * @param value The new value for the key.
+	 */
+	void update(uint64_t key, T&& value)
+	{
+		emplace(key, std::move(value));
+	}
+
+	/**
+	 * Constructs the value in place or assigns it to the existing one.
+	 *
+	 * New values are constructed at the end of the dense vector, so the
+	 * arguments are forwarded without any intermediate copy.
+	 *
+	 * @param key The key of the updated value.
+	 * @param args The arguments for the constructor of the value.
+	 * @return The reference to the value.
+	 */
+	template <typename ... Args>
+	T& emplace(uint64_t key, Args&& ... args)
+	{
+		if (contains(key)) {
+			const Binding& binding = *bindings.find(handle_index(key));
+			uint32_t pos = binding.pos;
+			if (binding.copy_on_write) {
+				// The shared value is replaced anyway, so it is not copied.
+				separate(key, pos);
+				return append(key, added_ticks[pos], now(), std::forward<Args>(args)...);
+			}
+			assign(dense[pos], std::forward<Args>(args)...);
+			changed_ticks[pos] = now();
+			dirty.mark(pos);
+			return dense[pos];
+		}
+		keys_count++;
+		append(key, now(), now(), std::forward<Args>(args)...);
+		notify(key);
+		// Listeners may have moved the value, see Group.
+		return (*this)[key];
+	}
+
+	/**
+	 * Reserves the memory for the given number of values.
+	 *
+	 * @param count The number of values the storage should hold.
+	 */
+	void reserve(uint64_t count)
+	{
+		owners.reserve(count);
+		counts.reserve(count);
+		dense.reserve(count);
+		added_ticks.reserve(count);
+		changed_ticks.reserve(count);
+	}
+
+	/**
+	 * Updates or inserts the values of multiple keys at once.
+	 *
+	 * The storage grows once and the new values are appended in a single
+	 * pass, then listeners are notified once for all new keys. Owned
+	 * storages insert one key after another, since the group moves each
+	 * new value into place.
+	 *
+	 * @param keys The keys of the updated values.
+	 * @param value_of Returns the value of the key at the given index.
+	 */
+	template <typename Function>
+	void update_many(std::span<const uint64_t> keys, Function value_of)
+	{
+		if (group) {
+			for (uint64_t i = 0; i < keys.size(); i++) {
+				emplace(keys[i], value_of(i));
+			}
+			return;
+		}
+		// Existing values are updated first, since shared ones may move.
+		for (uint64_t i = 0; i < keys.size() && keys_count != 0; i++) {
+			if (contains(keys[i])) {
+				emplace(keys[i], value_of(i));
+			}
+		}
+		// The values of the new keys form the tail behind the first one.
+		uint32_t first = static_cast<uint32_t>(dense.size());
+		reserve(dense.size() + keys.size());
+		try {
+			for (uint64_t i = 0; i < keys.size(); i++) {
+				uint64_t key = keys[i];
+				Binding& binding = bindings[handle_index(key)];
+				if (binding.key != key) {
+					dense.emplace_back(value_of(i));
+					binding = {key, static_cast<uint32_t>(dense.size() - 1)};
+					owners.push_back(key);
+				} else if (binding.pos >= first) {
+					assign(dense[binding.pos], value_of(i));
+				}
+			}
+		} catch (...) {
+			append_tail(first);
+			throw;
+		}
+		append_tail(first);
+	}
+
+	/**
+	 * Removes the given element from the storage.
+	 *
+	 * @param key The key of the removed value.
+	 */
+	void remove(uint64_t key) override
+	{
+		if (!contains(key)) {
+			return;
+		}
+		uint32_t pos = bindings.find(handle_index(key))->pos;
+		separate(key, pos);
+		bindings[handle_index(key)] = {};
+		keys_count--;
+		if (counts[pos] == 0) {
+			erase(pos);
+		}
+		notify(key);
+	}
+
+	/**
+	 * Removes the given elements from the storage.
+	 *
+	 * The keys are unbound first, then the values without any keys are
+	 * erased from the back, so only kept values are moved. Listeners are
+	 * notified once for the whole batch. Owned storages remove one key
+	 * after another, since the group follows each swap-back.
+	 *
+	 * @param keys The keys of the removed values.
+	 */
+	void remove_many(std::span<const uint64_t> keys) override
+	{
+		if (group) {
+			for (uint64_t key : keys) {
+				if (keys_count == 0) {
+					return;
+				}
+				remove(key);
+			}
+			return;
+		}
+		std::vector<uint64_t> removed;
+		std::vector<uint32_t> erased;
+		for (uint64_t key : keys) {
+			if (keys_count == 0) {
+				break;
+			}
+			if (!contains(key)) {
+				continue;
+			}
+			uint32_t pos = bindings.find(handle_index(key))->pos;
+			separate(key, pos);
+			bindings[handle_index(key)] = {};
+			keys_count--;
+			removed.push_back(key);
+			if (counts[pos] == 0) {
+				erased.push_back(pos);
+			}
+		}
+		// The back value is never erased later, since positions descend.
+		std::sort(erased.begin(), erased.end(), std::greater<>());
+		for (uint32_t pos : erased) {
+			erase(pos);
+		}
+		notify_removed(removed);
+	}
+
+	/**
+	 * Binds the source element to the target element inside the storage.
+	 *
+	 * @param source_key The source key that should be binded.
+	 * @param target_key The target key to which to bind.
+	 * @throws std::logic_error if the storage is owned by a group.
+	 */
+	void bind(uint64_t source_key, uint64_t target_key)
+	{
+		if (!contains(target_key) || source_key == target_key) {
+			return;
+		}
+		if (group) {
+			throw std::logic_error("Components owned by a group can't be bound!");
+		}
+		if (contains(source_key)) {
+			remove(source_key);
+		}
+		if constexpr (std::is_copy_constructible_v<T>) {
+			// The other keys must not see the writes of the bound keys.
+			unshare(target_key);
+		}
+		link(source_key, target_key);
+		notify(source_key);
+	}
+
+	/**
+	 * Shares the value of the target element with the source element.
+	 *
+	 * The value is copied once either key writes to it, see touch() and
+	 * emplace(). Sharing a value that is bound to multiple keys copies it
+	 * right away.
+	 *
+	 * @param source_key The source key that should share the value.
+	 * @param target_key The target key whose value is shared.
+	 * @throws std::logic_error if the storage is owned by a group.
+	 */
+	void share(uint64_t source_key, uint64_t target_key)
+	{
+		if (!contains(target_key) || source_key == target_key) {
+			return;
+		}
+		if (group) {
+			throw std::logic_error("Components owned by a group can't be shared!");
+		}
+		if (contains(source_key)) {
+			remove(source_key);
+		}
+		Binding& target = bindings[handle_index(target_key)];
+		uint32_t pos = target.pos;
+		if (counts[pos] > 1 && !target.copy_on_write) {
+			keys_count++;
+			append(source_key, now(), now(), std::as_const(dense[pos]));
+		} else {
+			if (!target.copy_on_write) {
+				target.copy_on_write = true;
+				shared_count++;
+			}
+			link(source_key, target_key);
+			bindings[handle_index(source_key)].copy_on_write = true;
+		}
+		notify(source_key);
+	}
+
+	/**
+	 * Gives the key its own copy of the value if the value is shared.
+	 *
+	 * @param key The key that points to the value.
+	 */
+	void unshare(uint64_t key)
+	{
+		if constexpr (std::is_copy_constructible_v<T>) {
+			const Binding& binding = *bindings.find(handle_index(key));
+			if (binding.copy_on_write) {
+				detach(key, binding.pos);
+			}
+		}
+	}
+
+	/**
+	 * @return Are any values shared with copy-on-write?
+	 */
+	bool shared() const noexcept
+	{
+		return shared_count != 0;
+	}
+	
+	/**
+	 * Returns the reference to the value.
+	 *
+	 * @param key The key that points to the value.
+	 * @return The reference to the value.
+	 */
+	T& operator[](uint64_t key)
+	{
+		assert(contains(key));
+		return dense[bindings.find(handle_index(key))->pos];
+	}
+
+	/**
+	 * Returns the reference to the value and marks it as changed.
+	 *
+	 * @param key The key that points to the value.
+	 * @param tick The tick of the change.
+	 * @return The reference to the value.
+	 */
+	T& touch(uint64_t key, uint64_t tick)
+	{
+		assert(contains(key));
+		const Binding& binding = *bindings.find(handle_index(key));
+		uint32_t pos = binding.pos;
+		if constexpr (std::is_copy_constructible_v<T>) {
+			if (binding.copy_on_write) [[unlikely]] {
+				pos = detach(key, pos);
+			}
+		}
+		changed_ticks[pos] = tick;
+		dirty.mark(pos);
+		return dense[pos];
+	}
+
+	/**
+	 * @param key The key that points to the value.
+	 * @return The position of the value inside the dense vector.
+	 */
+	uint32_t position(uint64_t key) const
+	{
+		assert(contains(key));
+		return bindings.find(handle_index(key))->pos;
+	}
+
+	/**
+	 * Returns the value at the position without looking up its key.
+	 *
+	 * @param pos The position inside the dense vector.
+	 * @return The reference to the value.
+	 */
+	T& value_at(uint32_t pos)
+	{
+		assert(pos < dense.size());
+		return dense[pos];
+	}
+
+	/**
+	 * Returns the value at the position and marks it as changed.
+	 *
+	 * Values at a position are never shared, see own().
+	 *
+	 * @param pos The position inside the dense vector.
+	 * @param tick The tick of the change.
+	 * @return The reference to the value.
+	 */
+	T& touch_at(uint32_t pos, uint64_t tick)
+	{
+		assert(pos < dense.size());
+		changed_ticks[pos] = tick;
+		dirty.mark(pos);
+		return dense[pos];
+	}
+
+	/**
+	 * Returns the values at the first positions of the dense vector.
+	 *
+	 * @param count The number of values.
+	 * @return The contiguous values.
+	 */
+	std::span<const T> column(uint32_t count) const
+	{
+		assert(count <= dense.size());
+		return {dense.data(), count};
+	}
+
+	/**
+	 * Returns the values at the first positions and marks them as changed.
+	 *
+	 * Values at a position are never shared, see own().
+	 *
+	 * @param count The number of values.
+	 * @param tick The tick of the change.
+	 * @return The contiguous values.
+	 */
+	std::span<T> touch_column(uint32_t count, uint64_t tick)
+	{
+		assert(count <= dense.size());
+		std::fill_n(changed_ticks.begin(), count, tick);
+		for (uint32_t pos = 0; pos < count; pos += rollback_chunk_size) {
+			dirty.mark(pos);
+		}
+		return {dense.data(), count};
+	}
+
+	/**
+	 * Swaps the values at the positions together with their keys and ticks.
+	 *
+	 * @param lhs The position of the first value.
+	 * @param rhs The position of the second value.
+	 */
+	void swap_positions(uint32_t lhs, uint32_t rhs)
+	{
+		if (lhs == rhs) {
+			return;
+		}
+		using std::swap;
+		swap(dense[lhs], dense[rhs]);
+		std::swap(owners[lhs], owners[rhs]);
+		std::swap(counts[lhs], counts[rhs]);
+		std::swap(added_ticks[lhs], added_ticks[rhs]);
+		std::swap(changed_ticks[lhs], changed_ticks[rhs]);
+		relocate(lhs);
+		relocate(rhs);
+		reshaped = true;
+	}
+
+	/**
+	 * Exchanges the values of both keys and marks them as changed.
+	 *
+	 * Shared values are copied first, so the swap never writes into the
+	 * value of another key. Unlike swap_positions() the keys stay where
+	 * they are, only their values move.
+	 *
+	 * @param lhs_key The key of the first value.
+	 * @param rhs_key The key of the second value.
+	 * @param tick The tick of the change.
+	 */
+	void swap_values(uint64_t lhs_key, uint64_t rhs_key, uint64_t tick)
+	{
+		assert(contains(lhs_key) && contains(rhs_key));
+		// Copying a shared value may grow the storage, so both keys are
+		// detached before any position is read.
+		unshare(lhs_key);
+		unshare(rhs_key);
+		uint32_t lhs = position(lhs_key);
+		uint32_t rhs = position(rhs_key);
+		if (lhs == rhs) {
+			return;
+		}
+		using std::swap;
+		swap(dense[lhs], dense[rhs]);
+		changed_ticks[lhs] = tick;
+		changed_ticks[rhs] = tick;
+		dirty.mark(lhs);
+		dirty.mark(rhs);
+	}
+
+	/**
+	 * Can the storage be owned by a group?
+	 *
+	 * Groups order the values by their keys, so each value must have a
+	 * single key and the storage must not be owned already.
+	 *
+	 * @return Can the storage be owned?
+	 */
+	bool ownable() const noexcept
+	{
+		return !group && keys_count == dense.size();
+	}
+
+	/**
+	 * Hands the order of the values over to the group.
+	 *
+	 * Owned storages reject bind() and share() from now on.
+	 *
+	 * @param group The group that owns the storage.
+	 */
+	void own(StorageListener* group) noexcept
+	{
+		assert(ownable());
+		this->group = group;
+	}
+
+	/**
+	 * @param key The key that points to the value.
+	 * @return The tick at which the value was inserted.
+	 */
+	uint64_t added_tick(uint64_t key) const
+	{
+		assert(contains(key));
+		return added_ticks[bindings.find(handle_index(key))->pos];
+	}
+
+	/**
+	 * @param key The key that points to the value.
+	 * @return The tick at which the value was last changed.
+	 */
+	uint64_t changed_tick(uint64_t key) const
+	{
+		assert(contains(key));
+		return changed_ticks[bindings.find(handle_index(key))->pos];
+	}
+
+	/**
+	 * Returns true iff the value is inside the storage.
+	 *
+	 * @param key The key that points to the value.
+	 * @return Is the value inside this storage?
+	 */
+	bool contains(uint64_t key) const override
+	{
+		const Binding* binding = bindings.find(handle_index(key));
+		return binding && binding->key == key;
+	}
+
+	/**
+	 * Returns the number of keys inside the storage.
+	 *
+	 * @return The number of keys inside the storage.
+	 */
+	uint64_t size() const override
+	{
+		return keys_count;
+	}
+
+	/**
+	 * Returns all keys inside the storage.
+	 *
+	 * @return The keys inside the storage.
+	 */
+	std::set<uint64_t> keys() const
+	{
+		std::set<uint64_t> result;
+		each([&](uint64_t key) { result.insert(key); });
+		return result;
+	}
+
+	/**
+	 * Calls the function for each key inside the storage.
+	 *
+	 * Keys sharing the same value are visited one after another.
+	 *
+	 * @param function The function that is called with each key.
+	 */
+	template <typename Function>
+	void each(Function function) const
+	{
+		for (uint64_t owner : owners) {
+			uint32_t index = handle_index(owner);
+			for (; index != null_slot; index = bindings.find(index)->next) {
+				function(bindings.find(index)->key);
+			}
+		}
+	}
+
+	/**
+	 * Registers the listener for key insertions and removals.
+	 *
+	 * @param listener The listener that should be notified.
+	 */
+	void subscribe(StorageListener* listener) override
+	{
+		listeners.push_back(listener);
+	}
+
+	std::string_view name() const override
+	{
+		return StorageRegistration<T>::name;
+	}
+
+	StorageStats stats() const override
+	{
+		uint64_t bytes = dense.capacity() * sizeof(T) + counts.capacity() * sizeof(uint32_t)
+			+ (owners.capacity() + added_ticks.capacity() + changed_ticks.capacity()) * sizeof(uint64_t)
+			+ bindings.capacity() * sizeof(Binding);
+		double load = bindings.capacity() ? double(keys_count) / bindings.capacity() : 0;
+		return {name(), keys_count, dense.size(), dense.capacity(), bytes, load};
+	}
+
+	bool serializable() const override
+	{
+		return Serializer<T>::enabled;
+	}
+
+	/**
+	 * Writes the storage into the snapshot.
+	 *
+	 * The owners, ticks and values are written as contiguous blocks,
+	 * followed by the keys that share a value with its owner.
+	 *
+	 * @param writer The writer of the snapshot.
+	 */
+	void save(SnapshotWriter& writer) const override
+	{
+		if constexpr (Serializer<T>::enabled) {
+			writer.write_array<uint64_t>(owners);
+			writer.write_array<uint64_t>(added_ticks);
+			writer.write_array<uint64_t>(changed_ticks);
+			save_values<T>(writer, dense);
+			std::vector<Binding> shared;
+			for (uint32_t pos = 0; pos < owners.size(); pos++) {
+				uint32_t index = bindings.find(handle_index(owners[pos]))->next;
+				for (; index != null_slot; index = bindings.find(index)->next) {
+					const Binding& binding = *bindings.find(index);
+					shared.push_back({binding.key, pos, null_slot, null_slot, binding.copy_on_write});
+				}
+			}
+			writer.write_array<Binding>(shared);
+		}
+	}
+
+	/**
+	 * Reads the storage from the snapshot.
+	 *
+	 * The blocks are copied back as they are, afterward the bindings are
+	 * rebuilt from the owners and shared keys.
+	 *
+	 * @param reader The reader of the snapshot.
+	 */
+	void load(SnapshotReader& reader) override
+	{
+		assert(keys_count == 0);
+		if constexpr (Serializer<T>::enabled) {
+			reader.read_array(owners);
+			reader.read_array(added_ticks);
+			reader.read_array(changed_ticks);
+			load_values<T>(reader, dense);
+			std::vector<Binding> shared;
+			reader.read_array(shared);
+			uint64_t count = owners.size();
+			if (added_ticks.size() != count || changed_ticks.size() != count || dense.size() != count) {
+				throw std::runtime_error("The snapshot is corrupted!");
+			}
+			counts.assign(count, 1);
+			for (uint32_t pos = 0; pos < count; pos++) {
+				bindings[handle_index(owners[pos])] = {owners[pos], pos};
+			}
+			for (const Binding& binding : shared) {
+				if (binding.pos >= count) {
+					throw std::runtime_error("The snapshot is corrupted!");
+				}
+				Binding& owner = bindings[handle_index(owners[binding.pos])];
+				bindings[handle_index(binding.key)] = {binding.key, binding.pos};
+				chain(handle_index(binding.key), handle_index(owner.key));
+				bindings[handle_index(binding.key)].copy_on_write = binding.copy_on_write;
+				shared_count += binding.copy_on_write && !owner.copy_on_write;
+				owner.copy_on_write = owner.copy_on_write || binding.copy_on_write;
+				counts[binding.pos]++;
+			}
+			keys_count = count + shared.size();
+			reshaped = true;
+			dirty.reset(0);
+			moved.reset(0);
+			for (StorageListener* listener : listeners) {
+				listener->invalidate();
+			}
+			if (!listeners.empty()) {
+				each([&](uint64_t key) { notify(key); });
+			}
+		}
+	}
+
+	/**
+	 * Captures the storage for a later rollback.
+	 *
+	 * The value and tick chunks that were not written since the last
+	 * capture are shared with it. The bindings and owners are only copied
+	 * if keys were inserted or removed in the meantime.
+	 *
+	 * @return The captured state.
+	 */
+	std::shared_ptr<const StorageState> capture() override
+	{
+		if constexpr (!std::is_copy_constructible_v<T>) {
+			throw std::logic_error("The components can't be copied!");
+		} else {
+			auto state = std::make_shared<State>();
+			if (reshaped || !captured) {
+				state->structure = std::make_shared<const Structure>(
+					Structure{bindings, keys_count, shared_count, owners, counts});
+			} else {
+				state->structure = captured->structure;
+			}
+			static const State empty;
+			const State& previous = captured ? *captured : empty;
+			state->values = capture_chunks(dense, previous.values, dirty);
+			state->added = capture_chunks(added_ticks, previous.added, moved);
+			state->changed = capture_chunks(changed_ticks, previous.changed, dirty);
+			dirty.reset(state->values.size());
+			moved.reset(state->values.size());
+			reshaped = false;
+			captured = state;
+			return state;
+		}
+	}
+
+	/**
+	 * Restores the storage from a captured state.
+	 *
+	 * Only chunks that differ from the last capture or were written since
+	 * then are copied back.
+	 *
+	 * @param base The captured state, nullptr for an empty storage.
+	 */
+	void rollback(const std::shared_ptr<const StorageState>& base) override
+	{
+		if constexpr (!std::is_copy_constructible_v<T>) {
+			throw std::logic_error("The components can't be copied!");
+		} else {
+			auto state = std::static_pointer_cast<const State>(base);
+			if (!state) {
+				std::vector<uint64_t> keys;
+				each([&](uint64_t key) { keys.push_back(key); });
+				remove_many(keys);
+				captured = nullptr;
+				return;
+			}
+			bool restructure = reshaped || !captured || captured->structure != state->structure;
+			bool report = restructure && !listeners.empty();
+			std::vector<uint64_t> before;
+			if (report) {
+				each([&](uint64_t key) { before.push_back(key); });
+			}
+			if (restructure) {
+				bindings = state->structure->bindings;
+				keys_count = state->structure->keys_count;
+				shared_count = state->structure->shared_count;
+				owners = state->structure->owners;
+				counts = state->structure->counts;
+				for (StorageListener* listener : listeners) {
+					listener->invalidate();
+				}
+			}
+			static const State empty;
+			const State& previous = captured ? *captured : empty;
+			restore_chunks(dense, state->values, previous.values, dirty);
+			restore_chunks(added_ticks, state->added, previous.added, moved);
+			restore_chunks(changed_ticks, state->changed, previous.changed, dirty);
+			dirty.reset(state->values.size());
+			moved.reset(state->values.size());
+			reshaped = false;
+			captured = state;
+			if (report) {
+				std::vector<uint64_t> after;
+				each([&](uint64_t key) { after.push_back(key); });
+				each_difference(before, after, [&](uint64_t key) { notify(key); });
+			}
+		}
+	}
+
+private:
+	// Appends a new value for the key, the key count is left unchanged.
+	template <typename ... Args>
+	T& append(uint64_t key, uint64_t added, uint64_t changed, Args&& ... args)
+	{
+		// The value is constructed first, so throwing leaves no stale keys.
+		T& value = dense.emplace_back(std::forward<Args>(args)...);
+		uint32_t pos = static_cast<uint32_t>(dense.size() - 1);
+		bindings[handle_index(key)] = {key, pos};
+		reshaped = true;
+		dirty.mark(pos);
+		moved.mark(pos);
+		owners.push_back(key);
+		counts.push_back(1);
+		added_ticks.push_back(added);
+		changed_ticks.push_back(changed);
+		return value;
+	}
+
+	// Completes the values appended behind the first position by
+	// update_many() and notifies the listeners of their keys.
+	void append_tail(uint32_t first)
+	{
+		uint64_t tick = now();
+		uint64_t count = dense.size() - first;
+		if (count == 0) {
+			return;
+		}
+		counts.resize(dense.size(), 1);
+		added_ticks.resize(dense.size(), tick);
+		changed_ticks.resize(dense.size(), tick);
+		keys_count += count;
+		reshaped = true;
+		for (uint64_t chunk = first / rollback_chunk_size; chunk * rollback_chunk_size < dense.size(); chunk++) {
+			dirty.mark(chunk * rollback_chunk_size);
+			moved.mark(chunk * rollback_chunk_size);
+		}
+		notify_inserted(std::span<const uint64_t>(owners).subspan(first));
+	}
+
+	// Adds the source key to the keys of the value of the target key.
+	void link(uint64_t source_key, uint64_t target_key)
+	{
+		uint32_t pos = bindings.find(handle_index(target_key))->pos;
+		bindings[handle_index(source_key)] = {source_key, pos};
+		chain(handle_index(source_key), handle_index(target_key));
+		counts[pos]++;
+		keys_count++;
+		reshaped = true;
+	}
+
+	// Inserts the binding into the chain of keys behind the other one.
+	void chain(uint32_t index, uint32_t after)
+	{
+		Binding& binding = bindings[index];
+		binding.prev = after;
+		binding.next = bindings[after].next;
+		if (binding.next != null_slot) {
+			bindings[binding.next].prev = index;
+		}
+		bindings[after].next = index;
+	}
+
+	// Removes the key from the keys of the value, the binding is kept.
+	void separate(uint64_t key, uint32_t pos)
+	{
+		unlink(key, pos);
+		reshaped = true;
+		bindings[handle_index(key)].copy_on_write = false;
+		// The last key of a shared value no longer shares it.
+		if (--counts[pos] == 1) {
+			Binding& owner = bindings[handle_index(owners[pos])];
+			shared_count -= owner.copy_on_write;
+			owner.copy_on_write = false;
+		}
+	}
+
+	// Moves the key to its own copy of the shared value.
+	uint32_t detach(uint64_t key, uint32_t pos)
+	{
+		separate(key, pos);
+		append(key, added_ticks[pos], changed_ticks[pos], std::as_const(dense[pos]));
+		return static_cast<uint32_t>(dense.size() - 1);
+	}
+
+	void notify(uint64_t key)
+	{
+		for (StorageListener* listener : listeners) {
+			listener->refresh(key);
+		}
+	}
+
+	void notify_inserted(std::span<const uint64_t> keys)
+	{
+		if (keys.empty()) {
+			return;
+		}
+		for (StorageListener* listener : listeners) {
+			listener->refresh_inserted(keys);
+		}
+	}
+
+	void notify_removed(std::span<const uint64_t> keys)
+	{
+		if (keys.empty()) {
+			return;
+		}
+		for (StorageListener* listener : listeners) {
+			listener->refresh_removed(keys);
+		}
+	}
+
+	// Removes the key from the chain of keys sharing the value.
+	void unlink(uint64_t key, uint32_t pos)
+	{
+		const Binding& binding = bindings[handle_index(key)];
+		if (binding.next != null_slot) {
+			bindings[binding.next].prev = binding.prev;
+		}
+		if (owners[pos] == key) {
+			owners[pos] = binding.next == null_slot ? null_handle : bindings[binding.next].key;
+		} else {
+			bindings[binding.prev].next = binding.next;
+		}
+	}
+
+	// Points the keys of the value at the position to it.
+	void relocate(uint32_t pos)
+	{
+		dirty.mark(pos);
+		moved.mark(pos);
+		uint32_t index = handle_index(owners[pos]);
+		for (; index != null_slot; index = bindings[index].next) {
+			bindings[index].pos = pos;
+		}
+	}
+
+	// Swap-back removes the value and moves the keys of the back value.
+	void erase(uint32_t pos)
+	{
+		uint32_t end_pos = static_cast<uint32_t>(dense.size() - 1);
+		dirty.mark(pos);
+		dirty.mark(end_pos);
+		moved.mark(pos);
+		moved.mark(end_pos);
+		if (pos != end_pos) {
+			dense[pos] = std::move(dense.back());
+			owners[pos] = owners.back();
+			counts[pos] = counts.back();
+			added_ticks[pos] = added_ticks.back();
+			changed_ticks[pos] = changed_ticks.back();
+			relocate(pos);
+		}
+		dense.pop_back();
+		owners.pop_back();
+		counts.pop_back();
+		added_ticks.pop_back();
+		changed_ticks.pop_back();
+	}
+
+private:
+	// The slot index that terminates the chain of shared keys.
+	static constexpr uint32_t null_slot = handle_index(null_handle);
+
+	// The key occupying the slot, its value, the keys sharing it and
+	// whether the value is copied on write. The padding holds the flag,
+	// so checking it needs no further load.
+	struct Binding
+	{
+		uint64_t key = null_handle;
+		uint32_t pos = 0;
+		uint32_t next = null_slot;
+		uint32_t prev = null_slot;
+		uint32_t copy_on_write = false;
+	};
+
+	// The keys of a captured state, only copied when keys changed.
+	struct Structure
+	{
+		PagedArray<Binding> bindings;
+		uint64_t keys_count;
+		uint64_t shared_count;
+		std::vector<uint64_t> owners;
+		std::vector<uint32_t> counts;
+	};
+
+	// The captured state, see capture().
+	struct State final : StorageState
+	{
+		std::shared_ptr<const Structure> structure;
+		Chunks<T> values;
+		Chunks<uint64_t> added;
+		Chunks<uint64_t> changed;
+	};
+
+private:
+	PagedArray<Binding> bindings;
+	uint64_t keys_count = 0;
+	// The number of values that are copied on write.
+	uint64_t shared_count = 0;
+	std::vector<uint64_t> owners;
+	// The number of keys of each value, parallel to the dense vector.
+	std::vector<uint32_t> counts;
+	std::pmr::vector<T> dense;
+	std::vector<uint64_t> added_ticks;
+	std::vector<uint64_t> changed_ticks;
+	std::vector<StorageListener*> listeners;
+	// The chunks written, the chunks whose keys were inserted or moved and
+	// whether keys changed since the last capture.
+	DirtyChunks dirty;
+	DirtyChunks moved;
+	bool reshaped = true;
+	std::shared_ptr<const State> captured;
+	// The group that orders the values, see own().
+	StorageListener* group = nullptr;
+};
+
+/**
+ * The split entity storage keeps each field of the values in its own vector.
+ *
+ * The members listed by component_fields are stored as a struct of
+ * arrays, so systems that only read or write some fields never load the
+ * others. Values are accessed through SplitReference proxies, which
+ * gather and scatter the fields, and consecutive values through
+ * SplitSpan columns.
+ *
+ * The keys are mapped to positions like inside the dense storage, but
+ * each value has exactly one key. Inserting appends to every column and
+ * removing swaps the back value into the gap. Binding and sharing would
+ * give values multiple keys, so they are not supported.
+ *
+ * Ticks, rollback chunks and listeners behave like inside the dense
+ * storage. The fields are written into snapshots with their own
+ * serializers and the columns allocate from the pool of the storage.
+ */
+template <typename T>
+class EntityStorage<T, SplitPolicy> final : public BaseStorage
+{
+public:
+	static_assert(std::is_default_constructible_v<T>, "Split components must be default constructible");
+
+	explicit EntityStorage(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+		: BaseStorage(upstream), columns(make_columns(field_sequence())) {}
+
+	void update(uint64_t key, const T& value)
+	{
+		emplace(key, value);
+	}
+
+	void update(uint64_t key, T&& value)
+	{
+		emplace(key, std::move(value));
+	}
+
+	// The value is constructed first and then scattered into the columns.
+	template <typename ... Args>
+	SplitReference<T> emplace(uint64_t key, Args&& ... args)
+	{
+		T value(std::forward<Args>(args)...);
+		if (contains(key)) {
+			uint32_t pos = position(key);
+			value_at(pos) = value;
+			changed_ticks[pos] = now();
+			dirty.mark(pos);
+			return value_at(pos);
+		}
+		append(key, std::move(value), now());
+		notify(key);
+		// Listeners may have moved the value, see Group.
+		return (*this)[key];
+	}
+
+	void reserve(uint64_t count)
+	{
+		each_field([&](auto, auto& column) { column.reserve(count); });
+		owners.reserve(count);
+		added_ticks.reserve(count);
+		changed_ticks.reserve(count);
+	}
+
+	// See the dense storage, owned storages insert one key after another.
+	template <typename Function>
+	void update_many(std::span<const uint64_t> keys, Function value_of)
+	{
+		if (group) {
+			for (uint64_t i = 0; i < keys.size(); i++) {
+				emplace(keys[i], value_of(i));
+			}
+			return;
+		}
+		reserve(owners.size() + keys.size());
+		uint32_t first = static_cast<uint32_t>(owners.size());
+		uint64_t tick = now();
+		try {
+			for (uint64_t i = 0; i < keys.size(); i++) {
+				if (contains(keys[i])) {
+					emplace(keys[i], value_of(i));
+				} else {
+					append(keys[i], T(value_of(i)), tick);
+				}
+			}
+		} catch (...) {
+			notify_inserted(std::span<const uint64_t>(owners).subspan(first));
+			throw;
+		}
+		notify_inserted(std::span<const uint64_t>(owners).subspan(first));
+	}
+
+	void remove(uint64_t key) override
+	{
+		if (!contains(key)) {
+			return;
+		}
+		erase(key, position(key));
+		notify(key);
+	}
+
+	// See the dense storage, owned storages remove one key after another.
+	void remove_many(std::span<const uint64_t> keys) override
+	{
+		if (group) {
+			for (uint64_t key : keys) {
+				if (owners.empty()) {
+					return;
+				}
+				remove(key);
+			}
+			return;
+		}
+		std::vector<uint64_t> removed;
+		std::vector<uint32_t> erased;
+		for (uint64_t key : keys) {
+			if (removed.size() == owners.size()) {
+				break;
+			}
+			if (contains(key)) {
+				erased.push_back(position(key));
+				removed.push_back(key);
+				positions[handle_index(key)] = null_position;
+			}
+		}
+		std::sort(erased.begin(), erased.end(), std::greater<>());
+		for (uint32_t pos : erased) {
+			erase(owners[pos], pos);
+		}
+		notify_removed(removed);
+	}
+
+	/**
+	 * Split values have a single key, see the storage.
+	 *
+	 * @throws std::logic_error if the target key has the value.
+	 */
+	void bind(uint64_t source_key, uint64_t target_key)
+	{
+		if (!contains(target_key) || source_key == target_key) {
+			return;
+		}
+		throw std::logic_error("Split components can't be bound!");
+	}
+
+	/**
+	 * Split values have a single key, see the storage.
+	 *
+	 * @throws std::logic_error if the target key has the value.
+	 */
+	void share(uint64_t source_key, uint64_t target_key)
+	{
+		if (!contains(target_key) || source_key == target_key) {
+			return;
+		}
+		throw std::logic_error("Split components can't be shared!");
+	}
+
+	// Split values are never shared.
+	void unshare(uint64_t) noexcept {}
+
+	bool shared() const noexcept
+	{
+		return false;
+	}
+
+	SplitReference<T> operator[](uint64_t key)
+	{
+		assert(contains(key));
+		return value_at(position(key));
+	}
+
+	SplitReference<T> touch(uint64_t key, uint64_t tick)
+	{
+		assert(contains(key));
+		return touch_at(position(key), tick);
+	}
+
+	uint64_t added_tick(uint64_t key) const
+	{
+		assert(contains(key));
+		return added_ticks[position(key)];
+	}
+
+	uint64_t changed_tick(uint64_t key) const
+	{
+		assert(contains(key));
+		return changed_at(position(key));
+	}
+
+	uint32_t position(uint64_t key) const
+	{
+		return positions.get(handle_index(key));
+	}
+
+	SplitReference<T> value_at(uint32_t pos)
+	{
+		assert(pos < owners.size());
+		return SplitReference<T>(std::apply([&](auto& ... column) {
+			return field_pointers_t<T>(column.data() + pos...);
+		}, columns));
+	}
+
+	SplitReference<T> touch_at(uint32_t pos, uint64_t tick)
+	{
+		assert(pos < owners.size());
+		changed_ticks[pos] = tick;
+		dirty.mark(pos);
+		return value_at(pos);
+	}
+
+	/**
+	 * Returns the fields of the values at the first positions.
+	 *
+	 * @param count The number of values.
+	 * @return The columns of the values.
+	 */
+	SplitSpan<const T> column(uint32_t count) const
+	{
+		assert(count <= owners.size());
+		return SplitSpan<const T>(std::apply([](const auto& ... column) {
+			return field_pointers_t<const T>(column.data()...);
+		}, columns), count);
+	}
+
+	/**
+	 * Returns the fields of the values at the first positions and marks
+	 * the values as changed.
+	 *
+	 * Whole chunks of values are stamped with a single tick, so marking
+	 * the columns doesn't add a write per value to the loop over them.
+	 * The chunk ticks are folded into the values before they move, see
+	 * column_ticks.
+	 *
+	 * @param count The number of values.
+	 * @param tick The tick of the change.
+	 * @return The columns of the values.
+	 */
+	SplitSpan<T> touch_column(uint32_t count, uint64_t tick)
+	{
+		assert(count <= owners.size());
+		uint32_t chunks = count / rollback_chunk_size;
+		if (column_ticks.size() < chunks) {
+			column_ticks.resize(chunks);
+		}
+		std::fill_n(column_ticks.begin(), chunks, tick);
+		std::fill(changed_ticks.begin() + chunks * rollback_chunk_size, changed_ticks.begin() + count, tick);
+		for (uint32_t pos = 0; pos < count; pos += rollback_chunk_size) {
+			dirty.mark(pos);
+		}
+		return SplitSpan<T>(std::apply([](auto& ... column) {
+			return field_pointers_t<T>(column.data()...);
+		}, columns), count);
+	}
+
+	// Swaps the fields, keys and ticks at the positions, see Group.
+	void swap_positions(uint32_t lhs, uint32_t rhs)
+	{
+		if (lhs == rhs) {
+			return;
+		}
+		fold(lhs / rollback_chunk_size);
+		fold(rhs / rollback_chunk_size);
+		using std::swap;
+		each_field([&](auto, auto& column) { swap(column[lhs], column[rhs]); });
+		std::swap(owners[lhs], owners[rhs]);
+		std::swap(added_ticks[lhs], added_ticks[rhs]);
+		std::swap(changed_ticks[lhs], changed_ticks[rhs]);
+		positions[handle_index(owners[lhs])] = lhs;
+		positions[handle_index(owners[rhs])] = rhs;
+		dirty.mark(lhs);
+		dirty.mark(rhs);
+		moved.mark(lhs);
+		moved.mark(rhs);
+		reshaped = true;
+	}
+
+	// Exchanges the fields of both keys, see the dense storage.
+	void swap_values(uint64_t lhs_key, uint64_t rhs_key, uint64_t tick)
+	{
+		assert(contains(lhs_key) && contains(rhs_key));
+		uint32_t lhs = position(lhs_key);
+		uint32_t rhs = position(rhs_key);
+		if (lhs == rhs) {
+			return;
+		}
+		using std::swap;
+		each_field([&](auto, auto& column) { swap(column[lhs], column[rhs]); });
+		changed_ticks[lhs] = tick;
+		changed_ticks[rhs] = tick;
+		dirty.mark(lhs);
+		dirty.mark(rhs);
+	}
+
+	// Each value has a single key, so only other groups prevent owning.
+	bool ownable() const noexcept
+	{
+		return !group;
+	}
+
+	void own(StorageListener* group) noexcept
+	{
+		assert(ownable());
+		this->group = group;
+	}
+
+	bool contains(uint64_t key) const override
+	{
+		uint32_t pos = positions.get(handle_index(key));
+		return pos != null_position && owners[pos] == key;
+	}
+
+	uint64_t size() const override
+	{
+		return owners.size();
+	}
+
+	std::set<uint64_t> keys() const
+	{
+		return std::set<uint64_t>(owners.begin(), owners.end());
+	}
+
+	template <typename Function>
+	void each(Function function) const
+	{
+		for (uint64_t owner : owners) {
+			function(owner);
+		}
+	}
+
+	void subscribe(StorageListener* listener) override
+	{
+		listeners.push_back(listener);
+	}
+
+	std::string_view name() const override
+	{
+		return StorageRegistration<T>::name;
+	}
+
+	StorageStats stats() const override
+	{
+		uint64_t bytes = (owners.capacity() + added_ticks.capacity() + changed_ticks.capacity()
+			+ column_ticks.capacity()) * sizeof(uint64_t) + positions.capacity() * sizeof(uint32_t);
+		std::apply([&](const auto& ... column) {
+			((bytes += column.capacity() * sizeof(column[0])), ...);
+		}, columns);
+		double load = positions.capacity() ? double(owners.size()) / positions.capacity() : 0;
+		return {name(), owners.size(), owners.size(), owners.capacity(), bytes, load};
+	}
+
+	bool serializable() const override
+	{
+		return serializable_fields(static_cast<field_types_t<T>*>(nullptr));
+	}
+
+	// Writes the keys and ticks followed by each column as one block.
+	void save(SnapshotWriter& writer) const override
+	{
+		if (serializable()) {
+			writer.write_array<uint64_t>(owners);
+			writer.write_array<uint64_t>(added_ticks);
+			std::vector<uint64_t> changed(changed_ticks.size());
+			for (uint32_t pos = 0; pos < changed.size(); pos++) {
+				changed[pos] = changed_at(pos);
+			}
+			writer.write_array<uint64_t>(changed);
+			each_field([&](auto, const auto& column) {
+				using Field = typename std::remove_cvref_t<decltype(column)>::value_type;
+				if constexpr (Serializer<Field>::enabled) {
+					save_values<Field>(writer, column);
+				}
+			});
+		}
+	}
+
+	void load(SnapshotReader& reader) override
+	{
+		assert(owners.empty());
+		if (serializable()) {
+			reader.read_array(owners);
+			reader.read_array(added_ticks);
+			reader.read_array(changed_ticks);
+			column_ticks.clear();
+			uint64_t count = owners.size();
+			bool corrupted = added_ticks.size() != count || changed_ticks.size() != count;
+			each_field([&](auto, auto& column) {
+				using Field = typename std::remove_cvref_t<decltype(column)>::value_type;
+				if constexpr (Serializer<Field>::enabled) {
+					load_values(reader, column);
+				}
+				corrupted = corrupted || column.size() != count;
+			});
+			if (corrupted) {
+				throw std::runtime_error("The snapshot is corrupted!");
+			}
+			for (uint32_t pos = 0; pos < count; pos++) {
+				positions[handle_index(owners[pos])] = pos;
+			}
+			reshaped = true;
+			dirty.reset(0);
+			moved.reset(0);
+			for (StorageListener* listener : listeners) {
+				listener->invalidate();
+			}
+			each([&](uint64_t key) { notify(key); });
+		}
+	}
+
+	/**
+	 * Captures the storage for a later rollback.
+	 *
+	 * Each column is split into chunks like the dense vector, the keys
+	 * are only copied if keys were inserted, removed or moved.
+	 *
+	 * @return The captured state.
+	 */
+	std::shared_ptr<const StorageState> capture() override
+	{
+		if constexpr (!std::is_copy_constructible_v<T>) {
+			throw std::logic_error("The components can't be copied!");
+		} else {
+			auto state = std::make_shared<State>();
+			fold_all();
+			if (reshaped || !captured) {
+				state->owners = std::make_shared<const std::vector<uint64_t>>(owners);
+			} else {
+				state->owners = captured->owners;
+			}
+			static const State empty;
+			const State& previous = captured ? *captured : empty;
+			[&]<std::size_t ... I>(std::index_sequence<I...>) {
+				((std::get<I>(state->columns) = capture_chunks(
+					std::get<I>(columns), std::get<I>(previous.columns), dirty)), ...);
+			}(field_sequence());
+			state->added = capture_chunks(added_ticks, previous.added, moved);
+			state->changed = capture_chunks(changed_ticks, previous.changed, dirty);
+			dirty.reset(state->added.size());
+			moved.reset(state->added.size());
+			reshaped = false;
+			captured = state;
+			return state;
+		}
+	}
+
+	/**
+	 * Restores the storage from a captured state.
+	 *
+	 * @param base The captured state, nullptr for an empty storage.
+	 */
+	void rollback(const std::shared_ptr<const StorageState>& base) override
+	{
+		if constexpr (!std::is_copy_constructible_v<T>) {
+			throw std::logic_error("The components can't be copied!");
+		} else {
+			auto state = std::static_pointer_cast<const State>(base);
+			fold_all();
+			if (!state) {
+				std::vector<uint64_t> keys(owners.begin(), owners.end());
+				remove_many(keys);
+				captured = nullptr;
+				return;
+			}
+			bool restructure = reshaped || !captured || captured->owners != state->owners;
+			std::vector<uint64_t> before;
+			if (restructure) {
+				before = owners;
+				for (uint64_t owner : owners) {
+					positions[handle_index(owner)] = null_position;
+				}
+				owners = *state->owners;
+				for (uint32_t pos = 0; pos < owners.size(); pos++) {
+					positions[handle_index(owners[pos])] = pos;
+				}
+				for (StorageListener* listener : listeners) {
+					listener->invalidate();
+				}
+			}
+			static const State empty;
+			const State& previous = captured ? *captured : empty;
+			[&]<std::size_t ... I>(std::index_sequence<I...>) {
+				(restore_chunks(std::get<I>(columns), std::get<I>(state->columns),
+					std::get<I>(previous.columns), dirty), ...);
+			}(field_sequence());
+			restore_chunks(added_ticks, state->added, previous.added, moved);
+			restore_chunks(changed_ticks, state->changed, previous.changed, dirty);
+			dirty.reset(state->added.size());
+			moved.reset(state->added.size());
+			reshaped = false;
+			captured = state;
+			if (restructure && !listeners.empty()) {
+				std::vector<uint64_t> after = owners;
+				each_difference(before, after, [&](uint64_t key) { notify(key); });
+			}
+		}
+	}
+
+private:
+	// The vector of each field, allocated from the pool.
+	using Columns = transform_fields_t<std::pmr::vector, field_types_t<T>>;
+
+	// Scatters the value of a new key into the columns.
+	void append(uint64_t key, T&& value, uint64_t tick)
+	{
+		uint32_t pos = static_cast<uint32_t>(owners.size());
+		each_field([&](auto member, auto& column) { column.push_back(std::move(value.*member)); });
+		owners.push_back(key);
+		added_ticks.push_back(tick);
+		changed_ticks.push_back(tick);
+		positions[handle_index(key)] = pos;
+		reshaped = true;
+		dirty.mark(pos);
+		moved.mark(pos);
+	}
+
+	// Swap-back removes the value of the key, listeners are not notified.
+	void erase(uint64_t key, uint32_t pos)
+	{
+		uint32_t end_pos = static_cast<uint32_t>(owners.size() - 1);
+		fold(pos / rollback_chunk_size);
+		fold(end_pos / rollback_chunk_size);
+		dirty.mark(pos);
+		dirty.mark(end_pos);
+		moved.mark(pos);
+		moved.mark(end_pos);
+		if (pos != end_pos) {
+			each_field([&](auto, auto& column) { column[pos] = std::move(column.back()); });
+			owners[pos] = owners.back();
+			added_ticks[pos] = added_ticks.back();
+			changed_ticks[pos] = changed_ticks.back();
+			positions[handle_index(owners[pos])] = pos;
+		}
+		each_field([&](auto, auto& column) { column.pop_back(); });
+		owners.pop_back();
+		added_ticks.pop_back();
+		changed_ticks.pop_back();
+		positions[handle_index(key)] = null_position;
+		reshaped = true;
+	}
+
+	// The change tick of the value including the tick of its chunk.
+	uint64_t changed_at(uint32_t pos) const
+	{
+		uint64_t chunk = pos / rollback_chunk_size;
+		if (chunk < column_ticks.size()) {
+			return std::max(changed_ticks[pos], column_ticks[chunk]);
+		}
+		return changed_ticks[pos];
+	}
+
+	// Stamps the tick of the chunk onto each of its values.
+	void fold(uint64_t chunk)
+	{
+		if (chunk >= column_ticks.size() || column_ticks[chunk] == 0) {
+			return;
+		}
+		uint64_t begin = chunk * rollback_chunk_size;
+		uint64_t end = std::min<uint64_t>(changed_ticks.size(), begin + rollback_chunk_size);
+		for (uint64_t pos = begin; pos < end; pos++) {
+			changed_ticks[pos] = std::max(changed_ticks[pos], column_ticks[chunk]);
+		}
+		column_ticks[chunk] = 0;
+	}
+
+	void fold_all()
+	{
+		for (uint64_t chunk = 0; chunk < column_ticks.size(); chunk++) {
+			fold(chunk);
+		}
+	}
+
+	void notify(uint64_t key)
+	{
+		for (StorageListener* listener : listeners) {
+			listener->refresh(key);
+		}
+	}
+
+	void notify_inserted(std::span<const uint64_t> keys)
+	{
+		if (keys.empty()) {
+			return;
+		}
+		for (StorageListener* listener : listeners) {
+			listener->refresh_inserted(keys);
+		}
+	}
+
+	void notify_removed(std::span<const uint64_t> keys)
+	{
+		if (keys.empty()) {
+			return;
+		}
+		for (StorageListener* listener : listeners) {
+			listener->refresh_removed(keys);
+		}
+	}
+
+	// Calls the function with each member pointer and its column.
+	template <typename Function>
+	void each_field(Function function)
+	{
+		[&]<std::size_t ... I>(std::index_sequence<I...>) {
+			(function(std::get<I>(component_fields<T>::members), std::get<I>(columns)), ...);
+		}(field_sequence());
+	}
+
+	template <typename Function>
+	void each_field(Function function) const
+	{
+		[&]<std::size_t ... I>(std::index_sequence<I...>) {
+			(function(std::get<I>(component_fields<T>::members), std::get<I>(columns)), ...);
+		}(field_sequence());
+	}
+
+	static constexpr auto field_sequence() noexcept
+	{
+		return std::make_index_sequence<std::tuple_size_v<field_types_t<T>>>();
+	}
+
+	template <std::size_t ... I>
+	Columns make_columns(std::index_sequence<I...>)
+	{
+		return Columns(std::tuple_element_t<I, Columns>(resource())...);
+	}
+
+	template <typename ... F>
+	static constexpr bool serializable_fields(std::tuple<F...>*) noexcept
+	{
+		return (Serializer<F>::enabled && ...);
+	}
+
+private:
+	// The position of keys that are not inside the storage.
+	static constexpr uint32_t null_position = ~uint32_t(0);
+
+	// The captured state, see capture().
+	struct State final : StorageState
+	{
+		std::shared_ptr<const std::vector<uint64_t>> owners;
+		transform_fields_t<Chunks, field_types_t<T>> columns;
+		Chunks<uint64_t> added;
+		Chunks<uint64_t> changed;
+	};
+
+private:
+	PagedArray<uint32_t> positions = PagedArray<uint32_t>(null_position);
+	std::vector<uint64_t> owners;
+	Columns columns;
+	std::vector<uint64_t> added_ticks;
+	std::vector<uint64_t> changed_ticks;
+	// The change ticks of whole chunks written by touch_column(). Only
+	// full chunks are stamped and every chunk is folded into the values
+	// before any of them move, so a chunk tick never covers other values.
+	std::vector<uint64_t> column_ticks;
+	std::vector<StorageListener*> listeners;
+	// See the dense storage.
+	DirtyChunks dirty;
+	DirtyChunks moved;
+	bool reshaped = true;
+	std::shared_ptr<const State> captured;
+	// The group that orders the values, see Group.
+	StorageListener* group = nullptr;
+};
+
+/**
+ * The hashed entity storage keeps each value inside its own allocation.
+ *
+ * A hash map binds the keys to shared pointers of the values, so bound
+ * keys share the same value. Inserting and removing never moves other
+ * values, but iterating the values is not contiguous. This suits large
+ * components that only few entities have.
+ *
+ * Values shared with copy-on-write are marked, writing to them while the
+ * pointer is used by other keys replaces the pointer with a copy.
+ *
+ * The values and their reference counts are allocated from the pool of
+ * the storage.
+ */
+template <typename T>
+class EntityStorage<T, HashedPolicy> final : public BaseStorage
+{
+public:
+	explicit EntityStorage(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+		: BaseStorage(upstream) {}
+
+	void update(uint64_t key, const T& value)
+	{
+		emplace(key, value);
+	}
+
+	void update(uint64_t key, T&& value)
+	{
+		emplace(key, std::move(value));
+	}
+
+	template <typename ... Args>
+	T& emplace(uint64_t key, Args&& ... args)
+	{
+		auto found = values.find(key);
+		if (found != values.end() && is_shared(*found)) {
+			uint64_t added = found->second->added;
+			found->second = make_entry(T(std::forward<Args>(args)...), added, now());
+			modified = true;
+			return found->second->value;
+		}
+		if (found != values.end()) {
+			assign(found->second->value, std::forward<Args>(args)...);
+			found->second->changed = now();
+			modified = true;
+			return found->second->value;
+		}
+		auto entry = make_entry(T(std::forward<Args>(args)...), now(), now());
+		values.emplace(key, entry);
+		modified = true;
+		notify(key);
+		return entry->value;
+	}
+
+	void reserve(uint64_t count)
+	{
+		values.reserve(count);
+	}
+
+	// See the dense storage.
+	template <typename Function>
+	void update_many(std::span<const uint64_t> keys, Function value_of)
+	{
+		reserve(values.size() + keys.size());
+		std::vector<uint64_t> inserted;
+		uint64_t tick = now();
+		try {
+			for (uint64_t i = 0; i < keys.size(); i++) {
+				if (values.contains(keys[i])) {
+					emplace(keys[i], value_of(i));
+					continue;
+				}
+				values.emplace(keys[i], make_entry(T(value_of(i)), tick, tick));
+				modified = true;
+				inserted.push_back(keys[i]);
+			}
+		} catch (...) {
+			notify_inserted(inserted);
+			throw;
+		}
+		notify_inserted(inserted);
+	}
+
+	void remove(uint64_t key) override
+	{
+		if (values.erase(key)) {
+			modified = true;
+			sharing = sharing && !values.empty();
+			notify(key);
+		}
+	}
+
+	void remove_many(std::span<const uint64_t> keys) override
+	{
+		std::vector<uint64_t> removed;
+		for (uint64_t key : keys) {
+			if (values.empty()) {
+				break;
+			}
+			if (values.erase(key)) {
+				removed.push_back(key);
+			}
+		}
+		modified = modified || !removed.empty();
+		sharing = sharing && !values.empty();
+		notify_removed(removed);
+	}
+
+	void bind(uint64_t source_key, uint64_t target_key)
+	{
+		if (!contains(target_key) || source_key == target_key) {
+			return;
+		}
+		remove(source_key);
+		unshare(target_key);
+		std::shared_ptr<Entry>& target = values.at(target_key);
+		target->copy_on_write = false;
+		values.emplace(source_key, target);
+		modified = true;
+		notify(source_key);
+	}
+
+	void share(uint64_t source_key, uint64_t target_key)
+	{
+		if (!contains(target_key) || source_key == target_key) {
+			return;
+		}
+		remove(source_key);
+		std::shared_ptr<Entry>& target = values.at(target_key);
+		if (target.use_count() > 1 && !target->copy_on_write) {
+			values.emplace(source_key, make_entry(target->value, now(), now()));
+		} else {
+			target->copy_on_write = true;
+			values.emplace(source_key, target);
+			sharing = true;
+		}
+		modified = true;
+		notify(source_key);
+	}
+
+	void unshare(uint64_t key)
+	{
+		if constexpr (std::is_copy_constructible_v<T>) {
+			auto found = values.find(key);
+			if (found != values.end() && is_shared(*found)) {
+				found->second = make_entry(*found->second);
+				found->second->copy_on_write = false;
+				modified = true;
+			}
+		}
+	}
+
+	// Might any value be shared? Only reset once the storage is empty.
+	bool shared() const noexcept
+	{
+		return sharing;
+	}
+
+	T& operator[](uint64_t key)
+	{
+		assert(contains(key));
+		return values.find(key)->second->value;
+	}
+
+	T& touch(uint64_t key, uint64_t tick)
+	{
+		assert(contains(key));
+		unshare(key);
+		Entry& entry = *values.find(key)->second;
+		entry.changed = tick;
+		modified = true;
+		return entry.value;
+	}
+
+	// Exchanges the values of both keys, see the dense storage.
+	void swap_values(uint64_t lhs_key, uint64_t rhs_key, uint64_t tick)
+	{
+		assert(contains(lhs_key) && contains(rhs_key));
+		unshare(lhs_key);
+		unshare(rhs_key);
+		Entry& lhs = *values.find(lhs_key)->second;
+		Entry& rhs = *values.find(rhs_key)->second;
+		if (&lhs == &rhs) {
+			return;
+		}
+		using std::swap;
+		swap(lhs.value, rhs.value);
+		lhs.changed = tick;
+		rhs.changed = tick;
+		modified = true;
+	}
+
+	uint64_t added_tick(uint64_t key) const
+	{
+		assert(contains(key));
+		return values.find(key)->second->added;
+	}
+
+	uint64_t changed_tick(uint64_t key) const
+	{
+		assert(contains(key));
+		return values.find(key)->second->changed;
+	}
+
+	bool contains(uint64_t key) const override
+	{
+		return values.contains(key);
+	}
+
+	uint64_t size() const override
+	{
+		return values.size();
+	}
+
+	std::set<uint64_t> keys() const
+	{
+		std::set<uint64_t> result;
+		each([&](uint64_t key) { result.insert(key); });
+		return result;
+	}
+
+	template <typename Function>
+	void each(Function function) const
+	{
+		for (const auto& [key, value] : values) {
+			function(key);
+		}
+	}
+
+	void subscribe(StorageListener* listener) override
+	{
+		listeners.push_back(listener);
+	}
+
+	std::string_view name() const override
+	{
+		return StorageRegistration<T>::name;
+	}
+
+	StorageStats stats() const override
+	{
+		std::unordered_set<const Entry*> entries;
+		for (const auto& [key, entry] : values) {
+			entries.insert(entry.get());
+		}
+		// Approximates the nodes of the map and the shared allocations.
+		uint64_t bytes = values.bucket_count() * sizeof(void*)
+			+ values.size() * (sizeof(typename decltype(values)::value_type) + sizeof(void*))
+			+ entries.size() * (sizeof(Entry) + 2 * sizeof(void*));
+		uint64_t capacity = static_cast<uint64_t>(values.bucket_count() * values.max_load_factor());
+		return {name(), values.size(), entries.size(), capacity, bytes, values.load_factor()};
+	}
+
+	bool serializable() const override
+	{
+		return Serializer<T>::enabled;
+	}
+
+	// Writes each shared value once, followed by the keys and their value.
+	void save(SnapshotWriter& writer) const override
+	{
+		if constexpr (Serializer<T>::enabled) {
+			std::unordered_map<const Entry*, uint64_t> indices;
+			std::vector<Key> keys;
+			for (const auto& [key, entry] : values) {
+				auto [index, inserted] = indices.try_emplace(entry.get(), indices.size());
+				keys.push_back({key, index->second});
+			}
+			std::vector<const Entry*> entries(indices.size());
+			for (auto [entry, index] : indices) {
+				entries[index] = entry;
+			}
+			writer.write<uint64_t>(entries.size());
+			for (const Entry* entry : entries) {
+				writer.write(entry->added);
+				writer.write(entry->changed);
+				writer.write(entry->copy_on_write);
+				save_value(writer, entry->value);
+			}
+			writer.write_array<Key>(keys);
+		}
+	}
+
+	void load(SnapshotReader& reader) override
+	{
+		assert(values.empty());
+		if constexpr (Serializer<T>::enabled) {
+			std::vector<std::shared_ptr<Entry>> entries(reader.read<uint64_t>());
+			for (std::shared_ptr<Entry>& entry : entries) {
+				uint64_t added = reader.read<uint64_t>();
+				uint64_t changed = reader.read<uint64_t>();
+				bool copy_on_write = reader.read<bool>();
+				entry = make_entry(load_value<T>(reader), added, changed, copy_on_write);
+				sharing = sharing || copy_on_write;
+			}
+			std::vector<Key> keys;
+			reader.read_array(keys);
+			values.reserve(keys.size());
+			for (Key key : keys) {
+				if (key.entry >= entries.size()) {
+					throw std::runtime_error("The snapshot is corrupted!");
+				}
+				values.emplace(key.key, entries[key.entry]);
+				notify(key.key);
+			}
+			modified = true;
+		}
+	}
+
+	/**
+	 * Captures the storage for a later rollback.
+	 *
+	 * The values are copied once per shared value. The last capture is
+	 * reused if nothing was written since then.
+	 *
+	 * @return The captured state.
+	 */
+	std::shared_ptr<const StorageState> capture() override
+	{
+		if constexpr (!std::is_copy_constructible_v<T>) {
+			throw std::logic_error("The components can't be copied!");
+		} else {
+			if (!modified && captured) {
+				return captured;
+			}
+			auto state = std::make_shared<State>();
+			std::unordered_map<const Entry*, uint64_t> indices;
+			for (const auto& [key, entry] : values) {
+				auto [index, inserted] = indices.try_emplace(entry.get(), state->entries.size());
+				if (inserted) {
+					state->entries.push_back(*entry);
+				}
+				state->keys.push_back({key, index->second});
+			}
+			modified = false;
+			captured = state;
+			return state;
+		}
+	}
+
+	/**
+	 * Restores the storage from a captured state.
+	 *
+	 * @param base The captured state, nullptr for an empty storage.
+	 */
+	void rollback(const std::shared_ptr<const StorageState>& base) override
+	{
+		if constexpr (!std::is_copy_constructible_v<T>) {
+			throw std::logic_error("The components can't be copied!");
+		} else {
+			auto state = std::static_pointer_cast<const State>(base);
+			if (!modified && captured == state) {
+				return;
+			}
+			std::vector<uint64_t> before;
+			std::vector<uint64_t> after;
+			each([&](uint64_t key) { before.push_back(key); });
+			values.clear();
+			sharing = false;
+			if (state) {
+				std::vector<std::shared_ptr<Entry>> entries;
+				entries.reserve(state->entries.size());
+				for (const Entry& entry : state->entries) {
+					entries.push_back(make_entry(entry));
+					sharing = sharing || entry.copy_on_write;
+				}
+				values.reserve(state->keys.size());
+				for (Key key : state->keys) {
+					values.emplace(key.key, entries[key.entry]);
+					after.push_back(key.key);
+				}
+			}
+			modified = false;
+			captured = state;
+			each_difference(before, after, [&](uint64_t key) { notify(key); });
+		}
+	}
+
+private:
+	void notify(uint64_t key)
+	{
+		for (StorageListener* listener : listeners) {
+			listener->refresh(key);
+		}
+	}
+
+	void notify_inserted(std::span<const uint64_t> keys)
+	{
+		if (keys.empty()) {
+			return;
+		}
+		for (StorageListener* listener : listeners) {
+			listener->refresh_inserted(keys);
+		}
+	}
+
+	void notify_removed(std::span<const uint64_t> keys)
+	{
+		if (keys.empty()) {
+			return;
+		}
+		for (StorageListener* listener : listeners) {
+			listener->refresh_removed(keys);
+		}
+	}
+
+	// Is the value copied on write and used by other keys?
+	template <typename Element>
+	static bool is_shared(const Element& element)
+	{
+		return element.second->copy_on_write && element.second.use_count() > 1;
+	}
+
+private:
+	// The value and its ticks, see the dense storage.
+	struct Entry
+	{
+		T value;
+		uint64_t added;
+		uint64_t changed;
+		bool copy_on_write = false;
+	};
+
+	// The key and the index of its value inside a snapshot.
+	struct Key
+	{
+		uint64_t key;
+		uint64_t entry;
+	};
+
+	// The captured state, see capture().
+	struct State final : StorageState
+	{
+		std::vector<Entry> entries;
+		std::vector<Key> keys;
+	};
+
+	// Allocates the entry and its reference count from the pool.
+	template <typename ... Args>
+	std::shared_ptr<Entry> make_entry(Args&& ... args)
+	{
+		std::pmr::polymorphic_allocator<Entry> allocator(resource());
+		return std::allocate_shared<Entry>(allocator, std::forward<Args>(args)...);
+	}
+
+private:
+	std::unordered_map<uint64_t, std::shared_ptr<Entry>> values;
+	std::vector<StorageListener*> listeners;
+	// Whether share() was used since the storage was last empty.
+	bool sharing = false;
+	// Whether anything was written since the last capture.
+	bool modified = true;
+	std::shared_ptr<const State> captured;
+};
+
+/**
+ * The tag entity storage only remembers which keys are present.
+ *
+ * Empty components carry no data, so one bit per slot index is enough.
+ * The bits are kept inside a hierarchical bitset, which makes checking
+ * for a tag a single bit test. The generation of each key is stored
+ * next to it, so stale handles of recycled slots are rejected. All keys
+ * share the same value, so binding simply inserts the source key.
+ *
+ * Tags carry no data and therefore never change, their changed tick is
+ * the tick at which they were added.
+ */
+template <typename T>
+class EntityStorage<T, TagPolicy> final : public BaseStorage
+{
+public:
+	explicit EntityStorage(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+		: BaseStorage(upstream) {}
+
+	template <typename ... Args>
+	T& emplace(uint64_t key, Args&& ...)
+	{
+		update(key);
+		return value;
+	}
+
+	void update(uint64_t key, T = {})
+	{
+		uint32_t index = handle_index(key);
+		if (bits.test(index)) {
+			uint64_t occupant = make_handle(index, generations.get(index));
+			if (occupant == key) {
+				return;
+			}
+			bits.reset(index);
+			notify(occupant);
+		}
+		generations[index] = handle_generation(key);
+		ticks[index] = now();
+		bits.set(index);
+		modified = true;
+		notify(key);
+	}
+
+	void reserve(uint64_t count)
+	{
+		(void) count; // The bitset grows on demand.
+	}
+
+	// Tags have no values, the stale keys of reused slots are replaced.
+	template <typename Function>
+	void update_many(std::span<const uint64_t> keys, Function)
+	{
+		std::vector<uint64_t> replaced;
+		std::vector<uint64_t> inserted;
+		uint64_t tick = now();
+		for (uint64_t key : keys) {
+			uint32_t index = handle_index(key);
+			if (bits.test(index)) {
+				uint64_t occupant = make_handle(index, generations.get(index));
+				if (occupant == key) {
+					continue;
+				}
+				replaced.push_back(occupant);
+			}
+			generations[index] = handle_generation(key);
+			ticks[index] = tick;
+			bits.set(index);
+			inserted.push_back(key);
+		}
+		modified = modified || !inserted.empty();
+		notify_removed(replaced);
+		notify_inserted(inserted);
+	}
+
+	void remove(uint64_t key) override
+	{
+		if (!contains(key)) {
+			return;
+		}
+		bits.reset(handle_index(key));
+		modified = true;
+		notify(key);
+	}
+
+	void remove_many(std::span<const uint64_t> keys) override
+	{
+		std::vector<uint64_t> removed;
+		for (uint64_t key : keys) {
+			if (bits.count() == 0) {
+				break;
+			}
+			if (contains(key)) {
+				bits.reset(handle_index(key));
+				removed.push_back(key);
+			}
+		}
+		modified = modified || !removed.empty();
+		notify_removed(removed);
+	}
+
+	void bind(uint64_t source_key, uint64_t target_key)
+	{
+		if (contains(target_key)) {
+			update(source_key);
+		} else {
+			remove(source_key);
+		}
+	}
+
+	void share(uint64_t source_key, uint64_t target_key)
+	{
+		bind(source_key, target_key); // Tags have nothing to copy.
+	}
+
+	void unshare(uint64_t key)
+	{
+		(void) key;
+	}
+
+	bool shared() const noexcept
+	{
+		return false;
+	}
+
+	T& operator[](uint64_t key)
+	{
+		assert(contains(key));
+		return value;
+	}
+
+	T& touch(uint64_t key, uint64_t tick)
+	{
+		(void) tick; // Tags never change.
+		return (*this)[key];
+	}
+
+	void swap_values(uint64_t lhs_key, uint64_t rhs_key, uint64_t tick)
+	{
+		(void) lhs_key, (void) rhs_key, (void) tick; // All tags are equal.
+	}
+
+	uint64_t added_tick(uint64_t key) const
+	{
+		assert(contains(key));
+		return ticks.get(handle_index(key));
+	}
+
+	uint64_t changed_tick(uint64_t key) const
+	{
+		return added_tick(key);
+	}
+
+	bool contains(uint64_t key) const override
+	{
+		uint32_t index = handle_index(key);
+		// Both loads are cheap, avoiding the branch is faster.
+		return bits.test(index) & (generations.get(index) == handle_generation(key));
+	}
+
+	uint64_t size() const override
+	{
+		return bits.count();
+	}
+
+	std::set<uint64_t> keys() const
+	{
+		std::set<uint64_t> result;
+		each([&](uint64_t key) { result.insert(key); });
+		return result;
+	}
+
+	template <typename Function>
+	void each(Function function) const
+	{
+		bits.each([&](uint64_t index) {
+			function(make_handle(static_cast<uint32_t>(index), generations.get(index)));
+		});
+	}
+
+	/**
+	 * Calls the function for each key inside both tag storages.
+	 *
+	 * @param other The other tag storage.
+	 * @param function The function that is called with each key.
+	 */
+	template <typename U, typename Function>
+	void each_common(const EntityStorage<U, TagPolicy>& other, Function function) const
+	{
+		bits.each_common(other.bits, [&](uint64_t index) {
+			uint64_t key = make_handle(static_cast<uint32_t>(index), generations.get(index));
+			if (other.contains(key)) {
+				function(key);
+			}
+		});
+	}
+
+	void subscribe(StorageListener* listener) override
+	{
+		listeners.push_back(listener);
+	}
+
+	std::string_view name() const override
+	{
+		return StorageRegistration<T>::name;
+	}
+
+	StorageStats stats() const override
+	{
+		uint64_t bytes = bits.bytes() + generations.capacity() * sizeof(uint32_t)
+			+ ticks.capacity() * sizeof(uint64_t);
+		double load = bits.capacity() ? double(bits.count()) / bits.capacity() : 0;
+		return {name(), bits.count(), 0, bits.capacity(), bytes, load};
+	}
+
+	bool serializable() const override
+	{
+		return Serializer<T>::enabled;
+	}
+
+	// Writes the keys and their ticks, tags have no values.
+	void save(SnapshotWriter& writer) const override
+	{
+		if constexpr (Serializer<T>::enabled) {
+			std::vector<uint64_t> keys;
+			std::vector<uint64_t> added;
+			keys.reserve(size());
+			added.reserve(size());
+			each([&](uint64_t key) {
+				keys.push_back(key);
+				added.push_back(ticks.get(handle_index(key)));
+			});
+			writer.write_array<uint64_t>(keys);
+			writer.write_array<uint64_t>(added);
+		}
+	}
+
+	void load(SnapshotReader& reader) override
+	{
+		assert(bits.count() == 0);
+		if constexpr (Serializer<T>::enabled) {
+			std::vector<uint64_t> keys;
+			std::vector<uint64_t> added;
+			reader.read_array(keys);
+			reader.read_array(added);
+			if (keys.size() != added.size()) {
+				throw std::runtime_error("The snapshot is corrupted!");
+			}
+			for (uint64_t i = 0; i < keys.size(); i++) {
+				uint32_t index = handle_index(keys[i]);
+				generations[index] = handle_generation(keys[i]);
+				ticks[index] = added[i];
+				bits.set(index);
+				notify(keys[i]);
+			}
+			modified = true;
+		}
+	}
+
+	/**
+	 * Captures the storage for a later rollback.
+	 *
+	 * The last capture is reused if no tag was added or removed since.
+	 *
+	 * @return The captured state.
+	 */
+	std::shared_ptr<const StorageState> capture() override
+	{
+		if (!modified && captured) {
+			return captured;
+		}
+		captured = std::make_shared<const State>(bits, generations, ticks);
+		modified = false;
+		return captured;
+	}
+
+	/**
+	 * Restores the storage from a captured state.
+	 *
+	 * @param base The captured state, nullptr for an empty storage.
+	 */
+	void rollback(const std::shared_ptr<const StorageState>& base) override
+	{
+		auto state = std::static_pointer_cast<const State>(base);
+		if (!modified && captured == state) {
+			return;
+		}
+		std::vector<uint64_t> before;
+		std::vector<uint64_t> after;
+		each([&](uint64_t key) { before.push_back(key); });
+		if (state) {
+			bits = state->bits;
+			generations = state->generations;
+			ticks = state->ticks;
+		} else {
+			bits.clear();
+		}
+		each([&](uint64_t key) { after.push_back(key); });
+		modified = false;
+		captured = state;
+		each_difference(before, after, [&](uint64_t key) { notify(key); });
+	}
+
+private:
+	template <typename U, typename Policy>
+	friend class EntityStorage;
+
+	void notify(uint64_t key)
+	{
+		for (StorageListener* listener : listeners) {
+			listener->refresh(key);
+		}
+	}
+
+	void notify_inserted(std::span<const uint64_t> keys)
+	{
+		if (keys.empty()) {
+			return;
+		}
+		for (StorageListener* listener : listeners) {
+			listener->refresh_inserted(keys);
+		}
+	}
+
+	void notify_removed(std::span<const uint64_t> keys)
+	{
+		if (keys.empty()) {
+			return;
+		}
+		for (StorageListener* listener : listeners) {
+			listener->refresh_removed(keys);
+		}
+	}
+
+	// The captured state, see capture().
+	struct State final : StorageState
+	{
+		State(HierarchicalBitset bits, PagedArray<uint32_t> generations, PagedArray<uint64_t> ticks)
+			: bits(std::move(bits)), generations(std::move(generations)), ticks(std::move(ticks)) {}
+
+		HierarchicalBitset bits;
+		PagedArray<uint32_t> generations;
+		PagedArray<uint64_t> ticks;
+	};
+
+private:
+	HierarchicalBitset bits;
+	PagedArray<uint32_t> generations;
+	PagedArray<uint64_t> ticks;
+	T value;
+	std::vector<StorageListener*> listeners;
+	// Whether any tag was added or removed since the last capture.
+	bool modified = true;
+	std::shared_ptr<const State> captured;
+};
+
+/**
+ * Returns the next unused component id.
+ */
+inline std::size_t next_component_id()
+{
+	static std::atomic<std::size_t> counter = 0;
+	return counter++;
+}
+
+/**
+ * Returns the unique id of the component type.
  *
- * It holds (key, value) pairs like a unordered map, but stores the
- * values as a contiguous vector. Multiple keys for the same value are
- * allowed.
+ * The ids are assigned on first use and are dense, so they can be used
+ * as indices into flat arrays. They are stable during the lifetime of
+ * the process but not across different runs.
  *
- * We map the key into a sparse map containing the position inside
- * the dense vector. By layering two maps together we achieve the
- * same complexity as unordered_map for most operations. But with an
- * additional overhead for the pointer redirections.
+ * @param T The type of the component.
+ * @return The id of the component type.
+ */
+template <typename T>
+std::size_t component_id()
+{
+	static const std::size_t id = next_component_id();
+	return id;
+}
+
+/**
+ * Keeps the bit of one storage inside the signatures up to date.
  *
- * Using different keys for the same value works with the bind()
- * method. The value is removed once every key for that value is
- * removed. Updating that values updates it for all keys since it
- * points to the same memory.
+ * The mapping subscribes the tracker before anything else, so the
+ * signatures are current once queries and groups are notified.
+ */
+class SignatureTracker : public StorageListener
+{
+public:
+	SignatureTracker(SignatureTable& table, const BaseStorage& storage, std::size_t bit)
+		: table(table), storage(storage), bit(bit) {}
+
+	void refresh(uint64_t key) override
+	{
+		table.assign(key, bit, storage.contains(key));
+	}
+
+	void refresh_inserted(std::span<const uint64_t> keys) override
+	{
+		table.set(keys, bit);
+	}
+
+	void refresh_removed(std::span<const uint64_t> keys) override
+	{
+		table.clear(keys, bit);
+	}
+
+private:
+	SignatureTable& table;
+	const BaseStorage& storage;
+	std::size_t bit;
+};
+
+/**
+ * The captured state of all storages of an entity mapping.
+ */
+struct MappingState
+{
+	uint64_t clock;
+	std::map<std::pair<std::type_index, uint64_t>, uint64_t> last_runs;
+	// The state of each storage indexed by the component id.
+	std::vector<std::shared_ptr<const StorageState>> storages;
+};
+
+/**
+ * The id of the scheduled system running on the calling thread.
  *
- * Each key should be unique, updating with the same key removes the
- * old value and inserts the new one.
+ * Filtered archetypes remember their last run per system, so two systems
+ * iterating the same archetype don't consume each other's changes. The id
+ * is zero outside of schedulers, see Scheduler::add().
  */
-template <typename T>
-class EntityStorage
+inline thread_local uint64_t running_system = 0;
+
+/**
+ * The entity mapping stores multiple entity storages.
+ *
+ * Each world owns one mapping, so different mappings share nothing.
+ *
+ * The pools of the storages and the frame arena for the temporaries of
+ * iterations allocate through the counting resource of the mapping, so
+ * its counters show whether a frame allocated any memory.
+ *
+ * Every storage also updates the component signatures of the entities,
+ * which queries and groups use to match keys, see SignatureTable.
+ */
+class EntityMapping
 {
 public:
+	EntityMapping() = default;
+	EntityMapping(const EntityMapping&) = delete;
+	EntityMapping& operator=(const EntityMapping&) = delete;
+
+	// The type of the underlying mapping indexed by the component id.
+	using Mapping = std::vector<std::unique_ptr<BaseStorage>>;
+
+	// Returns the typed version of this class from the mapping.
+	template <typename T>
+	EntityStorage<T>& get()
+	{
+		std::size_t id = component_id<T>();
+		if (id >= mapping.size()) {
+			mapping.resize(id + 1);
+		}
+		if (!mapping[id]) {
+			mapping[id] = std::make_unique<EntityStorage<T>>(&upstream);
+			mapping[id]->set_clock(&clock);
+			if (id < signature_width) {
+				trackers.push_back(std::make_unique<SignatureTracker>(table, *mapping[id], id));
+				mapping[id]->subscribe(trackers.back().get());
+			}
+		}
+		return static_cast<EntityStorage<T>&>(*mapping[id]);
+	}
+
 	/**
-	 * Updates the given element or inserts it.
+	 * Returns the component signature of every entity.
 	 *
-	 * @param key The key of the updated value.
-	 * @param value The new value for the key.
+	 * Components whose id is at least signature_width are not tracked.
+	 *
+	 * @return The signatures by the slot index of the entities.
 	 */
-	void update(uint64_t key, T value)
+	const SignatureTable& signatures() const noexcept
 	{
-		if (contains(key)) {
-			(*this)[key] = value;
-			return;
-		}
-		insert(key, value);
+		return table;
 	}
 
 	/**
-	 * Removes the given element from the storage.
+	 * Checks whether the key is inside every storage of the types.
 	 *
-	 * @param key The key of the removed value.
+	 * Tracked components are answered by the signature of the key in
+	 * constant time, the others are looked up in their storage. The
+	 * signatures are shared by all generations of a slot, so the first
+	 * storage rejects stale keys before the signature is checked.
+	 *
+	 * @param T The types of the components.
+	 * @param key The key of the entity.
+	 * @return Does the entity have all components?
 	 */
-	void remove(uint64_t key)
+	template <typename First, typename ... T>
+	bool contains(uint64_t key)
 	{
-		if (!contains(key)) {
-			return;
+		(get<T>(), ...);
+		if (!get<First>().contains(key)) {
+			return false;
 		}
-		uint64_t sid = bindings[key];
-		bindings.erase(key);
-		bindings_count[sid]--;
-		if (bindings_count[sid] > 0) {
-			return;
+		if (((component_id<T>() < signature_width) && ...)) {
+			return table.matches(key, {component_id<T>()...}, {});
 		}
-		bindings_count.erase(sid);
-		dense.remove(sid);
+		return (get<T>().contains(key) && ...);
 	}
 
 	/**
-	 * Binds the source element to the target element inside the storage.
-	 *
-	 * @param source_key The source key that should be binded.
-	 * @param target_key The target key to which to bind.
+	 * @return The tick that stamps changes right now.
 	 */
-	void bind(uint64_t source_key, uint64_t target_key)
+	uint64_t tick() const noexcept
 	{
-		if (!contains(target_key)) {
-			return;
-		}
-		if (contains(source_key)) {
-			remove(source_key);
-		}
-		int sid = bindings[target_key];
-		bindings[source_key] = sid;
-		bindings_count[sid]++;
+		return clock.load(std::memory_order_relaxed);
 	}
-	
+
 	/**
-	 * Returns the reference to the value.
+	 * Starts a new tick, changes afterward are stamped with a later one.
 	 *
-	 * @param key The key that points to the value.
-	 * @return The reference to the value.
+	 * @return The tick before advancing the clock.
 	 */
-	T& operator[](uint64_t key)
+	uint64_t advance() noexcept
 	{
-		assert(contains(key));
-		return dense[bindings[key]];
+		return clock.fetch_add(1, std::memory_order_relaxed);
 	}
 
 	/**
-	 * Returns true iff the value is inside the storage.
+	 * Returns the tick at which the given system last iterated the archetype.
 	 *
-	 * @param key The key that points to the value.
-	 * @return Is the value inside this storage?
+	 * Each system keeps its own tick, so systems sharing an archetype each
+	 * see every change once. Systems that run concurrently must create
+	 * their ticks beforehand, see Archetype::prepare().
+	 *
+	 * @param archetype The type of the filtered archetype.
+	 * @param system The id of the system, zero outside of schedulers.
+	 * @return The reference to the tick, zero if it never ran.
 	 */
-	bool contains(uint64_t key) const
+	uint64_t& last_run(std::type_index archetype, uint64_t system)
 	{
-		return bindings.count(key);
+		return last_runs[{archetype, system}];
+	}
+
+	inline void remove(uint64_t id)
+	{
+		remove_many(std::span<const uint64_t>(&id, 1));
 	}
 
 	/**
-	 * Returns the number of keys inside the storage.
+	 * Removes the keys from every storage.
 	 *
-	 * @return The number of keys inside the storage.
+	 * Only the storages set inside the signature of any key are visited,
+	 * storages that are not tracked by signatures only if they are not
+	 * empty.
+	 *
+	 * @param ids The removed keys.
 	 */
-	uint64_t size() const
+	inline void remove_many(std::span<const uint64_t> ids)
 	{
-		return bindings.size();
+		Signature components;
+		for (uint64_t id : ids) {
+			components |= table.get(id);
+		}
+		components.each([&](std::size_t id) {
+			mapping[id]->remove_many(ids);
+		});
+		for (std::size_t id = signature_width; id < mapping.size(); id++) {
+			if (mapping[id] && mapping[id]->size() != 0) {
+				mapping[id]->remove_many(ids);
+			}
+		}
 	}
 
+	// Returns the cached query for the given type lists, see query.h.
+	template <typename Include, typename Exclude>
+	Query<Include, Exclude>& query();
+
+	// Returns the cached owning group for the given type lists, see group.h.
+	template <typename Owned, typename Include, typename Exclude>
+	Group<Owned, Include, Exclude>& group();
+
 	/**
-	 * Returns all keys inside the storage.
+	 * Collects the statistics of every storage and cached query.
 	 *
-	 * @return The keys inside the storage.
+	 * The counters of the queries cover the time since the last call to
+	 * reset_statistics().
+	 *
+	 * @return The statistics without any systems.
 	 */
-	std::set<uint64_t> keys() const
+	Statistics statistics() const
 	{
-		std::set<uint64_t> result;
-		for (auto[key, _] : bindings) {
-			result.insert(key);
+		Statistics result;
+		for (const auto& storage : mapping) {
+			if (storage) {
+				result.storages.push_back(storage->stats());
+			}
+		}
+		for (const auto& [type, query] : queries) {
+			result.queries.push_back(query->stats());
 		}
 		return result;
 	}
 
-private:
-	void insert(uint64_t key, T value)
+	/**
+	 * Starts counting the activity of the queries anew, e.g. each frame.
+	 */
+	void reset_statistics() noexcept
 	{
-		static uint64_t sid = 0;
-		bindings[key] = ++sid;
-		bindings_count[sid] = 1;
-		dense.update(sid, value);
+		for (const auto& [type, query] : queries) {
+			query->reset_stats();
+		}
 	}
 
-private:
-	std::unordered_map<uint64_t, uint64_t> bindings;
-	std::unordered_map<uint64_t, uint64_t> bindings_count;
-	DenseMap<uint64_t, T> dense;
-};
+	/**
+	 * @return The resource through which the mapping allocates.
+	 */
+	const CountingResource& memory() const noexcept
+	{
+		return upstream;
+	}
 
-/**
- * The entity mapping stores multiple entity storages.
- */
-class EntityMapping
-{
-public:
-	// The type of the underlying mapping.
-	using Mapping = std::unordered_map<std::type_index, std::any>;
+	/**
+	 * @return The arena for the temporaries of iterations.
+	 */
+	FrameArena& arena() noexcept
+	{
+		return frame_arena;
+	}
+
+	/**
+	 * Writes the clock and every serializable storage into the snapshot.
+	 *
+	 * Each storage is written as a block behind the name of its type,
+	 * so storages can be found without knowing the component ids.
+	 *
+	 * @param writer The writer of the snapshot.
+	 */
+	void save(SnapshotWriter& writer) const
+	{
+		writer.write(tick());
+		uint64_t count_position = writer.position();
+		writer.write<uint64_t>(0);
+		uint64_t count = 0;
+		for (const auto& storage : mapping) {
+			if (!storage || !storage->serializable()) {
+				continue;
+			}
+			std::string_view name = storage->name();
+			writer.write<uint64_t>(name.size());
+			writer.write(name.data(), name.size());
+			uint64_t size_position = writer.position();
+			writer.write<uint64_t>(0);
+			storage->save(writer);
+			writer.patch<uint64_t>(size_position, writer.position() - size_position - sizeof(uint64_t));
+			count++;
+		}
+		writer.patch(count_position, count);
+	}
 
-	// The type of the map storing callable versions of the remove method.
-	using Remover = std::unordered_map<std::type_index, std::function<void(uint64_t)>>;
+	/**
+	 * Reads the clock and the storages written by save().
+	 *
+	 * Storages of component types that are unknown to this program are
+	 * skipped. The restored storages must be empty beforehand. The last
+	 * runs are forgotten, so filters report every component once.
+	 *
+	 * @param reader The reader of the snapshot.
+	 */
+	void load(SnapshotReader& reader)
+	{
+		clock = reader.read<uint64_t>();
+		last_runs.clear();
+		uint64_t count = reader.read<uint64_t>();
+		for (uint64_t i = 0; i < count; i++) {
+			std::span<const std::byte> name = reader.take(reader.read<uint64_t>());
+			SnapshotReader block(reader.take(reader.read<uint64_t>()));
+			auto factory = storage_factories().find(std::string_view(
+				reinterpret_cast<const char*>(name.data()), name.size()));
+			if (factory != storage_factories().end()) {
+				factory->second(*this).load(block);
+			}
+		}
+		regroup();
+	}
 
-	// Returns the typed version of this class from the mapping.
-	template <typename T>
-	EntityStorage<T>& get()
+	/**
+	 * Captures the clock, the last runs and every storage.
+	 *
+	 * @return The captured state.
+	 * @throws std::logic_error if any components can't be copied.
+	 */
+	MappingState capture()
 	{
-		auto type = std::type_index(typeid(T));
-		if (mapping.count(type) == 0) {
-			mapping[type] = EntityStorage<T>();
-			remover[type] = [this, type](uint64_t id){
-				auto& storage = std::any_cast<EntityStorage<T>&>(this->mapping[type]);
-				storage.remove(id);
-			};
+		MappingState state{tick(), last_runs, {}};
+		state.storages.resize(mapping.size());
+		for (std::size_t id = 0; id < mapping.size(); id++) {
+			if (mapping[id]) {
+				state.storages[id] = mapping[id]->capture();
+			}
 		}
-		return std::any_cast<EntityStorage<T>&>(mapping[type]);
+		return state;
 	}
 
-	inline void remove(uint64_t id)
+	/**
+	 * Restores the clock, the last runs and every storage.
+	 *
+	 * Storages created after the capture are emptied. The clock and the
+	 * last runs are restored as well, so filters report the same changes
+	 * when the ticks are simulated again.
+	 *
+	 * @param state The captured state.
+	 */
+	void rollback(const MappingState& state)
+	{
+		clock = state.clock;
+		last_runs = state.last_runs;
+		for (std::size_t id = 0; id < mapping.size(); id++) {
+			if (mapping[id]) {
+				mapping[id]->rollback(id < state.storages.size() ? state.storages[id] : nullptr);
+			}
+		}
+		regroup();
+	}
+
+private:
+	// Rebuilds the groups whose owned storages were restored.
+	void regroup()
 	{
-		for (auto[_, fn_remove] : remover) {
-			fn_remove(id);
+		for (auto& [type, query] : queries) {
+			query->regroup();
 		}
 	}
 
 private:
-	static inline Mapping mapping;
-	static inline Remover remover;
+	// The resources are declared first, so they outlive the storages.
+	CountingResource upstream;
+	FrameArena frame_arena{&upstream};
+	std::atomic<uint64_t> clock = 1;
+	// The last run of each filtered archetype per system.
+	std::map<std::pair<std::type_index, uint64_t>, uint64_t> last_runs;
+	Mapping mapping;
+	SignatureTable table;
+	// The trackers are subscribed first and destroyed before the storages.
+	std::vector<std::unique_ptr<SignatureTracker>> trackers;
+	// The queries and groups are destroyed before the storages they listen to.
+	std::unordered_map<std::type_index, std::unique_ptr<CachedQuery>> queries;
 };
 
+template <typename T>
+BaseStorage& create_storage(EntityMapping& mapping)
+{
+	return mapping.get<T>();
+}
+
 }
@@ -0,0 +1,133 @@
+#include "engine/central/thread_pool.h"
+
+
+namespace kodanuki
+{
+
+// The pool and queue index of the current thread, if it is a worker.
+static thread_local ThreadPool* current_pool = nullptr;
+static thread_local uint32_t current_queue = 0;
+
+ThreadPool::ThreadPool(uint32_t workers)
+{
+	for (uint32_t i = 0; i <= workers; i++) {
+		queues.push_back(std::make_unique<Queue>());
+	}
+	for (uint32_t i = 1; i <= workers; i++) {
+		threads.emplace_back([this, i]{ work(i); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(sleep_mutex);
+		stopping = true;
+	}
+	sleep_condition.notify_all();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+void ThreadPool::run(std::vector<Task> tasks)
+{
+	if (tasks.empty()) {
+		return;
+	}
+	Batch batch;
+	batch.tasks = std::move(tasks);
+	batch.pending = batch.tasks.size();
+
+	{
+		std::lock_guard lock(sleep_mutex);
+		queued += batch.tasks.size();
+	}
+	uint32_t own = current_pool == this ? current_queue : 0;
+	for (uint64_t i = 0; i < batch.tasks.size(); i++) {
+		Queue& queue = *queues[(own + i) % queues.size()];
+		std::lock_guard lock(queue.mutex);
+		queue.jobs.push_back({&batch, i});
+	}
+	sleep_condition.notify_all();
+
+	while (batch.pending > 0) {
+		if (!try_execute(own)) {
+			std::this_thread::yield();
+		}
+	}
+	if (batch.exception) {
+		std::rethrow_exception(batch.exception);
+	}
+}
+
+uint32_t ThreadPool::concurrency() const noexcept
+{
+	return static_cast<uint32_t>(queues.size());
+}
+
+ThreadPool& ThreadPool::global()
+{
+	static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+	return pool;
+}
+
+void ThreadPool::work(uint32_t index)
+{
+	current_pool = this;
+	current_queue = index;
+	while (true) {
+		if (try_execute(index)) {
+			continue;
+		}
+		std::unique_lock lock(sleep_mutex);
+		sleep_condition.wait(lock, [this]{ return stopping || queued > 0; });
+		if (stopping) {
+			return;
+		}
+	}
+}
+
+bool ThreadPool::try_execute(uint32_t index)
+{
+	{
+		Queue& queue = *queues[index];
+		std::unique_lock lock(queue.mutex);
+		if (!queue.jobs.empty()) {
+			Job job = queue.jobs.back();
+			queue.jobs.pop_back();
+			lock.unlock();
+			execute(job);
+			return true;
+		}
+	}
+	for (uint32_t i = 1; i < queues.size(); i++) {
+		Queue& queue = *queues[(index + i) % queues.size()];
+		std::unique_lock lock(queue.mutex);
+		if (!queue.jobs.empty()) {
+			Job job = queue.jobs.front();
+			queue.jobs.pop_front();
+			lock.unlock();
+			execute(job);
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::execute(Job job)
+{
+	queued--;
+	Batch& batch = *job.batch;
+	try {
+		batch.tasks[job.index]();
+	} catch (...) {
+		std::lock_guard lock(batch.exception_mutex);
+		if (!batch.exception) {
+			batch.exception = std::current_exception();
+		}
+	}
+	batch.pending--;
+}
+
+}
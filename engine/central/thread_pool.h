@@ -0,0 +1,134 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace kodanuki
+{
+
+/**
+ * The thread pool executes batches of tasks on multiple threads.
+ *
+ * Each worker owns a queue of tasks. Workers take tasks from the back
+ * of their own queue and steal tasks from the front of other queues when
+ * they run out of work. The thread that submits a batch also executes
+ * tasks until the whole batch is finished. Batches may be submitted from
+ * inside other tasks, the waiting worker keeps executing tasks meanwhile.
+ */
+class ThreadPool
+{
+public:
+	// The type of the tasks inside this pool.
+	using Task = std::function<void()>;
+
+	/**
+	 * Creates the thread pool and starts the worker threads.
+	 *
+	 * @param workers The number of additional threads (may be zero).
+	 */
+	explicit ThreadPool(uint32_t workers);
+
+	/**
+	 * Stops the worker threads after they finished their current task.
+	 */
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/**
+	 * Executes all tasks and waits until every one of them has finished.
+	 *
+	 * The first exception thrown by any task is rethrown after the batch
+	 * has finished.
+	 *
+	 * @param tasks The tasks that should be executed.
+	 */
+	void run(std::vector<Task> tasks);
+
+	/**
+	 * Splits the range [0, count) into chunks and executes them in parallel.
+	 *
+	 * @param count The number of elements inside the range.
+	 * @param grain The maximum number of elements per chunk.
+	 * @param function The function called with the (begin, end) of each chunk.
+	 */
+	template <typename Function>
+	void parallel_for(uint64_t count, uint64_t grain, Function function)
+	{
+		grain = std::max<uint64_t>(grain, 1);
+		if (count <= grain || queues.size() == 1) {
+			function(uint64_t(0), count);
+			return;
+		}
+		std::vector<Task> tasks;
+		tasks.reserve((count + grain - 1) / grain);
+		for (uint64_t begin = 0; begin < count; begin += grain) {
+			uint64_t end = std::min(begin + grain, count);
+			tasks.push_back([&function, begin, end]{ function(begin, end); });
+		}
+		run(std::move(tasks));
+	}
+
+	/**
+	 * @return The number of threads executing tasks including the caller.
+	 */
+	uint32_t concurrency() const noexcept;
+
+	/**
+	 * Returns the pool shared by the entire engine.
+	 *
+	 * It uses one worker less than the hardware concurrency since the
+	 * calling thread also executes tasks.
+	 *
+	 * @return The global thread pool.
+	 */
+	static ThreadPool& global();
+
+private:
+	// The tasks of one call to run().
+	struct Batch
+	{
+		std::vector<Task> tasks;
+		std::atomic<uint64_t> pending;
+		std::exception_ptr exception;
+		std::mutex exception_mutex;
+	};
+
+	// One task of some batch.
+	struct Job
+	{
+		Batch* batch;
+		uint64_t index;
+	};
+
+	// The task queue of one thread.
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	void work(uint32_t index);
+	bool try_execute(uint32_t index);
+	void execute(Job job);
+
+private:
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+	std::atomic<uint64_t> queued = 0;
+	std::mutex sleep_mutex;
+	std::condition_variable sleep_condition;
+	bool stopping = false;
+};
+
+}
@@ -1,116 +1,221 @@
 #pragma once
 #include "engine/central/entity.h"
+#include "engine/central/query.h"
 #include "engine/central/storage.h"
-#include "engine/nekolib/algorithm/sorted_intersection.h"
+#include "engine/nekolib/templates/type_union.h"
+#include <memory_resource>
+#include <span>
+#include <type_traits>
+#include <vector>
 
 
 namespace kodanuki
 {
 
-template <typename ... T>
-std::vector<Entity> search_entities(EntityMapping& mapping, std::type_identity<std::tuple<T...>>)
+// Copies the matches into the frame arena, see FrameArena.
+template <typename Include, typename Exclude>
+std::pmr::vector<uint64_t> search_entities(EntityMapping& mapping, const Query<Include, Exclude>& query)
 {
-	std::vector<Entity> intersection;
-	sorted_intersection(std::back_inserter(intersection), mapping.get<T>().keys()...);
-	return intersection;
+	const std::vector<uint64_t>& keys = query.keys();
+	return std::pmr::vector<uint64_t>(keys.begin(), keys.end(), &mapping.arena());
 }
 
 template <typename T>
-std::vector<Entity> search_entities(EntityMapping& mapping)
-{
-	return search_entities(mapping, std::type_identity<typename T::tuple>());
-}
+struct mutable_types;
 
 template <typename ... T>
-std::tuple<T&...> get_component_reference_tuple(EntityMapping& mapping, int& id,
-	std::type_identity<std::tuple<T...>>)
+struct mutable_types<std::tuple<T...>>
 {
-	return std::tie(mapping.get<T>()[id]...);
-}
+	// The entity component only provides the identifier and is never written.
+	using type = type_union_t<std::conditional_t<
+		std::is_const_v<T> || std::is_same_v<T, Entity>,
+		std::tuple<>, std::tuple<T>>...>;
+};
+
+template <typename T>
+using mutable_types_t = typename mutable_types<T>::type;
 
 template <typename iterate_types>
-struct EntityIterator
+struct EntityIterator;
+
+template <typename ... T>
+struct EntityIterator<std::tuple<T...>>
 {
-	EntityIterator(EntityMapping& mapping, std::vector<Entity> entities, int position)
-		: mapping(mapping), entities(entities), position(position) {}
-		
-	EntityIterator begin()
+	EntityIterator(EntityMapping& mapping, std::pmr::vector<uint64_t> entities, uint64_t tick)
+		: storages(&mapping.get<std::remove_const_t<T>>()...), entities(std::move(entities)), tick(tick) {}
+
+	struct iterator
 	{
-		return EntityIterator(mapping, entities, 0);
+		void operator++()
+		{
+			position++;
+		}
+
+		bool operator!=(const iterator& other) const
+		{
+			return position != other.position;
+		}
+
+		std::tuple<component_reference_t<T>...> operator*() const
+		{
+			uint64_t id = range->entities[position];
+			return {range->template access<T>(id)...};
+		}
+
+		const EntityIterator* range;
+		std::size_t position;
+	};
+
+	iterator begin() const
+	{
+		return {this, 0};
+	}
+
+	iterator end() const
+	{
+		return {this, entities.size()};
+	}
+
+	std::tuple<component_reference_t<T>...> operator[](std::size_t position) const
+	{
+		return *iterator{this, position};
 	}
 
-	EntityIterator end()
+	std::size_t size() const
 	{
-		return EntityIterator(mapping, entities, entities.size());
+		return entities.size();
 	}
 
-	void operator++()
+	/**
+	 * Gives the entities their own copies of shared mutable components.
+	 *
+	 * Writing to a shared component copies it, which changes the storage.
+	 * Parallel iteration copies them beforehand, so that threads only
+	 * write to values that they don't share.
+	 */
+	void unshare() const
 	{
-		position++;
+		(unshare_storage<T>(), ...);
 	}
-		
-	bool operator!=(const EntityIterator& other)
+
+private:
+	// Non-const access counts as a change of the component.
+	template <typename U>
+	component_reference_t<U> access(uint64_t id) const
 	{
-		return position != other.position;
+		auto storage = std::get<EntityStorage<std::remove_const_t<U>>*>(storages);
+		if constexpr (std::is_const_v<U> || std::is_same_v<U, Entity>) {
+			return (*storage)[id];
+		} else {
+			return storage->touch(id, tick);
+		}
 	}
 
-	auto operator*()
+	template <typename U>
+	void unshare_storage() const
 	{
-		int id = entities[position].value();
-		return get_component_reference_tuple(mapping, id,
-			std::type_identity<typename iterate_types::tuple>());
+		if constexpr (!std::is_const_v<U> && !std::is_same_v<U, Entity>) {
+			auto storage = std::get<EntityStorage<U>*>(storages);
+			if (storage->shared()) {
+				for (uint64_t id : entities) {
+					storage->unshare(id);
+				}
+			}
+		}
 	}
 
 private:
-	EntityMapping& mapping;
-	std::vector<Entity> entities;
-	int position;
+	// The storages are resolved once, not for every element.
+	std::tuple<EntityStorage<std::remove_const_t<T>>*...> storages;
+	std::pmr::vector<uint64_t> entities;
+	uint64_t tick;
 };
 
 template <typename T>
-bool remove_with_return(Entity entity)
+bool filter_changed(EntityMapping& mapping, std::pmr::vector<uint64_t>& entities, uint64_t last_run)
 {
-	ECS::remove<T>(entity);
+	EntityStorage<T>& storage = mapping.get<T>();
+	std::erase_if(entities, [&](uint64_t entity) {
+		return storage.changed_tick(entity) <= last_run;
+	});
 	return 0;
 }
 
-template <typename ... T>
-void remove_entity_tags(Entity entity, std::type_identity<std::tuple<T...>>)
+template <typename T>
+bool filter_added(EntityMapping& mapping, std::pmr::vector<uint64_t>& entities, uint64_t last_run)
+{
+	EntityStorage<T>& storage = mapping.get<T>();
+	std::erase_if(entities, [&](uint64_t entity) {
+		return storage.added_tick(entity) <= last_run;
+	});
+	return 0;
+}
+
+template <typename ... C, typename ... A>
+void filter_entities(EntityMapping& mapping, std::pmr::vector<uint64_t>& entities, uint64_t last_run,
+	std::type_identity<std::tuple<C...>>, std::type_identity<std::tuple<A...>>)
 {
-	(void) entity; // Case where sizeof...(T) == 0;
 	using expander = bool[];
-	(void) expander {0, remove_with_return<T>(entity)...};
+	(void) expander {0, filter_changed<C>(mapping, entities, last_run)...};
+	(void) expander {0, filter_added<A>(mapping, entities, last_run)...};
 }
 
+// Removes the entities whose components didn't change since the last run.
+template <typename Changed, typename Added>
+void filter_entities(EntityMapping& mapping, std::pmr::vector<uint64_t>& entities, uint64_t last_run)
+{
+	filter_entities(mapping, entities, last_run, std::type_identity<Changed>(), std::type_identity<Added>());
+}
+
+// The tags are changed one storage at a time, not one entity at a time.
 template <typename T>
-void remove_entity_tags(std::vector<Entity> entities)
+bool remove_with_return(EntityMapping& mapping, std::span<const uint64_t> entities)
 {
-	for (Entity entity : entities) {
-		remove_entity_tags(entity, std::type_identity<typename T::tuple>());
+	EntityStorage<T>& storage = mapping.get<T>();
+	for (uint64_t entity : entities) {
+		storage.remove(entity);
 	}
+	return 0;
+}
+
+template <typename ... T>
+void remove_entity_tags(EntityMapping& mapping, std::span<const uint64_t> entities, std::type_identity<std::tuple<T...>>)
+{
+	(void) mapping; // Case where sizeof...(T) == 0;
+	(void) entities;
+	using expander = bool[];
+	(void) expander {0, remove_with_return<T>(mapping, entities)...};
+}
+
+template <typename T>
+void remove_entity_tags(EntityMapping& mapping, std::span<const uint64_t> entities)
+{
+	remove_entity_tags(mapping, entities, std::type_identity<typename T::tuple>());
 }
 
 template <typename T>
-bool update_with_return(Entity entity)
+bool update_with_return(EntityMapping& mapping, std::span<const uint64_t> entities)
 {
-	ECS::update<T>(entity);
+	EntityStorage<T>& storage = mapping.get<T>();
+	for (uint64_t entity : entities) {
+		storage.update(entity, T{});
+	}
 	return 0;
 }
 
 template <typename ... T>
-void update_entity_tags(Entity entity, std::type_identity<std::tuple<T...>>)
+void update_entity_tags(EntityMapping& mapping, std::span<const uint64_t> entities, std::type_identity<std::tuple<T...>>)
 {
-	(void) entity; // Case where sizeof...(T) == 0;
+	(void) mapping; // Case where sizeof...(T) == 0;
+	(void) entities;
 	using expander = bool[];
-	(void) expander {0, update_with_return<T>(entity)...};
+	(void) expander {0, update_with_return<T>(mapping, entities)...};
 }
 
 template <typename T>
-void update_entity_tags(std::vector<Entity> entities)
+void update_entity_tags(EntityMapping& mapping, std::span<const uint64_t> entities)
 {
-	for (Entity entity : entities) {
-		update_entity_tags(entity, std::type_identity<typename T::tuple>());
-	}
+	update_entity_tags(mapping, entities, std::type_identity<typename T::tuple>());
 }
 
 }
@@ -1,6 +1,9 @@
 #pragma once
+#include "engine/nekolib/paged_array.h"
 #include <cstdint>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace kodanuki
@@ -12,9 +15,13 @@ namespace kodanuki
  * to positions in a dense vector. Copying the elements inside the vector
  * after each remove is avoided using swap-back removes. First swap the
  * element with the back element and then pop_back. To implement this in
- * O(1) we also keep the reverse map of the sparse map. The order of the
- * elements in the dense vector is effectively random. We implement parts
- * of the interface similar to the STL.
+ * O(1) we also keep the packed vector of keys parallel to the dense
+ * vector. The order of the elements in the dense vector is effectively
+ * random. We implement parts of the interface similar to the STL.
+ *
+ * Unsigned integer keys of up to 32 bits are used as indices into a
+ * paged sparse array, so each lookup is two array loads. Other keys
+ * use a hash map.
  */
 template <typename K, typename V>
 class DenseMap
@@ -26,7 +33,7 @@ public: // Modifiers
 	void clear() noexcept
 	{
 		sparse_forward.clear();
-		sparse_inverse.clear();
+		packed_keys.clear();
 		dense.clear();
 	}
 
@@ -36,16 +43,37 @@ public: // Modifiers
 	 * @param key The key of the element to insert.
 	 * @param value The new value of the element.
 	 */
-	void update(const K& key, V& value) noexcept
+	template <typename U>
+	void update(const K& key, U&& value)
 	{
 		if (contains(key)) {
-			at(key) = value;
+			at(key) = std::forward<U>(value);
 			return;
 		}
-		uint64_t pos = dense.size();
-		dense.push_back(value);
-		sparse_forward[key] = pos;
-		sparse_inverse[pos] = key;
+		dense.push_back(std::forward<U>(value));
+		sparse_forward[key] = dense.size() - 1;
+		packed_keys.push_back(key);
+	}
+
+	/**
+	 * Constructs the element in place or replaces the existing one.
+	 *
+	 * @param key The key of the element to insert.
+	 * @param args The arguments for the constructor of the element.
+	 * @return The reference to the element.
+	 */
+	template <typename ... Args>
+	V& emplace(const K& key, Args&& ... args)
+	{
+		if (contains(key)) {
+			V& value = at(key);
+			value = V(std::forward<Args>(args)...);
+			return value;
+		}
+		V& value = dense.emplace_back(std::forward<Args>(args)...);
+		sparse_forward[key] = dense.size() - 1;
+		packed_keys.push_back(key);
+		return value;
 	}
 
 	/**
@@ -58,14 +86,16 @@ public: // Modifiers
 		if (!contains(key)) {
 			return;
 		}
-		uint64_t key_pos = sparse_forward[key];
+		uint64_t key_pos = position(key);
 		uint64_t end_pos = dense.size() - 1;
-		dense[key_pos] = std::move(dense.back());
+		if (key_pos != end_pos) {
+			dense[key_pos] = std::move(dense.back());
+			packed_keys[key_pos] = packed_keys.back();
+			sparse_forward[packed_keys[key_pos]] = key_pos;
+		}
 		dense.pop_back();
-		sparse_forward[sparse_inverse[end_pos]] = key_pos;
-		sparse_forward.erase(key);
-		sparse_inverse[key_pos] = sparse_inverse[end_pos]; 
-		sparse_inverse.erase(end_pos);
+		packed_keys.pop_back();
+		erase_position(key);
 	}
 
 public: // Element access
@@ -78,7 +108,7 @@ public: // Element access
 	 */
 	V& at(const K& key)
 	{
-		return dense[sparse_forward[key]];
+		return dense[position(key)];
 	}
 
 	/**
@@ -90,7 +120,7 @@ public: // Element access
 	 */
 	const V& at(const K& key) const
 	{
-		return dense[sparse_forward[key]];
+		return dense[position(key)];
 	}
 
 	/**
@@ -125,7 +155,7 @@ public: // Element access
 	 */
 	std::size_t count(const K& key) const
 	{
-		return sparse_forward.count(key);
+		return contains(key);
 	}
 
 	/**
@@ -134,7 +164,7 @@ public: // Element access
 	 */
 	bool contains(const K& key) const
 	{
-		return sparse_forward.contains(key);
+		return position(key) != npos;
 	}
 
 	/**
@@ -143,9 +173,8 @@ public: // Element access
 	 */
 	std::vector<V>::iterator find(const K& key)
 	{
-		auto it = sparse_forward.find(key);
-		auto end = sparse_forward.end();
-		return it == end ? dense.begin() + *it : dense.end();
+		uint64_t pos = position(key);
+		return pos == npos ? dense.end() : dense.begin() + pos;
 	}
 
 	/**
@@ -154,9 +183,8 @@ public: // Element access
 	 */
 	std::vector<V>::const_iterator find(const K& key) const
 	{
-		auto it = sparse_forward.find(key);
-		auto end = sparse_forward.end();
-		return it == end ? dense.begin() + *it : dense.end();
+		uint64_t pos = position(key);
+		return pos == npos ? dense.end() : dense.begin() + pos;
 	}
 
 	/**
@@ -207,6 +235,14 @@ public: // Element access
 		return dense.data();
 	}
 
+	/**
+	 * @return The keys in the same order as the dense vector.
+	 */
+	const std::vector<K>& keys() const noexcept
+	{
+		return packed_keys;
+	}
+
 public: // Capacity
 	/**
 	 * Checks whether the container is empty.
@@ -215,7 +251,7 @@ public: // Capacity
 	 */
 	[[nodiscard]] bool empty() const noexcept
 	{
-		return sparse_forward.empty();
+		return dense.empty();
 	}
 
 	/**
@@ -225,7 +261,7 @@ public: // Capacity
 	 */
 	std::size_t size() const noexcept
 	{
-		return sparse_forward.empty();
+		return dense.size();
 	}
 
 	/**
@@ -235,7 +271,7 @@ public: // Capacity
 	 */
 	std::size_t max_size() const noexcept
 	{
-		return std::min(sparse_forward.max_size(), dense.max_size());
+		return std::min(packed_keys.max_size(), dense.max_size());
 	}
 
 public: // Iterators
@@ -336,8 +372,46 @@ public: // Iterators
 	}
 
 private:
-	std::unordered_map<K, uint64_t> sparse_forward;
-	std::unordered_map<uint64_t, K> sparse_inverse;
+	// The position of keys that are not inside the map.
+	static constexpr uint64_t npos = ~uint64_t(0);
+
+	// Small unsigned keys index the sparse pages directly.
+	static constexpr bool is_paged = std::is_unsigned_v<K> && sizeof(K) <= sizeof(uint32_t);
+
+	using SparseType = std::conditional_t<is_paged,
+		PagedArray<uint64_t>, std::unordered_map<K, uint64_t>>;
+
+	uint64_t position(const K& key) const
+	{
+		if constexpr (is_paged) {
+			return sparse_forward.get(key);
+		} else {
+			auto it = sparse_forward.find(key);
+			return it == sparse_forward.end() ? npos : it->second;
+		}
+	}
+
+	void erase_position(const K& key)
+	{
+		if constexpr (is_paged) {
+			sparse_forward[key] = npos;
+		} else {
+			sparse_forward.erase(key);
+		}
+	}
+
+	static SparseType make_sparse()
+	{
+		if constexpr (is_paged) {
+			return SparseType(npos);
+		} else {
+			return SparseType();
+		}
+	}
+
+private:
+	SparseType sparse_forward = make_sparse();
+	std::vector<K> packed_keys;
 	std::vector<V> dense;
 };
 
@@ -0,0 +1,188 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+namespace kodanuki
+{
+
+/**
+ * Implementation of a bitset with a summary hierarchy above the bits.
+ *
+ * The lowest level contains the bits themselves. Each higher level
+ * contains one bit per word of the level below, which is set iff that
+ * word is not zero. Iterating the set bits therefore skips 64 empty
+ * words with every zero bit of the level above. Testing a bit is a
+ * single word load and the memory overhead is less than 2%.
+ *
+ * The bitset grows on demand and covers indices below 2^36.
+ */
+class HierarchicalBitset
+{
+public:
+	/**
+	 * Returns true iff the bit is set.
+	 *
+	 * @param index The index of the bit.
+	 * @return Is the bit set?
+	 */
+	bool test(uint64_t index) const noexcept
+	{
+		uint64_t word = index / 64;
+		return word < levels[0].size() && (levels[0][word] >> (index % 64) & 1);
+	}
+
+	/**
+	 * Sets the bit and updates the summary levels.
+	 *
+	 * @param index The index of the bit.
+	 */
+	void set(uint64_t index)
+	{
+		if (test(index)) {
+			return;
+		}
+		bits++;
+		for (uint64_t level = 0; level < depth; level++) {
+			uint64_t word = index / 64;
+			if (word >= levels[level].size()) {
+				levels[level].resize(word + 1);
+			}
+			bool empty = levels[level][word] == 0;
+			levels[level][word] |= uint64_t(1) << (index % 64);
+			if (!empty) {
+				return;
+			}
+			index = word;
+		}
+	}
+
+	/**
+	 * Resets the bit and updates the summary levels.
+	 *
+	 * @param index The index of the bit.
+	 */
+	void reset(uint64_t index) noexcept
+	{
+		if (!test(index)) {
+			return;
+		}
+		bits--;
+		for (uint64_t level = 0; level < depth; level++) {
+			uint64_t word = index / 64;
+			levels[level][word] &= ~(uint64_t(1) << (index % 64));
+			if (levels[level][word] != 0) {
+				return;
+			}
+			index = word;
+		}
+	}
+
+	/**
+	 * Resets all bits.
+	 */
+	void clear() noexcept
+	{
+		for (std::vector<uint64_t>& level : levels) {
+			level.clear();
+		}
+		bits = 0;
+	}
+
+	/**
+	 * @return The number of set bits.
+	 */
+	uint64_t count() const noexcept
+	{
+		return bits;
+	}
+
+	/**
+	 * @return The number of bits that fit without growing.
+	 */
+	uint64_t capacity() const noexcept
+	{
+		return levels[0].size() * 64;
+	}
+
+	/**
+	 * @return The number of bytes used by the words of all levels.
+	 */
+	uint64_t bytes() const noexcept
+	{
+		uint64_t words = 0;
+		for (const std::vector<uint64_t>& level : levels) {
+			words += level.capacity();
+		}
+		return words * sizeof(uint64_t);
+	}
+
+	/**
+	 * Calls the function for each set bit in ascending order.
+	 *
+	 * @param function The function that is called with each index.
+	 */
+	template <typename Function>
+	void each(Function function) const
+	{
+		if (!levels[depth - 1].empty()) {
+			each(depth - 1, 0, function);
+		}
+	}
+
+	/**
+	 * Calls the function for each bit set inside both bitsets.
+	 *
+	 * The words of every level are combined with a bitwise AND, so
+	 * regions that are empty in either bitset are skipped.
+	 *
+	 * @param other The bitset that is intersected with this one.
+	 * @param function The function that is called with each index.
+	 */
+	template <typename Function>
+	void each_common(const HierarchicalBitset& other, Function function) const
+	{
+		if (!levels[depth - 1].empty() && !other.levels[depth - 1].empty()) {
+			each_common(other, depth - 1, 0, function);
+		}
+	}
+
+private:
+	template <typename Function>
+	void each(uint64_t level, uint64_t word, Function& function) const
+	{
+		for (uint64_t mask = levels[level][word]; mask; mask &= mask - 1) {
+			uint64_t index = word * 64 + std::countr_zero(mask);
+			if (level == 0) {
+				function(index);
+			} else {
+				each(level - 1, index, function);
+			}
+		}
+	}
+
+	template <typename Function>
+	void each_common(const HierarchicalBitset& other, uint64_t level, uint64_t word, Function& function) const
+	{
+		uint64_t mask = levels[level][word] & other.levels[level][word];
+		for (; mask; mask &= mask - 1) {
+			uint64_t index = word * 64 + std::countr_zero(mask);
+			if (level == 0) {
+				function(index);
+			} else {
+				each_common(other, level - 1, index, function);
+			}
+		}
+	}
+
+private:
+	// The number of levels, enough for 36-bit indices.
+	static constexpr uint64_t depth = 6;
+
+private:
+	std::array<std::vector<uint64_t>, depth> levels;
+	uint64_t bits = 0;
+};
+
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace kodanuki
+{
+
+/**
+ * Implementation of a sparse array which is split into fixed-size pages.
+ *
+ * Pages are only allocated when an element inside them is written, so
+ * large but sparse indices cost one pointer per untouched page. Reading
+ * an element is two array loads: the page pointer and the element. The
+ * elements of unallocated pages read as the empty value given on
+ * construction. Pages are never moved, so element references stay valid
+ * until the array is cleared.
+ *
+ * @param T The type of the elements.
+ * @param page_size The number of elements per page (power of two).
+ */
+template <typename T, uint64_t page_size = 4096>
+class PagedArray
+{
+	static_assert(std::has_single_bit(page_size));
+
+public:
+	/**
+	 * Creates an array without any pages.
+	 *
+	 * @param empty The value of the elements that were never written.
+	 */
+	PagedArray(T empty = {}) : empty(empty) {}
+
+	PagedArray(const PagedArray& other) : empty(other.empty)
+	{
+		pages.resize(other.pages.size());
+		for (uint64_t i = 0; i < pages.size(); i++) {
+			if (other.pages[i]) {
+				pages[i] = std::make_unique<T[]>(page_size);
+				std::copy_n(other.pages[i].get(), page_size, pages[i].get());
+			}
+		}
+	}
+
+	PagedArray& operator=(const PagedArray& other)
+	{
+		PagedArray copy(other);
+		std::swap(pages, copy.pages);
+		std::swap(empty, copy.empty);
+		return *this;
+	}
+
+	PagedArray(PagedArray&&) noexcept = default;
+	PagedArray& operator=(PagedArray&&) noexcept = default;
+
+public: // Modifiers
+	/**
+	 * Removes all pages.
+	 */
+	void clear() noexcept
+	{
+		pages.clear();
+	}
+
+public: // Element access
+	/**
+	 * Returns the element and allocates its page if necessary.
+	 *
+	 * @param index The index of the element.
+	 * @return The reference to the element.
+	 */
+	T& operator[](uint64_t index)
+	{
+		uint64_t page = index / page_size;
+		if (page >= pages.size()) {
+			pages.resize(page + 1);
+		}
+		if (!pages[page]) {
+			pages[page] = std::make_unique<T[]>(page_size);
+			std::fill_n(pages[page].get(), page_size, empty);
+		}
+		return pages[page][index % page_size];
+	}
+
+	/**
+	 * Returns the element without allocating any pages.
+	 *
+	 * @param index The index of the element.
+	 * @return The pointer to the element or nullptr if the page is missing.
+	 */
+	T* find(uint64_t index) noexcept
+	{
+		uint64_t page = index / page_size;
+		if (page >= pages.size() || !pages[page]) {
+			return nullptr;
+		}
+		return &pages[page][index % page_size];
+	}
+
+	/**
+	 * Returns the element without allocating any pages.
+	 *
+	 * @param index The index of the element.
+	 * @return The pointer to the element or nullptr if the page is missing.
+	 */
+	const T* find(uint64_t index) const noexcept
+	{
+		uint64_t page = index / page_size;
+		if (page >= pages.size() || !pages[page]) {
+			return nullptr;
+		}
+		return &pages[page][index % page_size];
+	}
+
+	/**
+	 * Returns a copy of the element without allocating any pages.
+	 *
+	 * @param index The index of the element.
+	 * @return The element or the empty value if the page is missing.
+	 */
+	T get(uint64_t index) const noexcept
+	{
+		const T* element = find(index);
+		return element ? *element : empty;
+	}
+
+public: // Capacity
+	/**
+	 * @return The number of page slots, allocated or not.
+	 */
+	uint64_t page_count() const noexcept
+	{
+		return pages.size();
+	}
+
+	/**
+	 * @return The number of elements inside the allocated pages.
+	 */
+	uint64_t capacity() const noexcept
+	{
+		return page_size * std::count_if(pages.begin(), pages.end(),
+			[](const auto& page) { return page != nullptr; });
+	}
+
+private:
+	std::vector<std::unique_ptr<T[]>> pages;
+	T empty;
+};
+
+}
@@ -1,7 +1,11 @@
 #include <doctest/doctest.h>
 #include <bits/stdc++.h>
+#include "engine/central/archetype.h"
 #include "engine/central/entity.h"
 #include "engine/central/family.h"
+#include "engine/central/scheduler.h"
+#include "engine/central/snapshot.h"
+#include "engine/central/stats.h"
 using namespace kodanuki;
 
 struct A {};
@@ -38,4 +42,572 @@ TEST_CASE("example usage")
 
         ECS::remove<Entity>(root);
     }
-}
\ No newline at end of file
+}
+struct D { int value; };
+struct E { int value; };
+
+TEST_CASE("bulk creation")
+{
+    constexpr int count = 1000000;
+    std::vector<D> values(count, {1});
+
+    // Grow the storages beforehand, so that both variants reuse memory.
+    for (Entity entity : ECS::create_many(count)) {
+        ECS::update<D>(entity, {0});
+        ECS::remove<Entity>(entity);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Entity> single;
+    single.reserve(count);
+    for (int i = 0; i < count; i++) {
+        Entity entity = ECS::create();
+        ECS::update<D>(entity, values[i]);
+        single.push_back(entity);
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double elapsed_single = std::chrono::duration<double, std::milli>(stop - start).count();
+    for (Entity entity : single) {
+        ECS::remove<Entity>(entity);
+    }
+
+    start = std::chrono::steady_clock::now();
+    std::vector<Entity> bulk = ECS::create_many(count);
+    ECS::update_many<D>(bulk, values);
+    stop = std::chrono::steady_clock::now();
+    double elapsed_bulk = std::chrono::duration<double, std::milli>(stop - start).count();
+    CHECK(ECS::get<D>(bulk.back()).value == 1);
+    CHECK(elapsed_bulk < elapsed_single);
+    for (Entity entity : bulk) {
+        ECS::remove<Entity>(entity);
+    }
+
+    MESSAGE("create + update:           " << elapsed_single << " ms per million entities");
+    MESSAGE("create_many + update_many: " << elapsed_bulk << " ms per million entities");
+}
+
+TEST_CASE("archetype iteration")
+{
+    constexpr int count = 100000;
+    constexpr int rounds = 20;
+    using System = Archetype<Iterate<Entity, A, B, D, E>>;
+
+    std::vector<Entity> entities;
+    for (int i = 0; i < count; i++) {
+        Entity entity = ECS::create();
+        ECS::update<A>(entity);
+        ECS::update<B>(entity);
+        ECS::update<D>(entity, {i});
+        ECS::update<E>(entity, {0});
+        entities.push_back(entity);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (auto[entity, a, b, d, e] : ECS::iterate<System>()) {
+            e.value += d.value;
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double, std::nano>(stop - start).count();
+    MESSAGE("iteration over five components: " << elapsed / (count * rounds) << " ns per entity");
+
+    CHECK(ECS::get<E>(entities.back()).value == rounds * (count - 1));
+    for (Entity entity : entities) {
+        ECS::remove<Entity>(entity);
+    }
+}
+
+TEST_CASE("component access")
+{
+    constexpr int count = 100000;
+    constexpr int rounds = 20;
+
+    std::vector<Entity> entities;
+    for (int i = 0; i < count; i++) {
+        Entity entity = ECS::create();
+        ECS::update<D>(entity, {i});
+        entities.push_back(entity);
+    }
+    std::shuffle(entities.begin(), entities.end(), std::mt19937(42));
+
+    long sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (Entity entity : entities) {
+            if (ECS::has<D>(entity)) {
+                sum += ECS::get<D>(entity).value;
+            }
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double, std::nano>(stop - start).count();
+    MESSAGE("ECS::has + ECS::get: " << elapsed / (count * rounds) << " ns per entity");
+
+    CHECK(sum == long(rounds) * count * (count - 1) / 2);
+    for (Entity entity : entities) {
+        ECS::remove<Entity>(entity);
+    }
+}
+
+TEST_CASE("signature matching")
+{
+    constexpr int count = 100000;
+    constexpr int rounds = 20;
+    struct F {};
+    using System = Archetype<Iterate<D, E>, Require<A, B>, Exclude<F>>;
+
+    ECS::World world;
+    std::vector<Entity> entities = world.create_many(count);
+    for (int i = 0; i < count; i++) {
+        world.update<A>(entities[i]);
+        world.update<B>(entities[i]);
+        world.update<D>(entities[i], {i});
+        world.update<E>(entities[i], {0});
+    }
+    std::shuffle(entities.begin(), entities.end(), std::mt19937(42));
+
+    int matches = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (Entity entity : entities) {
+            matches += world.has<A, B, D, E>(entity);
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double elapsed_has = std::chrono::duration<double, std::nano>(stop - start).count();
+
+    // Each toggle of the excluded tag reevaluates the key inside the query.
+    world.prepare<System>();
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (Entity entity : entities) {
+            world.update<F>(entity);
+        }
+        for (Entity entity : entities) {
+            world.remove<F>(entity);
+        }
+    }
+    stop = std::chrono::steady_clock::now();
+    double elapsed_toggle = std::chrono::duration<double, std::nano>(stop - start).count();
+    CHECK(matches == count * rounds);
+    CHECK(world.iterate<System>().size() == count);
+
+    MESSAGE("ECS::has over four components: " << elapsed_has / (count * rounds) << " ns per entity");
+    MESSAGE("query update on tag toggle: " << elapsed_toggle / (2 * count * rounds) << " ns per change");
+}
+
+TEST_CASE("hierarchy propagation")
+{
+    constexpr int count = 100000;
+    constexpr int rounds = 20;
+
+    std::mt19937 random(42);
+    Entity root = ECS::create();
+    ECS::update<D>(root, {1});
+    std::vector<Entity> nodes = {root};
+    for (int i = 1; i < count; i++) {
+        Entity parent = nodes[random() % nodes.size()];
+        Entity node = ECS::create(parent);
+        ECS::update<D>(node, {1});
+        nodes.push_back(node);
+    }
+
+    // Each world value is the sum of the local values up to the root.
+    const Hierarchy& hierarchy = ECS::hierarchy();
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (uint64_t key : hierarchy.ordered()) {
+            uint64_t parent = hierarchy.parent(key);
+            int base = parent == null_handle ? 0 : ECS::get<const E>(parent).value;
+            ECS::update<E>(key, {base + ECS::get<const D>(key).value});
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double, std::nano>(stop - start).count();
+    MESSAGE("hierarchy propagation: " << elapsed / (count * rounds) << " ns per node");
+
+    for (Entity node : nodes) {
+        const Family& family = ECS::get<const Family>(node);
+        CHECK(ECS::get<E>(node).value == int(family.get_depth()) + 1);
+        CHECK(family.get_root() == root);
+    }
+    ECS::remove<Entity>(root);
+    CHECK(hierarchy.size() == 0);
+}
+
+TEST_CASE("subtree destruction")
+{
+    constexpr int children = 100;
+    constexpr int grandchildren = 100;
+
+    auto build = [&]() {
+        std::vector<Entity> nodes = {ECS::create()};
+        for (int i = 0; i < children; i++) {
+            Entity child = ECS::create(nodes.front());
+            ECS::update<A>(child);
+            ECS::update<D>(child, {i});
+            nodes.push_back(child);
+            for (int j = 0; j < grandchildren; j++) {
+                Entity grandchild = ECS::create(child);
+                ECS::update<C>(grandchild);
+                ECS::update<E>(grandchild, {j});
+                nodes.push_back(grandchild);
+            }
+        }
+        return nodes;
+    };
+
+    // Removing the leaves one by one notifies the listeners for each entity.
+    std::vector<Entity> nodes = build();
+    auto start = std::chrono::steady_clock::now();
+    for (auto node = nodes.rbegin(); node != nodes.rend(); node++) {
+        ECS::remove<Entity>(*node);
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double elapsed_single = std::chrono::duration<double, std::milli>(stop - start).count();
+
+    nodes = build();
+    start = std::chrono::steady_clock::now();
+    ECS::remove<Entity>(nodes.front());
+    stop = std::chrono::steady_clock::now();
+    double elapsed_subtree = std::chrono::duration<double, std::milli>(stop - start).count();
+    for (Entity node : nodes) {
+        CHECK(!ECS::alive(node));
+    }
+
+    MESSAGE("remove each entity: " << elapsed_single << " ms per 10k entities");
+    MESSAGE("remove the root:    " << elapsed_subtree << " ms per 10k entities");
+}
+
+TEST_CASE("bulk removal")
+{
+    constexpr int count = 100000;
+    constexpr int removed = 20000;
+    constexpr int rounds = 5;
+
+    // The mapping holds three storages and a query listening to them.
+    auto populate = [](EntityMapping& mapping) {
+        mapping.query<std::tuple<D, E>, std::tuple<A>>();
+        std::vector<uint64_t> keys;
+        for (int i = 0; i < count; i++) {
+            uint64_t key = make_handle(i, 0);
+            mapping.get<D>().update(key, {i});
+            mapping.get<E>().update(key, {i});
+            if (i % 2 == 0) {
+                mapping.get<A>().update(key, {});
+            }
+            keys.push_back(key);
+        }
+        std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+        keys.resize(removed);
+        return keys;
+    };
+
+    double elapsed_single = std::numeric_limits<double>::max();
+    double elapsed_bulk = std::numeric_limits<double>::max();
+    for (int round = 0; round < rounds; round++) {
+        EntityMapping single;
+        std::vector<uint64_t> keys = populate(single);
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t key : keys) {
+            single.remove(key);
+        }
+        auto stop = std::chrono::steady_clock::now();
+        elapsed_single = std::min(elapsed_single, std::chrono::duration<double, std::milli>(stop - start).count());
+
+        EntityMapping bulk;
+        keys = populate(bulk);
+        start = std::chrono::steady_clock::now();
+        bulk.remove_many(keys);
+        stop = std::chrono::steady_clock::now();
+        elapsed_bulk = std::min(elapsed_bulk, std::chrono::duration<double, std::milli>(stop - start).count());
+        CHECK(bulk.get<D>().size() == single.get<D>().size());
+    }
+    CHECK(elapsed_bulk < elapsed_single);
+
+    MESSAGE("remove each key:     " << elapsed_single << " ms per 20k keys");
+    MESSAGE("remove keys in bulk: " << elapsed_bulk << " ms per 20k keys");
+}
+
+TEST_CASE("world snapshot")
+{
+    constexpr int count = 1000000;
+
+    ECS::World world;
+    std::vector<Entity> entities = world.create_many(count);
+    world.update_many<D>(entities, std::vector<D>(count, {1}));
+    world.update_many<A>(entities);
+
+    auto start = std::chrono::steady_clock::now();
+    SnapshotWriter writer;
+    world.save(writer);
+    auto stop = std::chrono::steady_clock::now();
+    double elapsed_save = std::chrono::duration<double, std::milli>(stop - start).count();
+
+    start = std::chrono::steady_clock::now();
+    ECS::World copy;
+    SnapshotReader reader(writer.data());
+    copy.load(reader);
+    stop = std::chrono::steady_clock::now();
+    double elapsed_load = std::chrono::duration<double, std::milli>(stop - start).count();
+    CHECK(copy.get<D>(entities.back()).value == 1);
+    CHECK(copy.has<A>(entities.back()));
+
+    MESSAGE("snapshot save: " << elapsed_save << " ms per million entities");
+    MESSAGE("snapshot load: " << elapsed_load << " ms per million entities");
+}
+
+TEST_CASE("rollback checkpoint")
+{
+    constexpr int count = 100000;
+    constexpr int ticks = 60;
+
+    ECS::World world;
+    std::vector<Entity> entities = world.create_many(count);
+    world.update_many<D>(entities, std::vector<D>(count, {0}));
+    world.update_many<E>(entities, std::vector<E>(count, {0}));
+    std::vector<Checkpoint> checkpoints = {world.checkpoint()};
+
+    // Each tick writes one percent of the entities spread over the world.
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> pick(0, count - 1);
+    double elapsed_checkpoint = 0;
+    for (int tick = 1; tick <= ticks; tick++) {
+        for (int i = 0; i < count / 100; i++) {
+            world.get<D>(entities[pick(random)]).value = tick;
+        }
+        auto start = std::chrono::steady_clock::now();
+        checkpoints.push_back(world.checkpoint());
+        auto stop = std::chrono::steady_clock::now();
+        elapsed_checkpoint += std::chrono::duration<double, std::micro>(stop - start).count();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    world.rollback(checkpoints[ticks / 2]);
+    auto stop = std::chrono::steady_clock::now();
+    double elapsed_rollback = std::chrono::duration<double, std::micro>(stop - start).count();
+    CHECK(world.get<E>(entities.back()).value == 0);
+
+    MESSAGE("rollback checkpoint: " << elapsed_checkpoint / ticks << " us per tick for 100k entities");
+    MESSAGE("rollback restore: " << elapsed_rollback << " us for " << ticks / 2 << " ticks");
+}
+
+TEST_CASE("prefab sharing")
+{
+    constexpr int count = 100000;
+    struct Mesh { std::array<float, 64> vertices; };
+
+    ECS::World world;
+    Entity prefab = world.create();
+    world.update<Mesh>(prefab, {});
+    std::vector<Entity> entities = world.create_many(count);
+
+    auto start = std::chrono::steady_clock::now();
+    for (Entity entity : entities) {
+        world.share<Mesh>(entity, prefab);
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double elapsed_share = std::chrono::duration<double, std::nano>(stop - start).count() / count;
+
+    // Writing one percent of the instances copies only their meshes.
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i += 100) {
+        world.get<Mesh>(entities[i]).vertices[0] = 1;
+    }
+    stop = std::chrono::steady_clock::now();
+    double elapsed_write = std::chrono::duration<double, std::nano>(stop - start).count() / (count / 100);
+    CHECK(world.get<const Mesh>(entities[1]).vertices[0] == 0);
+
+    std::unordered_set<const Mesh*> meshes;
+    for (Entity entity : entities) {
+        meshes.insert(&world.get<const Mesh>(entity));
+    }
+    CHECK(meshes.size() == count / 100 + 1);
+
+    MESSAGE("prefab share: " << elapsed_share << " ns per entity, "
+        << meshes.size() * sizeof(Mesh) / 1024 << " KiB of meshes for " << count << " entities");
+    MESSAGE("prefab copy on write: " << elapsed_write << " ns per entity");
+}
+
+TEST_CASE("group iteration")
+{
+    constexpr int count = 100000;
+    constexpr int rounds = 20;
+    struct Velocity { int value; };
+    struct Place { int value; };
+    using Plain = Archetype<Iterate<Place, const Velocity>>;
+    using Grouped = Archetype<Own<Place, const Velocity>>;
+
+    // Every third entity has both components, the others only one of them.
+    auto populate = [](ECS::World& world) {
+        std::vector<Entity> entities = world.create_many(count);
+        for (int i = 0; i < count; i++) {
+            world.update<Place>(entities[i], {0});
+            if (i % 3 == 0) {
+                world.update<Velocity>(entities[i], {1});
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            if (i % 3 == 1) {
+                world.update<Velocity>(entities[i], {0});
+                world.remove<Place>(entities[i]);
+            }
+        }
+        return entities;
+    };
+
+    auto measure = [](ECS::World& world, auto system) {
+        using System = decltype(system);
+        world.prepare<System>();
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; round++) {
+            for (auto[place, velocity] : world.iterate<System>()) {
+                place.value += velocity.value;
+            }
+        }
+        auto stop = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(stop - start).count() / (count / 3 * rounds);
+    };
+
+    ECS::World plain;
+    ECS::World grouped;
+    std::vector<Entity> plain_entities = populate(plain);
+    std::vector<Entity> grouped_entities = populate(grouped);
+    double elapsed_plain = measure(plain, Plain{});
+    double elapsed_grouped = measure(grouped, Grouped{});
+
+    // The columns are plain arrays, so the loop can be vectorized.
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        auto[places, velocities] = grouped.columns<Grouped>();
+        for (std::size_t i = 0; i < places.size(); i++) {
+            places[i].value += velocities[i].value;
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double elapsed_columns = std::chrono::duration<double, std::nano>(stop - start).count() / (count / 3 * rounds);
+    CHECK(plain.get<Place>(plain_entities.front()).value == rounds);
+    CHECK(grouped.get<Place>(grouped_entities.front()).value == 2 * rounds);
+
+    MESSAGE("plain iteration over two components: " << elapsed_plain << " ns per entity");
+    MESSAGE("group iteration over two components: " << elapsed_grouped << " ns per entity");
+    MESSAGE("column loop over two components: " << elapsed_columns << " ns per entity");
+}
+
+struct Body { float x; float y; float vx; float vy; float mass; float charge; };
+struct Particle { float x; float y; float vx; float vy; float mass; float charge; };
+
+template <>
+struct kodanuki::component_fields<Particle>
+{
+    static constexpr auto members = std::tuple(&Particle::x, &Particle::y,
+        &Particle::vx, &Particle::vy, &Particle::mass, &Particle::charge);
+};
+
+TEST_CASE("split particle integration")
+{
+    constexpr int count = 100000;
+    constexpr int rounds = 20;
+    constexpr float delta = 0.01f;
+    using Dense = Archetype<Own<Body>>;
+    using Split = Archetype<Own<Particle>>;
+
+    ECS::World world;
+    std::vector<Entity> entities = world.create_many(count);
+    for (int i = 0; i < count; i++) {
+        world.update<Body>(entities[i], {0, 0, 1, 2, 1, 0});
+        world.update<Particle>(entities[i], {0, 0, 1, 2, 1, 0});
+    }
+    world.prepare<Dense>();
+    world.prepare<Split>();
+
+    // The whole struct is loaded although only four of its fields are used.
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        auto[bodies] = world.columns<Dense>();
+        for (std::size_t i = 0; i < bodies.size(); i++) {
+            bodies[i].x += bodies[i].vx * delta;
+            bodies[i].y += bodies[i].vy * delta;
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double elapsed_dense = std::chrono::duration<double, std::nano>(stop - start).count() / (count * rounds);
+
+    // Each field is a contiguous array, so only the used fields are loaded.
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        auto[particles] = world.columns<Split>();
+        std::span<float> x = particles.field<&Particle::x>();
+        std::span<float> y = particles.field<&Particle::y>();
+        std::span<float> vx = particles.field<&Particle::vx>();
+        std::span<float> vy = particles.field<&Particle::vy>();
+        for (std::size_t i = 0; i < x.size(); i++) {
+            x[i] += vx[i] * delta;
+            y[i] += vy[i] * delta;
+        }
+    }
+    stop = std::chrono::steady_clock::now();
+    double elapsed_split = std::chrono::duration<double, std::nano>(stop - start).count() / (count * rounds);
+    Body body = world.get<Body>(entities.front());
+    Particle particle = world.get<Particle>(entities.front());
+    CHECK(particle.x == body.x);
+    CHECK(particle.y == body.y);
+    // Split columns stamp their change ticks per chunk, not per value.
+    CHECK(elapsed_split < elapsed_dense);
+
+    MESSAGE("dense struct integration: " << elapsed_dense << " ns per entity");
+    MESSAGE("split field integration: " << elapsed_split << " ns per entity");
+}
+
+TEST_CASE("statistics dump")
+{
+    constexpr int count = 100000;
+    constexpr int frames = 20;
+    struct Velocity { int value; };
+    struct Place { int value; };
+    struct Sleeping {};
+    using MoveSystem = Archetype<Iterate<Place, const Velocity>, Exclude<Sleeping>>;
+    using WakeSystem = Archetype<Iterate<Entity>, Consume<Sleeping>>;
+
+    ECS::World world;
+    std::vector<Entity> entities = world.create_many(count);
+    for (int i = 0; i < count; i++) {
+        world.update<Place>(entities[i], {0});
+        world.update<Velocity>(entities[i], {1});
+    }
+    Scheduler scheduler(world);
+    scheduler.add<MoveSystem>([&] {
+        for (auto[place, velocity] : world.iterate<MoveSystem>()) {
+            place.value += velocity.value;
+        }
+    });
+    scheduler.add<WakeSystem>([&] { world.iterate<WakeSystem>(); });
+
+    // Every frame a tenth of the entities falls asleep for one frame.
+    for (int frame = 0; frame < frames; frame++) {
+        world.reset_statistics();
+        scheduler.reset_statistics();
+        for (int i = frame % 10; i < count; i += 10) {
+            world.update<Sleeping>(entities[i]);
+        }
+        scheduler.run();
+    }
+
+    // The statistics of the last frame are written next to the binary.
+    Statistics statistics = world.statistics();
+    statistics.systems = scheduler.statistics();
+    std::ofstream file("perftest-statistics.json");
+    write_json(file, statistics);
+    CHECK(file.good());
+    CHECK(statistics.systems[0].runs == 1);
+
+    for (const QueryStats& query : statistics.queries) {
+        MESSAGE(query.name << ": " << query.matches << " matches, "
+            << query.search_nanoseconds << " ns searching, "
+            << query.inserted + query.removed << " structural changes");
+    }
+    for (const SystemStats& system : statistics.systems) {
+        MESSAGE(system.name << ": " << system.nanoseconds << " ns");
+    }
+}
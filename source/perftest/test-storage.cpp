@@ -0,0 +1,185 @@
+#include <doctest/doctest.h>
+#include <bits/stdc++.h>
+#include "engine/central/handle.h"
+#include "engine/central/storage.h"
+#include "engine/nekolib/dense_map.h"
+using namespace kodanuki;
+
+/**
+ * The hashed layout of the entity storage before the paged backend.
+ *
+ * Two hash maps bind the keys to stable ids and two more hash maps inside
+ * the old dense map translate the ids into dense positions.
+ */
+template <typename T>
+struct HashedStorage
+{
+	void insert(uint64_t key, T value)
+	{
+		bindings[key] = ++sid;
+		bindings_count[sid] = 1;
+		sparse_forward[sid] = dense.size();
+		sparse_inverse[dense.size()] = sid;
+		dense.push_back(value);
+	}
+
+	T& operator[](uint64_t key)
+	{
+		return dense[sparse_forward[bindings[key]]];
+	}
+
+	uint64_t sid = 0;
+	std::unordered_map<uint64_t, uint64_t> bindings;
+	std::unordered_map<uint64_t, uint64_t> bindings_count;
+	std::unordered_map<uint64_t, uint64_t> sparse_forward;
+	std::unordered_map<uint64_t, uint64_t> sparse_inverse;
+	std::vector<T> dense;
+};
+
+struct Payload
+{
+	float x;
+	float y;
+	float z;
+};
+
+// Returns the nanoseconds per call of the given function.
+template <typename Function>
+double measure(uint64_t calls, Function function)
+{
+	auto start = std::chrono::steady_clock::now();
+	function();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(stop - start).count() / calls;
+}
+
+TEST_CASE("entity storage lookup benchmark")
+{
+	constexpr uint64_t count = 200000;
+	constexpr uint64_t rounds = 10;
+
+	std::vector<uint64_t> keys;
+	HandleAllocator handles;
+	for (uint64_t i = 0; i < count; i++) {
+		keys.push_back(handles.create());
+	}
+	std::vector<uint64_t> order = keys;
+	std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+	HashedStorage<Payload> hashed;
+	EntityStorage<Payload> paged;
+
+	double hashed_insert = measure(count, [&]{
+		for (uint64_t key : keys) {
+			hashed.insert(key, {1.0f, 2.0f, 3.0f});
+		}
+	});
+	double paged_insert = measure(count, [&]{
+		for (uint64_t key : keys) {
+			paged.update(key, {1.0f, 2.0f, 3.0f});
+		}
+	});
+
+	float hashed_sum = 0.0f;
+	float paged_sum = 0.0f;
+	double hashed_lookup = measure(count * rounds, [&]{
+		for (uint64_t round = 0; round < rounds; round++) {
+			for (uint64_t key : order) {
+				hashed_sum += hashed[key].y;
+			}
+		}
+	});
+	double paged_lookup = measure(count * rounds, [&]{
+		for (uint64_t round = 0; round < rounds; round++) {
+			for (uint64_t key : order) {
+				paged_sum += paged[key].y;
+			}
+		}
+	});
+
+	CHECK(hashed_sum == paged_sum);
+	MESSAGE("hashed storage insert: " << hashed_insert << " ns, lookup: " << hashed_lookup << " ns");
+	MESSAGE("paged storage insert:  " << paged_insert << " ns, lookup: " << paged_lookup << " ns");
+}
+
+TEST_CASE("dense map lookup benchmark")
+{
+	constexpr uint32_t count = 200000;
+	constexpr uint32_t rounds = 10;
+
+	std::vector<uint32_t> order(count);
+	std::iota(order.begin(), order.end(), 0);
+	std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+	std::unordered_map<uint32_t, Payload> hashed;
+	DenseMap<uint32_t, Payload> paged;
+	for (uint32_t key = 0; key < count; key++) {
+		Payload payload = {1.0f, 2.0f, 3.0f};
+		hashed[key] = payload;
+		paged.update(key, payload);
+	}
+
+	float hashed_sum = 0.0f;
+	float paged_sum = 0.0f;
+	double hashed_lookup = measure(count * rounds, [&]{
+		for (uint32_t round = 0; round < rounds; round++) {
+			for (uint32_t key : order) {
+				hashed_sum += hashed[key].z;
+			}
+		}
+	});
+	double paged_lookup = measure(count * rounds, [&]{
+		for (uint32_t round = 0; round < rounds; round++) {
+			for (uint32_t key : order) {
+				paged_sum += paged[key].z;
+			}
+		}
+	});
+
+	CHECK(hashed_sum == paged_sum);
+	MESSAGE("unordered_map lookup: " << hashed_lookup << " ns");
+	MESSAGE("dense map lookup:     " << paged_lookup << " ns");
+}
+
+TEST_CASE("tag storage lookup benchmark")
+{
+	constexpr uint64_t count = 200000;
+	constexpr uint64_t rounds = 10;
+	struct Flag {};
+
+	std::vector<uint64_t> keys;
+	HandleAllocator handles;
+	for (uint64_t i = 0; i < count; i++) {
+		keys.push_back(handles.create());
+	}
+	std::vector<uint64_t> order = keys;
+	std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+	EntityStorage<Flag, DensePolicy> dense;
+	EntityStorage<Flag, TagPolicy> tags;
+	for (uint64_t i = 0; i < count; i += 2) {
+		dense.update(keys[i], {});
+		tags.update(keys[i], {});
+	}
+
+	uint64_t dense_hits = 0;
+	uint64_t tag_hits = 0;
+	double dense_lookup = measure(count * rounds, [&]{
+		for (uint64_t round = 0; round < rounds; round++) {
+			for (uint64_t key : order) {
+				dense_hits += dense.contains(key);
+			}
+		}
+	});
+	double tag_lookup = measure(count * rounds, [&]{
+		for (uint64_t round = 0; round < rounds; round++) {
+			for (uint64_t key : order) {
+				tag_hits += tags.contains(key);
+			}
+		}
+	});
+
+	CHECK(dense_hits == tag_hits);
+	MESSAGE("dense tag contains:  " << dense_lookup << " ns");
+	MESSAGE("bitset tag contains: " << tag_lookup << " ns");
+}
@@ -6,12 +6,39 @@ int& Board::operator() (int x, int y)
 	return *(isblock.begin() + y * sizeX + x); 
 }
 
-bool is_block_inside_board(Board board, int x, int y)
+int Board::operator() (int x, int y) const
+{
+	return isblock[y * sizeX + x];
+}
+
+void kodanuki::Serializer<Board>::save(SnapshotWriter& writer, const Board& board)
+{
+	writer.write(board.offsetX);
+	writer.write(board.offsetY);
+	writer.write(board.sizeX);
+	writer.write(board.sizeY);
+	writer.write_array<int>(board.isblock);
+	writer.write(board.playable);
+}
+
+Board kodanuki::Serializer<Board>::load(SnapshotReader& reader)
+{
+	Board board;
+	board.offsetX = reader.read<int>();
+	board.offsetY = reader.read<int>();
+	board.sizeX = reader.read<int>();
+	board.sizeY = reader.read<int>();
+	reader.read_array(board.isblock);
+	board.playable = reader.read<bool>();
+	return board;
+}
+
+bool is_block_inside_board(const Board& board, int x, int y)
 {
 	return x >= 0 && y < board.sizeY && x < board.sizeX;
 }
 
-bool is_valid_position(Board board, Tetromino tetromino, int x, int y)
+bool is_valid_position(const Board& board, const Tetromino& tetromino, int x, int y)
 {
 	bool invalid = false;
 	execute_blockwise(tetromino, [&](int blockX, int blockY){
@@ -24,7 +51,7 @@ bool is_valid_position(Board board, Tetromino tetromino, int x, int y)
 	return !invalid;
 }
 
-void fixate_tetromino(Board& board, Tetromino tetromino, int color, int x, int y)
+void fixate_tetromino(Board& board, const Tetromino& tetromino, int color, int x, int y)
 {
 	execute_blockwise(tetromino, [&](int blockX, int blockY) {
 		int boardX = x + blockX;
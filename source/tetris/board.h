@@ -1,6 +1,7 @@
 #pragma once
 #include "tetromino.h"
-#include <vector>
+#include "engine/central/snapshot.h"
+#include <memory_resource>
 
 /**
  * Each board contains several blocks represented as a boolean value.
@@ -24,13 +25,27 @@ struct Board
 	int sizeY;
 
 	// The array to check wether a block is at the position.
-	std::vector<int> isblock;
+	// It is allocated from the pool of the board storage.
+	std::pmr::vector<int> isblock;
 
 	// Is the board already lost?
 	bool playable;
 
 	// The element at position y * sizeX + x.
 	int& operator() (int x, int y);
+	// The element at position y * sizeX + x.
+	int operator() (int x, int y) const;
+};
+
+/**
+ * Writes the board into snapshots, the blocks are stored as one array.
+ */
+template <>
+struct kodanuki::Serializer<Board>
+{
+	static constexpr bool enabled = true;
+	static void save(SnapshotWriter& writer, const Board& board);
+	static Board load(SnapshotReader& reader);
 };
 
 /**
@@ -41,7 +56,7 @@ struct Board
  * @param y The y position of the block to check.
  * @return Is the block inside the board?
  */
-bool is_block_inside_board(Board board, int x, int y);
+bool is_block_inside_board(const Board& board, int x, int y);
 
 /**
  * Checks wether the tetromino fits inside the board.
@@ -52,7 +67,7 @@ bool is_block_inside_board(Board board, int x, int y);
  * @param y The y position of the tetromino.
  * @return Does the tetromino fit at the given position? 
  */
-bool is_valid_position(Board board, Tetromino tetromino, int x, int y);
+bool is_valid_position(const Board& board, const Tetromino& tetromino, int x, int y);
 
 /**
  * Fixates the teromino onto the board.
@@ -62,7 +77,7 @@ bool is_valid_position(Board board, Tetromino tetromino, int x, int y);
  * @param x The x position of the tetromino.
  * @param y The y position of the tetromino.
  */
-void fixate_tetromino(Board& board, Tetromino tetromino, int color, int x, int y);
+void fixate_tetromino(Board& board, const Tetromino& tetromino, int color, int x, int y);
 
 /**
  * Checks if any lines are complete and clears them.
@@ -40,8 +40,7 @@ void draw_box(int x1, int y1, int x2, int y2)
 
 void draw_board_system()
 {
-	using System = Archetype<Iterate<Board>>;
-	for (auto[board] : ECS::iterate<System>()) {
+	for (auto[board] : ECS::iterate<DrawBoardSystem>()) {
 		mvaddstr(board.offsetY - 2, 2 * board.offsetX - 1, std::string(2 * board.sizeX + 2, ' ').c_str());
 		draw_box(2 * board.offsetX - 1, board.offsetY - 1, 2 * (board.offsetX + board.sizeX), board.offsetY + board.sizeY);
 		for (int x = 0; x < board.sizeX; x++) {
@@ -65,8 +64,7 @@ void draw_board_system()
 
 void draw_tetromino_system()
 {
-	using System = Archetype<Iterate<Tetromino, Color, Position, Board>>;
-	for (auto[tetromino, color, position, board] : ECS::iterate<System>()) {
+	for (auto[color, position, tetromino, board] : ECS::iterate<DrawTetrominoSystem>()) {
 		attron(COLOR_PAIR(color.ncurses_mod8));
 		execute_blockwise(tetromino, [&](int x, int y) {
 			int globalX = 2 * (board.offsetX + position.x + x);
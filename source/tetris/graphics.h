@@ -1,4 +1,8 @@
 #pragma once
+#include "board.h"
+#include "movement.h"
+#include "tetromino.h"
+#include "engine/central/archetype.h"
 
 /**
  * The color for some tetromino.
@@ -9,6 +13,16 @@ struct Color
 	int ncurses_mod8;
 };
 
+// Resource of the systems that draw onto the terminal.
+struct Terminal {};
+
+// The archetype used to draw the boards.
+using DrawBoardSystem = kodanuki::Archetype<kodanuki::Iterate<const Board>>;
+
+// The archetype used to draw the tetrominos, the shapes and boards are bound.
+using DrawTetrominoSystem = kodanuki::Archetype<kodanuki::Own<const Color, const Position>,
+	kodanuki::Iterate<const Tetromino, const Board>>;
+
 /**
  * Initializes the ncurses library for the application.
  */
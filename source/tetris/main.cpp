@@ -5,6 +5,7 @@
 #include "rotation.h"
 #include "engine/central/entity.h"
 #include "engine/central/archetype.h"
+#include "engine/central/scheduler.h"
 #include <ncurses.h>
 #include <array>
 #include <vector>
@@ -30,11 +31,11 @@ Entity create_falling_tetromino(Entity world, float speed)
 {
 	Entity tetromino = ECS::create();
 	ECS::bind<Board>(tetromino, world);
-	ECS::bind<TetrominoRotations>(tetromino, world);
+	ECS::share<TetrominoRotations>(tetromino, world);
 	ECS::update<Rotation>(tetromino, {0, 0});
 	ECS::update<Color>(tetromino, {1 + std::rand() % 6});
 	ECS::update<Falling>(tetromino, {speed, 0});
-	TetrominoRotations& rotations = ECS::get<TetrominoRotations>(tetromino);
+	const TetrominoRotations& rotations = ECS::get<const TetrominoRotations>(tetromino);
 	ECS::bind<Tetromino>(tetromino, rotations.rotations[std::rand() % 7]);
 	int size = ECS::get<Tetromino>(tetromino).size;
 	ECS::update<Position>(tetromino, {std::rand() % (BOARD_WIDTH - size), -2});
@@ -47,10 +48,11 @@ std::vector<Entity> create_boards()
 	int height = BOARD_HEIGHT;
 	int size = width * height;
 	int spacing = BOARD_SPACING;
-	std::vector<int> emptyBoard(size, 0);
+	// Copies would use the default resource, so each board gets its own.
+	auto emptyBoard = [&] { return std::pmr::vector<int>(size, 0, ECS::resource<Board>()); };
 
 	Entity mainBoard = ECS::create();
-	ECS::update<Board>(mainBoard, {3, 4, width, height, emptyBoard, true});
+	ECS::update<Board>(mainBoard, {3, 4, width, height, emptyBoard(), true});
 	ECS::update<TetrominoRotations>(mainBoard, calculate_tetromino_rotations());
 
 	std::vector<Entity> boards;
@@ -58,8 +60,8 @@ std::vector<Entity> create_boards()
 
 	for (int i = 1; i < BOARD_COUNT; i++) {
 		Entity board = ECS::create();
-		ECS::update<Board>(board, {3 + (width + spacing / 2) * i, 4, width, height, emptyBoard, true});
-		ECS::bind<TetrominoRotations>(board, mainBoard);
+		ECS::update<Board>(board, {3 + (width + spacing / 2) * i, 4, width, height, emptyBoard(), true});
+		ECS::share<TetrominoRotations>(board, mainBoard);
 		boards.push_back(board);
 	}
 
@@ -101,6 +103,14 @@ int main()
 	std::vector<Entity> boards = create_boards();
 	std::vector<Entity> tetrominos(boards.size());
 
+	// Systems without conflicting accesses run concurrently.
+	Scheduler scheduler;
+	scheduler.add<Resource<Entity>>(move_tetromino_system);
+	scheduler.add<RotationFlagSystem<RotateLeftFlag>, RotationFlagSystem<RotateRightFlag>,
+		RotationSystem>(rotate_tetromino_system);
+	scheduler.add<DrawBoardSystem, Resource<Terminal>>(draw_board_system);
+	scheduler.add<DrawTetrominoSystem, Resource<Terminal>>(draw_tetromino_system);
+
 	float speed = INITIAL_SPEED;
 	int lines = 0;
 	bool running = true;
@@ -136,21 +146,18 @@ int main()
 		}
 
 		for (int i = 0; i < (int) boards.size(); i++) {
-			if (tetrominos[i] && ECS::has<Entity>(tetrominos[i])) {
+			if (ECS::alive(tetrominos[i])) {
 				continue;
 			}
 			tetrominos[i] = create_falling_tetromino(boards[i], speed);
 		}
 
 		speed += 0.01;
-		move_tetromino_system();
-		rotate_tetromino_system();
-		draw_board_system();
-		draw_tetromino_system();
+		scheduler.run();
 		print_score_line(lines);
 	}
 
-	auto rotations = ECS::get<TetrominoRotations>(boards[0]).rotations;
+	auto rotations = ECS::get<const TetrominoRotations>(boards[0]).rotations;
 	remove_entities(std::vector<Entity>(rotations.begin(), rotations.end()));
 	remove_entities(boards);
 	remove_entities(tetrominos);
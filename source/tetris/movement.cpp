@@ -4,6 +4,7 @@
 #include "tetromino.h"
 #include "engine/central/entity.h"
 #include "engine/central/archetype.h"
+#include "engine/central/command.h"
 using namespace kodanuki;
 
 template <typename Flag, int count>
@@ -26,19 +27,20 @@ void move_vertical_system()
 			position.y += count;
 		} else {
 			fixate_tetromino(board, tetromino, color.ncurses_mod8, position.x, position.y);
-			ECS::remove<Entity>(entity);
+			ECS::commands().destroy(entity);
 		}
 	}
 }
 
 void countdown_system()
 {
-	using System = Archetype<Iterate<Entity, Falling>>;
-	for (auto[entity, falling] : ECS::iterate<System>()) {
-		falling.countdown--;
-		if (falling.countdown < 0) {
-			falling.countdown = 10000 / falling.speed;
-			ECS::update<MoveDownFlag>(entity);
+	using System = Archetype<Own<Falling>, Iterate<Entity>>;
+	auto[fallings, entities] = ECS::columns<System>();
+	for (std::size_t i = 0; i < fallings.size(); i++) {
+		fallings[i].countdown--;
+		if (fallings[i].countdown < 0) {
+			fallings[i].countdown = 10000 / fallings[i].speed;
+			ECS::update<MoveDownFlag>(entities[i]);
 		}
 	}
 }
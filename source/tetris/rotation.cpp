@@ -24,8 +24,7 @@ TetrominoRotations calculate_tetromino_rotations()
 template <typename Flag, int count>
 void process_rotation_flags()
 {
-	using System = Archetype<Iterate<Entity, Rotation>, Require<Falling>, Consume<Flag>>;
-	for (auto[entity, rotation] : ECS::iterate<System>()) {
+	for (auto[entity, rotation] : ECS::iterate<RotationFlagSystem<Flag>>()) {
 		rotation.target = (4 + rotation.source + count) % 4;
 	}
 }
@@ -34,10 +33,9 @@ void rotate_tetromino_system()
 {
 	process_rotation_flags<RotateLeftFlag, -1>();
 	process_rotation_flags<RotateRightFlag, 1>();
-	using System = Archetype<Iterate<Entity, Tetromino, Position, Rotation, Board, TetrominoRotations>, Require<Falling>>;
-	for (auto[entity, tetromino, position, rotation, board, base] : ECS::iterate<System>()) {
+	for (auto[entity, tetromino, position, rotation, board, base] : ECS::iterate<RotationSystem>()) {
 		int index = tetromino.type + 7 * rotation.target;
-		Tetromino rotated = ECS::get<Tetromino>(base.rotations[index]);
+		const Tetromino& rotated = ECS::get<const Tetromino>(base.rotations[index]);
 		for (int attempt = 0; attempt < 5; attempt++) {
 			auto offset = wallkick(rotation.source, rotation.target, tetromino.type, attempt);
 			int localX = position.x + offset.first;
@@ -1,5 +1,8 @@
 #pragma once
+#include "board.h"
+#include "movement.h"
 #include "engine/central/entity.h"
+#include "engine/central/archetype.h"
 #include <array>
 
 /**
@@ -44,6 +47,15 @@ struct RotateRightFlag {};
  */
 TetrominoRotations calculate_tetromino_rotations();
 
+// The archetype used to consume one of the rotation flags.
+template <typename Flag>
+using RotationFlagSystem = kodanuki::Archetype<kodanuki::Iterate<kodanuki::Entity, Rotation>,
+	kodanuki::Require<Falling>, kodanuki::Consume<Flag>>;
+
+// The archetype used to rotate the tetrominos.
+using RotationSystem = kodanuki::Archetype<kodanuki::Iterate<kodanuki::Entity, Tetromino, Position,
+	Rotation, const Board, const TetrominoRotations>, kodanuki::Require<Falling>>;
+
 /**
  * Rotates all tetrominos once.
  * 
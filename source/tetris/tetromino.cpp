@@ -1,4 +1,5 @@
 #include "tetromino.h"
+#include <algorithm>
 
 #define TETROMINO_I {0, 4, {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0}}
 #define TETROMINO_J {1, 3, {1, 0, 0, 1, 1, 1, 0, 0, 0}}
@@ -23,17 +24,6 @@ Tetromino create_tetromino(int type)
 	}
 };
 
-void execute_blockwise(Tetromino tetromino, std::function<void(int, int)> callback)
-{
-	for (int x = 0; x < tetromino.size; x++) {
-		for (int y = 0; y < tetromino.size; y++) {
-			if (tetromino.isblock[tetromino.size * y + x]) {
-				callback(x, y);
-			}
-		}
-	}
-}
-
 void rotate_tetromino(Tetromino& tetromino)
 {
 	Tetromino copy = tetromino;
@@ -1,5 +1,4 @@
 #pragma once
-#include <functional>
 #include <vector>
 
 /**
@@ -36,7 +35,17 @@ Tetromino create_tetromino(int type);
  * @param tetromino The tetromino for which blocks are considered.
  * @param callback The callback executing with (x, y) positions of blocks.
  */
-void execute_blockwise(Tetromino tetromino, std::function<void(int, int)> callback);
+template <typename Callback>
+void execute_blockwise(const Tetromino& tetromino, Callback callback)
+{
+	for (int x = 0; x < tetromino.size; x++) {
+		for (int y = 0; y < tetromino.size; y++) {
+			if (tetromino.isblock[tetromino.size * y + x]) {
+				callback(x, y);
+			}
+		}
+	}
+}
 
 /**
  * Rotates the given tetromino inplace clockwise.
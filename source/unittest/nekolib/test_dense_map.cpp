@@ -0,0 +1,91 @@
+#include "engine/nekolib/dense_map.h"
+#include "engine/nekolib/paged_array.h"
+#include <doctest/doctest.h>
+#include <bits/stdc++.h>
+using namespace kodanuki;
+
+
+TEST_CASE("PagedArray")
+{
+	PagedArray<uint64_t, 16> array(42);
+
+	SUBCASE("unwritten elements are empty and allocate nothing")
+	{
+		CHECK(array.get(3) == 42);
+		CHECK(array.get(1000) == 42);
+		CHECK(array.find(3) == nullptr);
+		CHECK(array.capacity() == 0);
+	}
+
+	SUBCASE("writing allocates only the touched page")
+	{
+		array[100] = 7;
+		CHECK(array.get(100) == 7);
+		CHECK(array.get(101) == 42);
+		CHECK(array.get(3) == 42);
+		CHECK(array.capacity() == 16);
+		CHECK(array.page_count() == 7);
+	}
+
+	SUBCASE("copies are deep")
+	{
+		array[5] = 1;
+		PagedArray<uint64_t, 16> copy = array;
+		copy[5] = 2;
+		CHECK(array.get(5) == 1);
+		CHECK(copy.get(5) == 2);
+	}
+}
+
+template <typename K>
+void check_dense_map_usage()
+{
+	DenseMap<K, int> map;
+	CHECK(map.empty());
+
+	for (int i = 0; i < 10; i++) {
+		int value = 10 * i;
+		map.update(static_cast<K>(3 * i), value);
+	}
+	CHECK(map.size() == 10);
+	CHECK(map.contains(static_cast<K>(9)));
+	CHECK(map.contains(static_cast<K>(10)) == false);
+	CHECK(map[static_cast<K>(9)] == 30);
+	CHECK(map.find(static_cast<K>(10)) == map.end());
+	CHECK(*map.find(static_cast<K>(12)) == 40);
+
+	map.remove(static_cast<K>(0));
+	map.remove(static_cast<K>(27));
+	CHECK(map.size() == 8);
+	CHECK(map.contains(static_cast<K>(0)) == false);
+	CHECK(map.contains(static_cast<K>(27)) == false);
+
+	// The packed keys stay parallel to the dense values.
+	for (std::size_t i = 0; i < map.size(); i++) {
+		CHECK(map.data()[i] == 10 * static_cast<int>(map.keys()[i]) / 3);
+	}
+}
+
+TEST_CASE("DenseMap")
+{
+	SUBCASE("with paged integer keys")
+	{
+		check_dense_map_usage<uint32_t>();
+	}
+
+	SUBCASE("with hashed keys")
+	{
+		check_dense_map_usage<int64_t>();
+	}
+
+	SUBCASE("with move-only values")
+	{
+		DenseMap<uint32_t, std::unique_ptr<int>> map;
+		map.update(1, std::make_unique<int>(1));
+		CHECK(*map.emplace(2, new int(2)) == 2);
+		CHECK(*map.emplace(1, new int(3)) == 3);
+		map.remove(1);
+		CHECK(map.size() == 1);
+		CHECK(*map[2] == 2);
+	}
+}
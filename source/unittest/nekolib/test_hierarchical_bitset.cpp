@@ -0,0 +1,72 @@
+#include "engine/nekolib/hierarchical_bitset.h"
+#include <doctest/doctest.h>
+#include <bits/stdc++.h>
+using namespace kodanuki;
+
+
+TEST_CASE("HierarchicalBitset")
+{
+	HierarchicalBitset bitset;
+
+	SUBCASE("bits can be set and reset")
+	{
+		CHECK(!bitset.test(5));
+		bitset.set(5);
+		bitset.set(5);
+		bitset.set(100000);
+		CHECK(bitset.test(5));
+		CHECK(bitset.test(100000));
+		CHECK(!bitset.test(6));
+		CHECK(bitset.count() == 2);
+		bitset.reset(5);
+		bitset.reset(7);
+		CHECK(!bitset.test(5));
+		CHECK(bitset.count() == 1);
+	}
+
+	SUBCASE("set bits are visited in ascending order")
+	{
+		std::vector<uint64_t> expected = {0, 63, 64, 4095, 4096, 262144, 1u << 31};
+		for (uint64_t index : expected | std::views::reverse) {
+			bitset.set(index);
+		}
+		std::vector<uint64_t> visited;
+		bitset.each([&](uint64_t index) { visited.push_back(index); });
+		CHECK(visited == expected);
+		bitset.clear();
+		visited.clear();
+		bitset.each([&](uint64_t index) { visited.push_back(index); });
+		CHECK(visited.empty());
+	}
+
+	SUBCASE("reset bits are not visited")
+	{
+		for (uint64_t index = 0; index < 10000; index++) {
+			bitset.set(index);
+		}
+		for (uint64_t index = 0; index < 10000; index++) {
+			if (index % 1000 != 0) {
+				bitset.reset(index);
+			}
+		}
+		std::vector<uint64_t> visited;
+		bitset.each([&](uint64_t index) { visited.push_back(index); });
+		CHECK(visited.size() == 10);
+		CHECK(visited.back() == 9000);
+	}
+
+	SUBCASE("common bits are the intersection")
+	{
+		HierarchicalBitset other;
+		for (uint64_t index = 0; index < 5000; index += 2) {
+			bitset.set(index);
+		}
+		for (uint64_t index = 0; index < 20000; index += 3) {
+			other.set(index);
+		}
+		std::vector<uint64_t> visited;
+		bitset.each_common(other, [&](uint64_t index) { visited.push_back(index); });
+		CHECK(visited.size() == 834);
+		CHECK(std::ranges::all_of(visited, [](uint64_t index) { return index % 6 == 0; }));
+	}
+}
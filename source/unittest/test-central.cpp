@@ -1,6 +1,12 @@
 #include "engine/central/archetype.h"
+#include "engine/central/command.h"
 #include "engine/central/entity.h"
 #include "engine/central/family.h"
+#include "engine/central/memory.h"
+#include "engine/central/observer.h"
+#include "engine/central/scheduler.h"
+#include "engine/central/snapshot.h"
+#include "engine/central/thread_pool.h"
 #include <doctest/doctest.h>
 #include <bits/stdc++.h>
 using namespace kodanuki;
@@ -147,6 +153,31 @@ TEST_CASE("basic entity tests")
 		CHECK(ECS::has<Position>(entityB) == false);
 	}
 
+	SUBCASE("removed entities are no longer alive")
+	{
+		CHECK(ECS::alive(entityA) == true);
+		ECS::remove<Entity>(entityA);
+		CHECK(ECS::alive(entityA) == false);
+		CHECK(ECS::alive(Entity()) == false);
+	}
+
+	SUBCASE("slots of removed entities are recycled")
+	{
+		ECS::update<Position>(entityA, {10, 10, 10});
+		ECS::remove<Entity>(entityA);
+		Entity recycled = ECS::create();
+		CHECK(handle_index(recycled.value()) == handle_index(entityA.value()));
+		CHECK(handle_generation(recycled.value()) != handle_generation(entityA.value()));
+		CHECK(recycled != entityA);
+		CHECK(ECS::alive(recycled) == true);
+		CHECK(ECS::alive(entityA) == false);
+		CHECK(ECS::has<Entity>(entityA) == false);
+		CHECK(ECS::has<Position>(recycled) == false);
+		ECS::update<Position>(recycled, {20, 20, 20});
+		CHECK(ECS::has<Position>(entityA) == false);
+		ECS::remove<Entity>(recycled);
+	}
+
 	// cleanup
 	ECS::remove<Entity>(entity);
 	ECS::remove<Entity>(entityA);
@@ -154,6 +185,84 @@ TEST_CASE("basic entity tests")
 	ECS::remove<Entity>(entityC);
 };
 
+TEST_CASE("entity storage tests")
+{
+	EntityStorage<int> storage;
+	HandleAllocator handles;
+	std::vector<uint64_t> keys;
+	for (int i = 0; i < 6; i++) {
+		keys.push_back(handles.create());
+	}
+
+	SUBCASE("shared values survive swap-back removes")
+	{
+		storage.update(keys[0], 0);
+		storage.update(keys[1], 1);
+		storage.bind(keys[2], keys[1]);
+		storage.bind(keys[3], keys[1]);
+		storage.remove(keys[0]);
+		CHECK(storage.size() == 3);
+		CHECK(storage[keys[1]] == 1);
+		CHECK(storage[keys[2]] == 1);
+		CHECK(storage[keys[3]] == 1);
+		storage[keys[3]] = 5;
+		CHECK(storage[keys[1]] == 5);
+	}
+
+	SUBCASE("shared values are removed with their last key")
+	{
+		storage.update(keys[0], 0);
+		storage.bind(keys[1], keys[0]);
+		storage.bind(keys[2], keys[0]);
+		storage.update(keys[3], 3);
+		storage.remove(keys[0]);
+		storage.remove(keys[2]);
+		CHECK(storage.contains(keys[1]) == true);
+		CHECK(storage[keys[1]] == 0);
+		storage.remove(keys[1]);
+		CHECK(storage.size() == 1);
+		CHECK(storage[keys[3]] == 3);
+		CHECK(storage.keys() == std::set<uint64_t>{keys[3]});
+	}
+
+	SUBCASE("stale keys of recycled slots are rejected")
+	{
+		storage.update(keys[4], 4);
+		handles.destroy(keys[4]);
+		uint64_t recycled = handles.create();
+		CHECK(storage.contains(recycled) == false);
+		storage.update(recycled, 7);
+		CHECK(storage.contains(keys[4]) == false);
+		CHECK(storage[recycled] == 7);
+	}
+
+	SUBCASE("bulk removals compact the values once")
+	{
+		struct Listener : StorageListener
+		{
+			void refresh(uint64_t) override { refreshed++; }
+			void refresh_removed(std::span<const uint64_t> keys) override { batches.push_back(keys.size()); }
+			int refreshed = 0;
+			std::vector<std::size_t> batches;
+		} listener;
+		for (int i = 0; i < 4; i++) {
+			storage.update(keys[i], i);
+		}
+		storage.bind(keys[4], keys[3]);
+		storage.bind(keys[5], keys[1]);
+		storage.subscribe(&listener);
+		std::vector<uint64_t> removed = {keys[3], keys[0], keys[5], keys[0], keys[2]};
+		storage.remove_many(removed);
+		CHECK(listener.refreshed == 0);
+		CHECK(listener.batches == std::vector<std::size_t>{4});
+		CHECK(storage.keys() == std::set<uint64_t>{keys[1], keys[4]});
+		CHECK(storage[keys[1]] == 1);
+		CHECK(storage[keys[4]] == 3);
+		storage[keys[4]] = 8;
+		CHECK(storage[keys[1]] == 1);
+	}
+}
+
 TEST_CASE("entity component iteration tests")
 {
 	Entity entity = ECS::create();
@@ -370,6 +479,1672 @@ TEST_CASE("archetype iteration predicate tests")
 	ECS::remove<Entity>(entityE);
 }
 
+struct Sparse
+{
+	int value;
+};
+
+template <>
+struct kodanuki::storage_policy<Sparse>
+{
+	using type = HashedPolicy;
+};
+
+TEST_CASE("storage policy tests")
+{
+	struct Flag {};
+	struct Other {};
+	static_assert(std::is_same_v<storage_policy_t<Flag>, TagPolicy>);
+	static_assert(std::is_same_v<storage_policy_t<Position>, DensePolicy>);
+	static_assert(std::is_same_v<storage_policy_t<Sparse>, HashedPolicy>);
+
+	HandleAllocator handles;
+	std::vector<uint64_t> keys;
+	for (int i = 0; i < 4; i++) {
+		keys.push_back(handles.create());
+	}
+
+	SUBCASE("tag storages only store the keys")
+	{
+		EntityStorage<Flag> storage;
+		storage.update(keys[0]);
+		storage.update(keys[0]);
+		storage.bind(keys[1], keys[0]);
+		storage.bind(keys[2], keys[3]);
+		CHECK(storage.size() == 2);
+		CHECK(storage.keys() == std::set<uint64_t>{keys[0], keys[1]});
+		storage.remove(keys[0]);
+		CHECK(!storage.contains(keys[0]));
+		CHECK(storage.contains(keys[1]));
+	}
+
+	SUBCASE("tag storages reject stale keys")
+	{
+		EntityStorage<Flag> storage;
+		storage.update(keys[0]);
+		handles.destroy(keys[0]);
+		uint64_t recycled = handles.create();
+		CHECK(!storage.contains(recycled));
+		storage.update(recycled);
+		CHECK(storage.contains(recycled));
+		CHECK(!storage.contains(keys[0]));
+		CHECK(storage.size() == 1);
+	}
+
+	SUBCASE("hashed storages share bound values")
+	{
+		EntityStorage<Sparse> storage;
+		storage.update(keys[0], {1});
+		storage.bind(keys[1], keys[0]);
+		storage[keys[1]].value = 2;
+		CHECK(storage[keys[0]].value == 2);
+		storage.remove(keys[0]);
+		CHECK(storage[keys[1]].value == 2);
+		CHECK(storage.size() == 1);
+	}
+
+	SUBCASE("archetypes work with every policy")
+	{
+		Entity a = ECS::create();
+		Entity b = ECS::create();
+		ECS::update<Sparse>(a, {1});
+		ECS::update<Sparse>(b, {2});
+		ECS::update<Flag>(a);
+		ECS::update<Flag>(b);
+		ECS::update<Other>(b);
+		using System = Archetype<Iterate<Sparse>, Require<Flag>, Consume<Other>>;
+		int sum = 0;
+		for (auto[sparse] : ECS::iterate<System>()) {
+			sum += sparse.value;
+		}
+		CHECK(sum == 2);
+		CHECK(!ECS::has<Other>(b));
+		CHECK(ECS::iterate<Archetype<Require<Flag, Sparse>>>().size() == 2);
+		ECS::remove<Entity>(a);
+		ECS::remove<Entity>(b);
+		CHECK(ECS::iterate<Archetype<Require<Flag, Sparse>>>().size() == 0);
+	}
+
+	SUBCASE("queries intersect tag storages")
+	{
+		EntityMapping mapping;
+		mapping.get<Flag>().update(keys[0]);
+		mapping.get<Flag>().update(keys[1]);
+		mapping.get<Other>().update(keys[1]);
+		mapping.get<Other>().update(keys[2]);
+		auto& query = mapping.query<std::tuple<Flag, Other>, std::tuple<>>();
+		CHECK(query.keys() == std::vector<uint64_t>{keys[1]});
+	}
+}
+
+TEST_CASE("emplace tests")
+{
+	using Handle = std::unique_ptr<int>;
+
+	ECS::World world;
+	Entity a = world.create();
+	Entity b = world.create();
+
+	SUBCASE("components are constructed in place")
+	{
+		Position& position = world.emplace<Position>(a, 1, 2, 3);
+		CHECK(position.y == 2);
+		world.emplace<Position>(a, 4, 5, 6);
+		CHECK(world.get<Position>(a).y == 5);
+		CHECK(world.emplace<Sparse>(a, 7).value == 7);
+		CHECK(world.emplace<Sparse>(a, 8).value == 8);
+	}
+
+	SUBCASE("move-only components can be stored and moved")
+	{
+		world.emplace<Handle>(a, new int(1));
+		world.update<Handle>(b, std::make_unique<int>(2));
+		CHECK(*world.get<Handle>(a) == 1);
+		world.move<Handle>(a, b);
+		CHECK(!world.has<Handle>(a));
+		CHECK(*world.get<Handle>(b) == 1);
+		world.swap<Handle>(a, b);
+		CHECK(*world.get<Handle>(a) == 1);
+		world.remove<Entity>(a);
+		CHECK(world.iterate<Archetype<Iterate<Handle>>>().size() == 0);
+	}
+
+	SUBCASE("commands construct components when recording")
+	{
+		world.commands().emplace<Handle>(a, new int(3));
+		world.commands().emplace<Position>(b, 1, 2, 3);
+		world.flush();
+		CHECK(*world.get<Handle>(a) == 3);
+		CHECK(world.get<Position>(b).z == 3);
+	}
+}
+
+TEST_CASE("shared component tests")
+{
+	ECS::World world;
+	Entity prefab = world.create();
+	std::vector<Entity> instances = world.create_many(4);
+	world.update<Position>(prefab, {1, 2, 3});
+	world.update<Sparse>(prefab, {1});
+	for (Entity instance : instances) {
+		world.share<Position>(instance, prefab);
+		world.share<Sparse>(instance, prefab);
+	}
+
+	SUBCASE("shared components use the same memory until written")
+	{
+		const Position* shared = &world.get<const Position>(prefab);
+		CHECK(&world.get<const Position>(instances[0]) == shared);
+		world.get<Position>(instances[0]).x = 4;
+		CHECK(&world.get<const Position>(instances[0]) != shared);
+		CHECK(world.get<const Position>(instances[0]).x == 4);
+		CHECK(world.get<const Position>(instances[1]).x == 1);
+		world.update<Position>(prefab, {5, 5, 5});
+		CHECK(world.get<const Position>(prefab).x == 5);
+		CHECK(world.get<const Position>(instances[1]).x == 1);
+		CHECK(world.get<const Position>(instances[0]).x == 4);
+	}
+
+	SUBCASE("hashed components are copied on write")
+	{
+		world.get<Sparse>(instances[0]).value = 2;
+		world.emplace<Sparse>(instances[1], 3);
+		CHECK(world.get<const Sparse>(prefab).value == 1);
+		CHECK(world.get<const Sparse>(instances[0]).value == 2);
+		CHECK(world.get<const Sparse>(instances[1]).value == 3);
+		CHECK(world.get<const Sparse>(instances[2]).value == 1);
+	}
+
+	SUBCASE("shared components are removed with their last entity")
+	{
+		world.remove<Entity>(prefab);
+		CHECK(world.get<const Position>(instances[3]).z == 3);
+		for (Entity instance : instances) {
+			world.remove<Position>(instance);
+		}
+		CHECK(world.iterate<Archetype<Iterate<Position>>>().size() == 0);
+	}
+
+	SUBCASE("swapping shared components copies both first")
+	{
+		world.get<Position>(instances[2]).x = 8;
+		world.share<Position>(instances[3], instances[2]);
+		world.swap<Position>(instances[0], instances[1]);
+		world.swap<Position>(instances[2], instances[0]);
+		world.swap<Sparse>(instances[0], instances[1]);
+		CHECK(world.get<const Position>(instances[0]).x == 8);
+		CHECK(world.get<const Position>(instances[2]).x == 1);
+		CHECK(world.get<const Position>(instances[3]).x == 8);
+		CHECK(world.get<const Position>(prefab).x == 1);
+		CHECK(&world.get<const Position>(instances[1]) != &world.get<const Position>(prefab));
+		CHECK(world.get<const Sparse>(instances[1]).value == 1);
+	}
+
+	SUBCASE("binding to a shared component copies it first")
+	{
+		Entity alias = world.create();
+		world.bind<Position>(alias, instances[0]);
+		world.get<Position>(alias).x = 6;
+		CHECK(world.get<const Position>(instances[0]).x == 6);
+		CHECK(world.get<const Position>(instances[1]).x == 1);
+		CHECK(world.get<const Position>(prefab).x == 1);
+	}
+
+	SUBCASE("iteration copies the components that are written")
+	{
+		using System = Archetype<Iterate<Entity, Position>>;
+		world.par_iterate<System>([&](Entity entity, Position& position) {
+			position.x = static_cast<int>(entity.value() & 0xff);
+		});
+		for (Entity instance : instances) {
+			CHECK(world.get<const Position>(instance).x == static_cast<int>(instance.value() & 0xff));
+		}
+		CHECK(world.get<const Sparse>(instances[0]).value == 1);
+	}
+
+	SUBCASE("shared components survive snapshots and rollbacks")
+	{
+		Checkpoint checkpoint = world.checkpoint();
+		world.get<Position>(instances[0]).x = 7;
+		world.rollback(checkpoint);
+		CHECK(&world.get<const Position>(instances[0]) == &world.get<const Position>(prefab));
+		SnapshotWriter writer;
+		world.save(writer);
+		ECS::World copy;
+		SnapshotReader reader(writer.data());
+		copy.load(reader);
+		copy.get<Position>(instances[0]).x = 8;
+		CHECK(copy.get<const Position>(instances[1]).x == 1);
+		CHECK(&copy.get<const Position>(instances[1]) == &copy.get<const Position>(prefab));
+	}
+}
+
+// Returns the entities visited by the archetype, its first type is Entity.
+template <typename System>
+std::set<Entity> visit(ECS::World& world)
+{
+	std::set<Entity> visited;
+	for (auto entry : world.iterate<System>()) {
+		visited.insert(std::get<0>(entry));
+	}
+	return visited;
+}
+
+TEST_CASE("change detection tests")
+{
+	struct Velocity { int value; };
+	struct Flag {};
+
+	ECS::World world;
+	std::vector<Entity> entities = world.create_many(4);
+	for (Entity entity : entities) {
+		world.update<Position>(entity, {0, 0, 0});
+		world.update<Velocity>(entity, {1});
+	}
+
+	SUBCASE("added components are visited once")
+	{
+		using System = Archetype<Iterate<Entity>, Added<Position>>;
+		CHECK(visit<System>(world).size() == 4);
+		CHECK(visit<System>(world).empty());
+		world.remove<Position>(entities[1]);
+		world.update<Position>(entities[1], {});
+		world.update<Position>(entities[2], {});
+		CHECK(visit<System>(world) == std::set<Entity>{entities[1]});
+	}
+
+	SUBCASE("writes mark components as changed")
+	{
+		using System = Archetype<Iterate<Entity>, Changed<Position>>;
+		CHECK(visit<System>(world).size() == 4);
+		world.update<Position>(entities[0], {1, 0, 0});
+		world.get<Position>(entities[1]).x = 1;
+		CHECK(world.get<const Position>(entities[2]).x == 0);
+		CHECK(visit<System>(world) == std::set<Entity>{entities[0], entities[1]});
+		CHECK(visit<System>(world).empty());
+	}
+
+	SUBCASE("iterating non-const components marks them as changed")
+	{
+		using ReadSystem = Archetype<Iterate<Entity, const Velocity>, Changed<Position>>;
+		using MoveSystem = Archetype<Iterate<Position, const Velocity>>;
+		CHECK(visit<ReadSystem>(world).size() == 4);
+		for (auto[position, velocity] : world.iterate<MoveSystem>()) {
+			position.x += velocity.value;
+		}
+		CHECK(visit<ReadSystem>(world).size() == 4);
+		for (auto[entity, velocity] : world.iterate<ReadSystem>()) {
+			CHECK(velocity.value == 1);
+		}
+		CHECK(visit<ReadSystem>(world).empty());
+	}
+
+	SUBCASE("own changes are not visible to the next run")
+	{
+		using System = Archetype<Iterate<Entity, Position>, Changed<Position>>;
+		for (auto[entity, position] : world.iterate<System>()) {
+			position.y++;
+		}
+		CHECK(world.iterate<System>().size() == 0);
+		world.update<Position>(entities[3], {});
+		CHECK(world.iterate<System>().size() == 1);
+	}
+
+	SUBCASE("tags are only added")
+	{
+		using System = Archetype<Iterate<Entity>, Changed<Flag>>;
+		world.update<Flag>(entities[0]);
+		CHECK(visit<System>(world).size() == 1);
+		world.update<Flag>(entities[0]);
+		CHECK(visit<System>(world).empty());
+	}
+
+	SUBCASE("hashed components track changes")
+	{
+		using System = Archetype<Iterate<Entity>, Changed<Sparse>>;
+		world.update<Sparse>(entities[0], {1});
+		world.update<Sparse>(entities[1], {1});
+		CHECK(visit<System>(world).size() == 2);
+		world.get<Sparse>(entities[1]).value = 2;
+		CHECK(visit<System>(world) == std::set<Entity>{entities[1]});
+	}
+}
+
+TEST_CASE("observer tests")
+{
+	struct Mesh { int vertices; };
+
+	ECS::World world;
+	std::vector<Entity> added;
+	std::vector<Entity> removed;
+	std::vector<Entity> destroyed;
+	uint64_t batches = 0;
+	world.on_add<Mesh>([&](std::span<const Entity> entities) {
+		added.insert(added.end(), entities.begin(), entities.end());
+		batches++;
+	});
+	world.on_remove<Mesh>([&](std::span<const Entity> entities) {
+		removed.insert(removed.end(), entities.begin(), entities.end());
+	});
+	world.on_destroy([&](std::span<const Entity> entities) {
+		destroyed.insert(destroyed.end(), entities.begin(), entities.end());
+	});
+	std::vector<Entity> entities = world.create_many(3);
+
+	SUBCASE("events are delivered in batches when flushing")
+	{
+		world.update_many<Mesh>(entities, {4});
+		world.update<Mesh>(entities[0], {8});
+		CHECK(added.empty());
+		world.flush();
+		CHECK(added == entities);
+		CHECK(batches == 1);
+		world.flush();
+		CHECK(batches == 1);
+	}
+
+	SUBCASE("removals are only reported for present components")
+	{
+		world.update<Mesh>(entities[0], {4});
+		world.remove<Mesh>(entities[0]);
+		world.remove<Mesh>(entities[1]);
+		world.flush();
+		CHECK(added == std::vector<Entity>{entities[0]});
+		CHECK(removed == std::vector<Entity>{entities[0]});
+	}
+
+	SUBCASE("destroying reports the entity and its components")
+	{
+		world.update<Mesh>(entities[1], {4});
+		world.flush();
+		world.remove<Entity>(entities[1]);
+		world.commands().destroy(entities[2]);
+		world.flush();
+		CHECK(removed == std::vector<Entity>{entities[1]});
+		CHECK(destroyed == std::vector<Entity>{entities[1], entities[2]});
+	}
+
+	SUBCASE("events of callbacks are delivered next time")
+	{
+		world.on_add<Mesh>([&](std::span<const Entity> entities) {
+			for (Entity entity : entities) {
+				world.remove<Mesh>(entity);
+			}
+		});
+		world.update<Mesh>(entities[0], {4});
+		world.flush();
+		CHECK(removed.empty());
+		world.flush();
+		CHECK(removed == std::vector<Entity>{entities[0]});
+	}
+}
+
+struct Polyline
+{
+	std::vector<int> points;
+};
+
+template <>
+struct kodanuki::Serializer<Polyline>
+{
+	static constexpr bool enabled = true;
+
+	static void save(SnapshotWriter& writer, const Polyline& line)
+	{
+		writer.write_array<int>(line.points);
+	}
+
+	static Polyline load(SnapshotReader& reader)
+	{
+		Polyline line;
+		reader.read_array(line.points);
+		return line;
+	}
+};
+
+TEST_CASE("snapshot tests")
+{
+	struct Flag {};
+	struct Name { std::string value; };
+
+	ECS::World world;
+	Entity root = world.create();
+	std::vector<Entity> children = world.create_many(3, root);
+	world.remove<Entity>(children[1]);
+	world.update<Position>(root, {1, 2, 3});
+	world.update<Position>(children[0], {4, 5, 6});
+	world.bind<Position>(children[2], children[0]);
+	world.update<Sparse>(children[2], {7});
+	world.update<Flag>(children[0]);
+	world.update<Polyline>(root, {{1, 2, 3}});
+
+	auto check = [&](ECS::World& copy) {
+		CHECK(copy.alive(root));
+		CHECK(copy.alive(children[0]));
+		CHECK(!copy.alive(children[1]));
+		CHECK(copy.get<Position>(root).z == 3);
+		CHECK(copy.get<Sparse>(children[2]).value == 7);
+		CHECK(copy.has<Flag>(children[0]));
+		CHECK(!copy.has<Flag>(children[2]));
+		CHECK(copy.get<Polyline>(root).points == std::vector<int>{1, 2, 3});
+		CHECK(copy.get<Family>(children[2]).get_root() == root);
+		CHECK(copy.get<Family>(root).get_children().size() == 2);
+		copy.get<Position>(children[2]).x = 8;
+		CHECK(copy.get<Position>(children[0]).x == 8);
+		Entity entity = copy.create();
+		CHECK(entity != root);
+		CHECK(entity != children[0]);
+		CHECK(entity != children[2]);
+	};
+
+	SUBCASE("worlds are restored from memory")
+	{
+		SnapshotWriter writer;
+		world.save(writer);
+		ECS::World copy;
+		SnapshotReader reader(writer.data());
+		copy.load(reader);
+		CHECK(reader.remaining() == 0);
+		check(copy);
+	}
+
+	SUBCASE("worlds are restored from files")
+	{
+		std::filesystem::path path = std::filesystem::temp_directory_path() / "kodanuki-snapshot.bin";
+		world.save(path);
+		ECS::World copy;
+		copy.load(path);
+		std::filesystem::remove(path);
+		check(copy);
+	}
+
+	SUBCASE("components without serializer are skipped")
+	{
+		world.update<Name>(root, {"root"});
+		SnapshotWriter writer;
+		world.save(writer);
+		ECS::World copy;
+		SnapshotReader reader(writer.data());
+		copy.load(reader);
+		CHECK(!copy.has<Name>(root));
+		check(copy);
+	}
+
+	SUBCASE("invalid snapshots are rejected")
+	{
+		SnapshotWriter writer;
+		writer.write<uint64_t>(42);
+		ECS::World copy;
+		SnapshotReader reader(writer.data());
+		CHECK_THROWS(copy.load(reader));
+	}
+}
+
+TEST_CASE("rollback tests")
+{
+	struct Flag {};
+
+	ECS::World world;
+	std::vector<Entity> entities = world.create_many(2000);
+	for (uint64_t i = 0; i < entities.size(); i++) {
+		world.update<Position>(entities[i], {static_cast<int>(i), 0, 0});
+	}
+	world.update<Sparse>(entities[0], {1});
+	world.update<Flag>(entities[1]);
+	Checkpoint start = world.checkpoint();
+
+	SUBCASE("written values are restored")
+	{
+		world.get<Position>(entities[10]).y = 1;
+		world.update<Position>(entities[1500], {0, 2, 0});
+		world.get<Sparse>(entities[0]).value = 2;
+		world.rollback(start);
+		CHECK(world.get<Position>(entities[10]).y == 0);
+		CHECK(world.get<Position>(entities[1500]).x == 1500);
+		CHECK(world.get<Position>(entities[1500]).y == 0);
+		CHECK(world.get<Sparse>(entities[0]).value == 1);
+	}
+
+	SUBCASE("parallel writes mark their chunks")
+	{
+		using System = Archetype<Iterate<Position>>;
+		world.par_iterate<System>([](Position& position) {
+			position.y = position.x;
+		}, 64);
+		Checkpoint written = world.checkpoint();
+		world.rollback(start);
+		CHECK(world.get<const Position>(entities[1999]).y == 0);
+		world.rollback(written);
+		for (uint64_t i = 0; i < entities.size(); i += 100) {
+			CHECK(world.get<const Position>(entities[i]).y == static_cast<int>(i));
+		}
+	}
+
+	SUBCASE("consecutive checkpoints can be restored in any order")
+	{
+		std::vector<Checkpoint> checkpoints = {start};
+		for (int tick = 1; tick <= 3; tick++) {
+			world.get<Position>(entities[tick * 600]).z = tick;
+			checkpoints.push_back(world.checkpoint());
+		}
+		world.rollback(checkpoints[1]);
+		CHECK(world.get<Position>(entities[600]).z == 1);
+		CHECK(world.get<Position>(entities[1200]).z == 0);
+		world.rollback(checkpoints[3]);
+		CHECK(world.get<Position>(entities[1200]).z == 2);
+		CHECK(world.get<Position>(entities[1800]).z == 3);
+		world.rollback(checkpoints[0]);
+		CHECK(world.get<Position>(entities[600]).z == 0);
+	}
+
+	SUBCASE("created and destroyed entities are restored")
+	{
+		Entity child = world.create(entities[0]);
+		world.update<Position>(child, {});
+		world.remove<Entity>(entities[2]);
+		world.remove<Flag>(entities[1]);
+		world.rollback(start);
+		CHECK(!world.alive(child));
+		CHECK(world.alive(entities[2]));
+		CHECK(world.get<Position>(entities[2]).x == 2);
+		CHECK(world.has<Flag>(entities[1]));
+		CHECK(world.get<Family>(entities[0]).get_children().empty());
+		CHECK(world.create() == child);
+	}
+
+	SUBCASE("queries and observers follow the rollback")
+	{
+		using System = Archetype<Iterate<Entity>, Require<Flag>>;
+		std::vector<Entity> added;
+		world.on_add<Flag>([&](std::span<const Entity> entities) {
+			added.insert(added.end(), entities.begin(), entities.end());
+		});
+		world.remove<Flag>(entities[1]);
+		world.flush();
+		CHECK(visit<System>(world).empty());
+		world.rollback(start);
+		world.flush();
+		CHECK(visit<System>(world) == std::set<Entity>{entities[1]});
+		CHECK(added == std::vector<Entity>{entities[1]});
+	}
+
+	SUBCASE("changes are detected again after the rollback")
+	{
+		using System = Archetype<Iterate<Entity>, Changed<Position>>;
+		CHECK(visit<System>(world).size() == entities.size());
+		Checkpoint visited = world.checkpoint();
+		world.get<Position>(entities[5]).x = 7;
+		CHECK(visit<System>(world) == std::set<Entity>{entities[5]});
+		world.rollback(visited);
+		world.get<Position>(entities[5]).x = 7;
+		CHECK(visit<System>(world) == std::set<Entity>{entities[5]});
+	}
+
+	SUBCASE("checkpoints of other worlds are rejected")
+	{
+		ECS::World other;
+		CHECK_THROWS(other.rollback(start));
+	}
+}
+
+TEST_CASE("query cache tests")
+{
+	struct Tag {};
+	EntityMapping mapping;
+	auto& query = mapping.query<std::tuple<Position>, std::tuple<Tag>>();
+	CHECK(query.size() == 0);
+
+	uint64_t keyA = make_handle(0, 0);
+	uint64_t keyB = make_handle(1, 0);
+
+	SUBCASE("queries follow inserts and removes")
+	{
+		mapping.get<Position>().update(keyA, {});
+		mapping.get<Position>().update(keyB, {});
+		CHECK(query.size() == 2);
+		mapping.get<Tag>().update(keyA, {});
+		CHECK(query.size() == 1);
+		mapping.get<Tag>().remove(keyA);
+		mapping.get<Position>().remove(keyB);
+		CHECK(query.size() == 1);
+		CHECK(query.keys().back() == keyA);
+	}
+
+	SUBCASE("queries follow bound components")
+	{
+		mapping.get<Position>().update(keyA, {});
+		mapping.get<Position>().bind(keyB, keyA);
+		CHECK(query.size() == 2);
+		mapping.remove(keyA);
+		CHECK(query.size() == 1);
+	}
+
+	SUBCASE("queries are shared between equal type combinations")
+	{
+		auto& other = mapping.query<std::tuple<Position>, std::tuple<Tag>>();
+		CHECK(&other == &query);
+	}
+
+	mapping.remove(keyA);
+	mapping.remove(keyB);
+	CHECK(query.size() == 0);
+}
+
+TEST_CASE("signature tests")
+{
+	struct Tag {};
+	EntityMapping mapping;
+	uint64_t keyA = make_handle(0, 0);
+	uint64_t keyB = make_handle(1, 0);
+	std::size_t position = component_id<Position>();
+	std::size_t quaternion = component_id<Quaternion>();
+	std::size_t tag = component_id<Tag>();
+
+	SUBCASE("masks are compared word by word")
+	{
+		Signature signature = {1, 64, 200};
+		CHECK(signature.test(64));
+		CHECK(!signature.test(65));
+		CHECK(signature.contains({1, 200}));
+		CHECK(!signature.contains({1, 2}));
+		CHECK(signature.intersects({2, 200}));
+		CHECK(!signature.intersects({2, 3}));
+		signature.set(200, false);
+		CHECK(signature == Signature{1, 64});
+		signature |= Signature{3};
+		std::vector<std::size_t> bits;
+		signature.each([&](std::size_t bit) { bits.push_back(bit); });
+		CHECK(bits == std::vector<std::size_t>{1, 3, 64});
+	}
+
+	SUBCASE("signatures follow inserts and removes")
+	{
+		mapping.get<Position>().update(keyA, {});
+		mapping.get<Quaternion>().update(keyA, {});
+		mapping.get<Tag>().update(keyB, {});
+		CHECK(mapping.signatures().get(keyA) == Signature{position, quaternion});
+		CHECK(mapping.signatures().get(keyB) == Signature{tag});
+		CHECK(mapping.contains<Position, Quaternion>(keyA));
+		CHECK(!mapping.contains<Position, Tag>(keyA));
+		mapping.get<Quaternion>().remove(keyA);
+		mapping.remove(keyB);
+		CHECK(mapping.signatures().get(keyA) == Signature{position});
+		CHECK(mapping.signatures().get(keyB) == Signature());
+	}
+
+	SUBCASE("stale handles of recycled slots have no components")
+	{
+		ECS::World world;
+		Entity stale = world.create();
+		world.update<Position>(stale, {});
+		world.update<Tag>(stale);
+		world.remove<Entity>(stale);
+		Entity recycled = world.create();
+		world.update<Position>(recycled, {});
+		world.update<Tag>(recycled);
+		REQUIRE(handle_index(recycled.value()) == handle_index(stale.value()));
+		CHECK(world.has<Position, Tag>(recycled));
+		CHECK(!world.has<Position>(stale));
+		CHECK(!world.has<Position, Tag>(stale));
+		CHECK(!world.has<Tag, Position>(stale));
+	}
+
+	SUBCASE("signatures follow bound components")
+	{
+		mapping.get<Position>().update(keyA, {});
+		mapping.get<Position>().bind(keyB, keyA);
+		CHECK(mapping.signatures().get(keyB).test(position));
+		mapping.remove(keyA);
+		CHECK(mapping.signatures().get(keyB).test(position));
+		CHECK(!mapping.signatures().get(keyA).test(position));
+	}
+
+	SUBCASE("removing keys only visits the storages of their signatures")
+	{
+		mapping.get<Position>().update(keyA, {});
+		mapping.get<Tag>().update(keyB, {});
+		std::vector<uint64_t> keys = {keyA, keyB};
+		mapping.remove_many(keys);
+		CHECK(!mapping.get<Position>().contains(keyA));
+		CHECK(!mapping.get<Tag>().contains(keyB));
+		CHECK(mapping.signatures().get(keyA) == Signature());
+		CHECK(mapping.signatures().get(keyB) == Signature());
+	}
+
+	SUBCASE("signatures follow snapshots and rollbacks")
+	{
+		ECS::World world;
+		Entity entity = world.create();
+		world.update<Position>(entity, {});
+		Checkpoint checkpoint = world.checkpoint();
+		world.update<Quaternion>(entity, {});
+		CHECK(world.has<Position, Quaternion>(entity));
+		world.rollback(checkpoint);
+		CHECK(!world.has<Position, Quaternion>(entity));
+		CHECK(world.has<Position>(entity));
+		SnapshotWriter writer;
+		world.save(writer);
+		ECS::World copy;
+		SnapshotReader reader(writer.data());
+		copy.load(reader);
+		CHECK(copy.has<Position, Position>(entity));
+		CHECK(copy.iterate<Archetype<Iterate<Position>, Exclude<Quaternion>>>().size() == 1);
+	}
+}
+
+TEST_CASE("group tests")
+{
+	struct Health { int value; };
+	struct Armor { int value; };
+	struct Frozen {};
+	using Owned = std::tuple<Health, Armor>;
+	EntityMapping mapping;
+	auto& group = mapping.group<Owned, Owned, std::tuple<Frozen>>();
+
+	// The matches are packed in the same order at the front of both storages.
+	auto packed = [&] {
+		for (uint32_t i = 0; i < group.size(); i++) {
+			uint64_t key = group.keys()[i];
+			if (mapping.get<Health>().position(key) != i || mapping.get<Armor>().position(key) != i) {
+				return false;
+			}
+			if (mapping.get<Health>().value_at(i).value != mapping.get<Armor>().value_at(i).value) {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	std::vector<uint64_t> keys;
+	for (uint32_t i = 0; i < 8; i++) {
+		keys.push_back(make_handle(i, 0));
+		mapping.get<Health>().update(keys[i], {static_cast<int>(i)});
+		if (i % 2 == 0) {
+			mapping.get<Armor>().update(keys[i], {static_cast<int>(i)});
+		}
+	}
+
+	SUBCASE("groups pack the matching entities")
+	{
+		CHECK(group.size() == 4);
+		CHECK(packed());
+	}
+
+	SUBCASE("groups follow inserts, removes and excludes")
+	{
+		mapping.get<Armor>().update(keys[1], {1});
+		mapping.get<Frozen>().update(keys[2], {});
+		CHECK(group.size() == 4);
+		CHECK(packed());
+		mapping.get<Health>().remove(keys[0]);
+		mapping.remove(keys[4]);
+		mapping.get<Frozen>().remove(keys[2]);
+		CHECK(group.size() == 3);
+		CHECK(packed());
+		CHECK(std::set<uint64_t>(group.keys().begin(), group.keys().end())
+			== std::set<uint64_t>{keys[1], keys[2], keys[6]});
+	}
+
+	SUBCASE("rollbacks rebuild groups before they return")
+	{
+		MappingState state = mapping.capture();
+		mapping.get<Armor>().update(keys[1], {1});
+		mapping.get<Health>().remove(keys[0]);
+		mapping.rollback(state);
+		CHECK(group.packed());
+		CHECK(group.size() == 4);
+		CHECK(packed());
+	}
+
+	SUBCASE("owned components can't be bound or owned twice")
+	{
+		CHECK_THROWS(mapping.get<Health>().bind(keys[1], keys[0]));
+		CHECK_THROWS(mapping.get<Armor>().share(keys[1], keys[0]));
+		CHECK_THROWS(mapping.group<std::tuple<Health>, std::tuple<Health>, std::tuple<>>());
+	}
+
+	for (uint64_t key : keys) {
+		mapping.remove(key);
+	}
+	CHECK(group.size() == 0);
+}
+
+TEST_CASE("group iteration tests")
+{
+	struct Health { int value; };
+	struct Armor { int value; };
+	struct Frozen {};
+	using System = Archetype<Own<Health, const Armor>, Iterate<Entity>, Exclude<Frozen>>;
+	ECS::World world;
+	std::vector<Entity> entities = world.create_many(100);
+	for (int i = 0; i < 100; i++) {
+		world.update<Health>(entities[i], {i});
+		world.update<Armor>(entities[i], {i});
+		if (i % 10 == 0) {
+			world.update<Frozen>(entities[i]);
+		}
+	}
+
+	SUBCASE("owned components are iterated together")
+	{
+		int count = 0;
+		for (auto[health, armor, entity] : world.iterate<System>()) {
+			CHECK(health.value == armor.value);
+			CHECK(&world.get<const Health>(entity) == &health);
+			health.value++;
+			count++;
+		}
+		CHECK(count == 90);
+		CHECK(world.get<Health>(entities[1]).value == 2);
+		CHECK(world.get<Health>(entities[10]).value == 10);
+	}
+
+	SUBCASE("columns are the packed arrays of the group")
+	{
+		using Changes = Archetype<Iterate<Entity>, Changed<Health>>;
+		CHECK(visit<Changes>(world).size() == 100);
+		auto[healths, armors, keys] = world.columns<System>();
+		REQUIRE(healths.size() == 90);
+		CHECK(armors.size() == 90);
+		CHECK(keys.size() == 90);
+		for (std::size_t i = 0; i < healths.size(); i++) {
+			healths[i].value += armors[i].value;
+		}
+		for (std::size_t i = 0; i < keys.size(); i++) {
+			CHECK(&world.get<const Health>(keys[i]) == &healths[i]);
+			CHECK(world.get<const Health>(keys[i]).value == 2 * world.get<const Armor>(keys[i]).value);
+		}
+		CHECK(visit<Changes>(world).size() == 90);
+		struct Level { int value; };
+		for (int i = 0; i < 5; i++) {
+			world.update<Level>(entities[i], {i});
+		}
+		auto[levels] = world.columns<Archetype<Own<const Level>>>();
+		CHECK(levels.size() == 5);
+	}
+
+	SUBCASE("groups are rebuilt after snapshots and rollbacks")
+	{
+		world.iterate<System>();
+		Checkpoint checkpoint = world.checkpoint();
+		world.remove<Frozen>(entities[0]);
+		world.remove<Entity>(entities[1]);
+		CHECK(world.iterate<System>().size() == 90);
+		world.rollback(checkpoint);
+		CHECK(world.iterate<System>().size() == 90);
+		SnapshotWriter writer;
+		world.save(writer);
+		ECS::World copy;
+		copy.iterate<System>();
+		SnapshotReader reader(writer.data());
+		copy.load(reader);
+		int count = 0;
+		for (auto[health, armor, entity] : copy.iterate<System>()) {
+			CHECK(health.value == armor.value);
+			CHECK(&copy.get<const Armor>(entity) == &armor);
+			count++;
+		}
+		CHECK(count == 90);
+	}
+}
+
+struct Particle
+{
+	float x;
+	float y;
+	float speed;
+};
+
+template <>
+struct kodanuki::component_fields<Particle>
+{
+	static constexpr auto members = std::tuple(&Particle::x, &Particle::y, &Particle::speed);
+};
+
+TEST_CASE("split storage tests")
+{
+	static_assert(std::is_same_v<storage_policy_t<Particle>, SplitPolicy>);
+	ECS::World world;
+	std::vector<Entity> entities = world.create_many(8);
+	for (int i = 0; i < 8; i++) {
+		world.update<Particle>(entities[i], {float(i), 0, 1});
+	}
+
+	SUBCASE("each field is stored in its own column")
+	{
+		SplitReference<Particle> first = world.get<Particle>(entities[0]);
+		SplitReference<Particle> second = world.get<Particle>(entities[1]);
+		CHECK(&(second->*&Particle::x) == &(first->*&Particle::x) + 1);
+		CHECK(&(second->*&Particle::speed) == &(first->*&Particle::speed) + 1);
+		Particle particle = world.get<const Particle>(entities[3]);
+		CHECK(particle.x == 3);
+		CHECK(particle.speed == 1);
+	}
+
+	SUBCASE("proxies gather and scatter the fields")
+	{
+		using System = Archetype<Iterate<Particle>>;
+		for (auto[particle] : world.iterate<System>()) {
+			particle->*&Particle::y += particle->*&Particle::x * particle->*&Particle::speed;
+		}
+		world.get<Particle>(entities[0]) = {5, 6, 7};
+		world.swap<Particle>(entities[1], entities[2]);
+		CHECK(Particle(world.get<const Particle>(entities[0])).speed == 7);
+		CHECK(Particle(world.get<const Particle>(entities[1])).y == 2);
+		CHECK(Particle(world.get<const Particle>(entities[2])).y == 1);
+		CHECK(Particle(world.get<const Particle>(entities[7])).y == 7);
+	}
+
+	SUBCASE("removing swaps the last value into the gap")
+	{
+		world.remove<Particle>(entities[2]);
+		world.remove<Entity>(entities[5]);
+		CHECK(!world.has<Particle>(entities[2]));
+		CHECK(world.iterate<Archetype<Iterate<Particle>>>().size() == 6);
+		for (int i : {0, 1, 3, 4, 6, 7}) {
+			CHECK(Particle(world.get<const Particle>(entities[i])).x == i);
+		}
+	}
+
+	SUBCASE("split components can't be bound or shared")
+	{
+		CHECK_THROWS(world.bind<Particle>(entities[0], entities[1]));
+		CHECK_THROWS(world.share<Particle>(entities[0], entities[1]));
+	}
+
+	SUBCASE("owning groups expose each field as a column")
+	{
+		using System = Archetype<Own<Particle>>;
+		auto[particles] = world.columns<System>();
+		std::span<float> x = particles.field<&Particle::x>();
+		std::span<const float> speed = std::as_const(particles).field<&Particle::speed>();
+		REQUIRE(x.size() == 8);
+		for (std::size_t i = 0; i < x.size(); i++) {
+			x[i] += speed[i];
+		}
+		CHECK(Particle(world.get<const Particle>(entities[4])).x == 5);
+		CHECK(Particle(particles[0]).x == x[0]);
+	}
+
+	SUBCASE("columns mark every value as changed")
+	{
+		using Changes = Archetype<Iterate<Entity>, Changed<Particle>>;
+		for (Entity entity : world.create_many(1200)) {
+			world.update<Particle>(entity, {});
+		}
+		CHECK(world.iterate<Changes>().size() == 1208);
+		CHECK(world.iterate<Changes>().size() == 0);
+		world.columns<Archetype<Own<Particle>>>();
+		CHECK(world.iterate<Changes>().size() == 1208);
+		world.get<Particle>(entities[7])->*&Particle::y = 1;
+		world.remove<Particle>(entities[0]);
+		CHECK(world.iterate<Changes>().size() == 1);
+		world.columns<Archetype<Own<Particle>>>();
+		Checkpoint checkpoint = world.checkpoint();
+		CHECK(world.iterate<Changes>().size() == 1207);
+		world.rollback(checkpoint);
+		CHECK(world.iterate<Changes>().size() == 1207);
+	}
+
+	SUBCASE("split components survive snapshots and rollbacks")
+	{
+		Checkpoint checkpoint = world.checkpoint();
+		world.get<Particle>(entities[0])->*&Particle::x = 9;
+		world.remove<Particle>(entities[1]);
+		world.rollback(checkpoint);
+		CHECK(Particle(world.get<const Particle>(entities[0])).x == 0);
+		CHECK(Particle(world.get<const Particle>(entities[1])).x == 1);
+		SnapshotWriter writer;
+		world.save(writer);
+		ECS::World copy;
+		SnapshotReader reader(writer.data());
+		copy.load(reader);
+		for (int i = 0; i < 8; i++) {
+			CHECK(Particle(copy.get<const Particle>(entities[i])).x == i);
+		}
+	}
+}
+
+TEST_CASE("memory tests")
+{
+	using Buffer = std::pmr::vector<int>;
+
+	SUBCASE("counting resources count the upstream allocations")
+	{
+		CountingResource counting;
+		void* pointer = counting.allocate(64, 8);
+		CHECK(counting.allocations() == 1);
+		CHECK(counting.bytes() == 64);
+		counting.deallocate(pointer, 64, 8);
+		CHECK(counting.deallocations() == 1);
+		CHECK(counting.bytes() == 0);
+	}
+
+	SUBCASE("frame arenas rewind once everything was returned")
+	{
+		CountingResource counting;
+		FrameArena arena(&counting);
+		for (int frame = 0; frame < 4; frame++) {
+			std::vector<void*> pointers;
+			for (int i = 0; i < 100; i++) {
+				pointers.push_back(arena.allocate(100, 16));
+				CHECK(reinterpret_cast<uintptr_t>(pointers.back()) % 16 == 0);
+			}
+			CHECK(arena.live() == 100);
+			uint64_t allocations = counting.allocations();
+			uint64_t deallocations = counting.deallocations();
+			for (void* pointer : pointers) {
+				arena.deallocate(pointer, 100, 16);
+			}
+			// Rewinding doesn't touch the upstream resource.
+			CHECK(counting.allocations() == allocations);
+			CHECK(counting.deallocations() == deallocations);
+		}
+		// The first frame grew the arena, the following ones reused it.
+		CHECK(arena.live() == 0);
+		CHECK(arena.capacity() >= 100 * 100);
+		CHECK(counting.allocations() - counting.deallocations() == 1);
+		uint64_t allocations = counting.allocations();
+		arena.deallocate(arena.allocate(100, 16), 100, 16);
+		CHECK(counting.allocations() == allocations);
+	}
+
+	SUBCASE("storages construct allocator aware values with their pool")
+	{
+		EntityStorage<Buffer> storage;
+		uint64_t key = make_handle(0, 0);
+		storage.update(key, Buffer{1, 2, 3});
+		CHECK(storage[key].get_allocator().resource() == storage.resource());
+		CHECK(storage[key] == Buffer{1, 2, 3});
+		storage.remove(key);
+	}
+
+	SUBCASE("steady frames don't allocate from the heap")
+	{
+		struct Velocity { int value; };
+		struct Moved {};
+		using System = Archetype<Iterate<Position, const Velocity>, Produce<Moved>>;
+		using Cleanup = Archetype<Consume<Moved>>;
+		using Filtered = Archetype<Iterate<Buffer>, Changed<Buffer>>;
+		ECS::World world;
+		std::vector<Entity> entities = world.create_many(1000);
+		for (Entity entity : entities) {
+			world.update<Position>(entity);
+			world.update<Velocity>(entity, {1});
+			world.update<Buffer>(entity, Buffer(8, 0, world.resource<Buffer>()));
+		}
+		auto frame = [&](int round) {
+			for (auto[position, velocity] : world.iterate<System>()) {
+				position.x += velocity.value;
+			}
+			world.iterate<Cleanup>();
+			// Replacing the buffers recycles the old ones through the pool.
+			for (Entity entity : entities) {
+				world.update<Buffer>(entity, Buffer(8, round, world.resource<Buffer>()));
+			}
+			int sum = 0;
+			for (auto[buffer] : world.iterate<Filtered>()) {
+				sum += buffer.front();
+			}
+			CHECK(sum == 1000 * round);
+		};
+		for (int round = 0; round < 3; round++) {
+			frame(round);
+		}
+		uint64_t allocations = world.memory().allocations();
+		for (int round = 3; round < 10; round++) {
+			frame(round);
+		}
+		CHECK(world.memory().allocations() == allocations);
+		CHECK(world.get<Position>(entities.front()).x == 10);
+	}
+}
+
+TEST_CASE("thread pool tests")
+{
+	ThreadPool pool(3);
+
+	SUBCASE("parallel_for visits every element once")
+	{
+		std::vector<std::atomic<int>> visits(10000);
+		pool.parallel_for(visits.size(), 64, [&](uint64_t begin, uint64_t end) {
+			for (uint64_t i = begin; i < end; i++) {
+				visits[i]++;
+			}
+		});
+		CHECK(std::all_of(visits.begin(), visits.end(), [](auto& v) { return v == 1; }));
+	}
+
+	SUBCASE("tasks can run nested batches")
+	{
+		std::atomic<int> counter = 0;
+		std::vector<ThreadPool::Task> tasks;
+		for (int i = 0; i < 8; i++) {
+			tasks.push_back([&]{
+				pool.parallel_for(100, 10, [&](uint64_t begin, uint64_t end) {
+					counter += static_cast<int>(end - begin);
+				});
+			});
+		}
+		pool.run(std::move(tasks));
+		CHECK(counter == 800);
+	}
+
+	SUBCASE("exceptions are rethrown after the batch")
+	{
+		std::atomic<int> counter = 0;
+		std::vector<ThreadPool::Task> tasks;
+		tasks.push_back([]{ throw std::runtime_error("task failed"); });
+		tasks.push_back([&]{ counter++; });
+		CHECK_THROWS(pool.run(std::move(tasks)));
+		CHECK(counter == 1);
+	}
+}
+
+template <typename Archetype>
+concept parallel_iterable = requires {
+	ECS::par_iterate<Archetype>([](auto& ...){});
+};
+
+TEST_CASE("parallel iteration tests")
+{
+	struct Counter { int value; };
+	struct Flag {};
+
+	std::vector<Entity> entities;
+	for (int i = 0; i < 5000; i++) {
+		Entity entity = ECS::create();
+		ECS::update<Counter>(entity, {i});
+		if (i % 2 == 0) {
+			ECS::update<Position>(entity, {0, 0, 0});
+		}
+		entities.push_back(entity);
+	}
+
+	SUBCASE("each matching entity is visited once")
+	{
+		using System = Archetype<Iterate<Counter, Position>>;
+		ECS::par_iterate<System>([](Counter& counter, Position& position) {
+			position.x += counter.value;
+		}, 100);
+		for (int i = 0; i < 5000; i += 2) {
+			CHECK(ECS::get<Position>(entities[i]).x == i);
+		}
+	}
+
+	SUBCASE("structural archetypes are rejected")
+	{
+		static_assert(parallel_iterable<Archetype<Iterate<Counter>, Require<Flag>>>);
+		static_assert(!parallel_iterable<Archetype<Iterate<Counter>, Consume<Flag>>>);
+		static_assert(!parallel_iterable<Archetype<Iterate<Counter>, Produce<Flag>>>);
+	}
+
+	for (Entity entity : entities) {
+		ECS::remove<Entity>(entity);
+	}
+}
+
+TEST_CASE("world tests")
+{
+	struct Health { int value; };
+
+	SUBCASE("worlds don't share entities or components")
+	{
+		ECS::World first;
+		ECS::World second;
+		Entity a = first.create();
+		Entity b = second.create();
+		first.update<Health>(a, {1});
+		CHECK(first.has<Health>(a));
+		CHECK(!second.has<Health>(b));
+		CHECK(!ECS::has<Health>(a));
+		first.remove<Entity>(a);
+		CHECK(!first.alive(a));
+		CHECK(second.alive(b));
+	}
+
+	SUBCASE("worlds have independent families and commands")
+	{
+		ECS::World world;
+		Entity parent = world.create();
+		Entity child = world.create(parent);
+		CHECK(world.get<Family>(child).get_root() == parent);
+		world.commands().update<Health>(child, {2});
+		ECS::flush();
+		CHECK(!world.has<Health>(child));
+		world.flush();
+		CHECK(world.get<Health>(child).value == 2);
+		world.remove<Entity>(parent);
+		CHECK(!world.alive(child));
+	}
+
+	SUBCASE("worlds run on separate threads")
+	{
+		std::vector<std::thread> threads;
+		std::vector<int> sums(4);
+		for (int t = 0; t < 4; t++) {
+			threads.emplace_back([&sums, t] {
+				ECS::World world;
+				for (Entity entity : world.create_many(1000)) {
+					world.update<Health>(entity, {t});
+				}
+				using System = Archetype<Iterate<Health>>;
+				for (int round = 0; round < 10; round++) {
+					for (auto[health] : world.iterate<System>()) {
+						sums[t] += health.value;
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		CHECK(sums == std::vector<int>{0, 10000, 20000, 30000});
+	}
+}
+
+TEST_CASE("bulk creation tests")
+{
+	struct Health { int value; };
+	struct Flag {};
+
+	Entity parent = ECS::create();
+	std::vector<Entity> entities = ECS::create_many(100, parent);
+	REQUIRE(entities.size() == 100);
+	CHECK(ECS::get<Family>(parent).get_children().size() == 100);
+
+	SUBCASE("created entities behave like single ones")
+	{
+		for (Entity entity : entities) {
+			CHECK(ECS::alive(entity));
+			CHECK(ECS::get<Entity>(entity) == entity);
+			CHECK(ECS::get<Family>(entity).get_parent() == parent);
+		}
+		CHECK(std::set<Entity>(entities.begin(), entities.end()).size() == 100);
+	}
+
+	SUBCASE("components are updated in bulk")
+	{
+		std::vector<Health> healths;
+		for (int i = 0; i < 100; i++) {
+			healths.push_back({i});
+		}
+		ECS::update<Health>(entities[7], {-1});
+		ECS::update_many<Health>(entities, healths);
+		ECS::update_many<Flag>(std::span(entities).first(10));
+		for (int i = 0; i < 100; i++) {
+			CHECK(ECS::get<Health>(entities[i]).value == i);
+			CHECK(ECS::has<Flag>(entities[i]) == (i < 10));
+		}
+		using System = Archetype<Iterate<Health>, Require<Flag>>;
+		CHECK(ECS::iterate<System>().size() == 10);
+	}
+
+	SUBCASE("bulk updates insert repeated entities once")
+	{
+		using System = Archetype<Iterate<Entity, const Health>>;
+		ECS::prepare<System>();
+		std::vector<Entity> repeated = {entities[0], entities[1], entities[0]};
+		std::vector<Health> healths = {{1}, {2}, {3}};
+		ECS::update_many<Health>(repeated, healths);
+		CHECK(ECS::iterate<System>().size() == 2);
+		CHECK(ECS::get<Health>(entities[0]).value == 3);
+		CHECK(ECS::has<Entity, Health>(entities[1]));
+		CHECK(!ECS::has<Entity, Health>(entities[2]));
+		CHECK_THROWS(ECS::update_many<Health>(entities, healths));
+		CHECK(!ECS::has<Health>(entities[2]));
+	}
+
+	SUBCASE("bulk created children keep the order of single ones")
+	{
+		std::vector<Entity> children = ECS::create_many(3, entities[0]);
+		std::vector<Entity> order;
+		for (Entity child : ECS::get<Family>(entities[0]).get_children()) {
+			order.push_back(child);
+		}
+		CHECK(order == std::vector<Entity>(children.rbegin(), children.rend()));
+		CHECK(ECS::hierarchy().depth(children[0].value()) == 2);
+	}
+
+	ECS::remove<Entity>(parent);
+	for (Entity entity : entities) {
+		CHECK(!ECS::alive(entity));
+	}
+}
+
+TEST_CASE("command buffer tests")
+{
+	struct Health { int value; };
+	struct Flag {};
+
+	SUBCASE("commands are applied when flushing")
+	{
+		Entity entity = ECS::create();
+		ECS::commands().update<Health>(entity, {5});
+		ECS::commands().update<Flag>(entity);
+		CHECK(!ECS::has<Health>(entity));
+		ECS::flush();
+		CHECK(ECS::get<Health>(entity).value == 5);
+		CHECK(ECS::has<Flag>(entity));
+		ECS::commands().remove<Flag>(entity);
+		ECS::flush();
+		CHECK(!ECS::has<Flag>(entity));
+		ECS::remove<Entity>(entity);
+	}
+
+	SUBCASE("changes to the same component keep their order")
+	{
+		Entity entity = ECS::create();
+		ECS::commands().update<Health>(entity, {1});
+		ECS::commands().remove<Health>(entity);
+		ECS::commands().update<Health>(entity, {2});
+		ECS::flush();
+		CHECK(ECS::get<Health>(entity).value == 2);
+		ECS::remove<Entity>(entity);
+	}
+
+	SUBCASE("reserved entities are created when flushing")
+	{
+		Entity parent = ECS::create();
+		Entity entity = ECS::commands().create(parent);
+		ECS::commands().update<Health>(entity, {3});
+		CHECK(ECS::alive(entity));
+		CHECK(!ECS::has<Entity>(entity));
+		ECS::flush();
+		CHECK(ECS::get<Entity>(entity) == entity);
+		CHECK(ECS::get<Family>(entity).get_parent() == parent);
+		CHECK(ECS::get<Health>(entity).value == 3);
+		ECS::remove<Entity>(parent);
+		CHECK(!ECS::alive(entity));
+	}
+
+	SUBCASE("reserved parents may be merged after their children")
+	{
+		CommandBuffer first(ECS::world());
+		CommandBuffer second(ECS::world());
+		Entity parent = second.create();
+		Entity child = first.create(parent);
+		Entity grandchild = first.create(child);
+		first.append(second);
+		first.apply();
+		CHECK(ECS::get<Family>(child).get_parent() == parent);
+		CHECK(ECS::get<Family>(grandchild).get_parent() == child);
+		ECS::remove<Entity>(parent);
+		CHECK(!ECS::alive(grandchild));
+	}
+
+	SUBCASE("destroyed entities lose all components")
+	{
+		Entity entity = ECS::create();
+		ECS::commands().destroy(entity);
+		ECS::commands().update<Health>(entity, {4});
+		ECS::flush();
+		CHECK(!ECS::alive(entity));
+		CHECK(!ECS::has<Health>(entity));
+	}
+
+	SUBCASE("destroyed sub-trees may overlap")
+	{
+		uint64_t size = ECS::hierarchy().size();
+		Entity parent = ECS::create();
+		Entity child = ECS::create(parent);
+		Entity grandchild = ECS::create(child);
+		ECS::update<Flag>(grandchild);
+		ECS::commands().destroy(child);
+		ECS::commands().destroy(parent);
+		ECS::commands().destroy(grandchild);
+		ECS::flush();
+		CHECK(!ECS::alive(parent));
+		CHECK(!ECS::alive(child));
+		CHECK(!ECS::alive(grandchild));
+		CHECK(!ECS::has<Flag>(grandchild));
+		CHECK(ECS::hierarchy().size() == size);
+	}
+
+	SUBCASE("commands are recorded in parallel")
+	{
+		std::vector<Entity> entities;
+		for (int i = 0; i < 5000; i++) {
+			Entity entity = ECS::create();
+			ECS::update<Health>(entity, {i});
+			entities.push_back(entity);
+		}
+		using System = Archetype<Iterate<Entity, Health>>;
+		ECS::par_iterate<System>([](Entity& entity, Health& health) {
+			if (health.value % 2 == 0) {
+				ECS::commands().update<Flag>(entity);
+			} else {
+				ECS::commands().destroy(entity);
+			}
+		}, 100);
+		ECS::flush();
+		for (int i = 0; i < 5000; i++) {
+			CHECK(ECS::alive(entities[i]) == (i % 2 == 0));
+			CHECK(ECS::has<Flag>(entities[i]) == (i % 2 == 0));
+			ECS::remove<Entity>(entities[i]);
+		}
+	}
+}
+
+TEST_CASE("scheduler tests")
+{
+	struct Velocity { int value; };
+	struct Mass { int value; };
+	struct Flag {};
+
+	using MoveSystem = Archetype<Iterate<Position, const Velocity>>;
+	using ReadSystem = Archetype<Iterate<const Position, const Velocity>>;
+	using MassSystem = Archetype<Iterate<Mass, const Velocity>>;
+	using FlagSystem = Archetype<Iterate<const Mass>, Consume<Flag>>;
+	Scheduler scheduler;
+
+	SUBCASE("systems that only read share a stage")
+	{
+		scheduler.add<ReadSystem>([]{});
+		scheduler.add<ReadSystem>([]{});
+		CHECK(scheduler.get_stages().size() == 1);
+		CHECK(scheduler.get_stages()[0].size() == 2);
+	}
+
+	SUBCASE("systems that write disjoint components share a stage")
+	{
+		scheduler.add<MoveSystem>([]{});
+		scheduler.add<MassSystem>([]{});
+		scheduler.add<ReadSystem>([]{});
+		REQUIRE(scheduler.get_stages().size() == 2);
+		CHECK(scheduler.get_stages()[0] == std::vector<uint64_t>{0, 1});
+		CHECK(scheduler.get_stages()[1] == std::vector<uint64_t>{2});
+	}
+
+	SUBCASE("structural systems are exclusive")
+	{
+		struct Other {};
+		scheduler.add<MassSystem>([]{});
+		scheduler.add<FlagSystem>([]{});
+		scheduler.add<Archetype<Iterate<const Velocity>, Consume<Other>>>([]{});
+		scheduler.add<ReadSystem>([]{});
+		REQUIRE(scheduler.get_stages().size() == 4);
+		CHECK(scheduler.get_stages()[1] == std::vector<uint64_t>{1});
+		CHECK(scheduler.get_stages()[2] == std::vector<uint64_t>{2});
+	}
+
+	SUBCASE("entity resources are exclusive")
+	{
+		scheduler.add<ReadSystem>([]{});
+		scheduler.add<Resource<Entity>>([]{});
+		scheduler.add<MassSystem>([]{});
+		CHECK(scheduler.get_stages().size() == 3);
+	}
+
+	SUBCASE("shared resources are ordered")
+	{
+		scheduler.add<ReadSystem, Resource<Flag>>([]{});
+		scheduler.add<MassSystem, Resource<Flag>>([]{});
+		CHECK(scheduler.get_stages().size() == 2);
+	}
+
+	SUBCASE("running behaves like running in order")
+	{
+		Entity entity = ECS::create();
+		ECS::update<Position>(entity, {0, 0, 0});
+		ECS::update<Velocity>(entity, {2});
+		ECS::update<Mass>(entity, {1});
+		int reads = 0;
+		scheduler.add<MoveSystem>([]{
+			for (auto[position, velocity] : ECS::iterate<MoveSystem>()) {
+				position.x += velocity.value;
+			}
+		});
+		scheduler.add<MassSystem>([]{
+			for (auto[mass, velocity] : ECS::iterate<MassSystem>()) {
+				mass.value *= velocity.value;
+			}
+		});
+		scheduler.add<ReadSystem>([&]{
+			for (auto[position, velocity] : ECS::iterate<ReadSystem>()) {
+				reads += position.x;
+			}
+		});
+		scheduler.run();
+		scheduler.run();
+		CHECK(ECS::get<Position>(entity).x == 4);
+		CHECK(ECS::get<Mass>(entity).value == 4);
+		CHECK(reads == 6);
+		ECS::remove<Entity>(entity);
+	}
+
+	SUBCASE("systems that only read owning groups share a stage")
+	{
+		using GroupSystem = Archetype<Own<const Mass, const Velocity>>;
+		ECS::World world;
+		Scheduler local(world);
+		Entity entity = world.create();
+		world.update<Mass>(entity, {3});
+		world.update<Velocity>(entity, {2});
+		std::atomic<int> sum = 0;
+		auto system = [&]{
+			for (auto[mass, velocity] : world.iterate<GroupSystem>()) {
+				sum += mass.value * velocity.value;
+			}
+		};
+		local.add<GroupSystem>(system);
+		local.add<GroupSystem>(system);
+		REQUIRE(local.get_stages().size() == 1);
+		Checkpoint checkpoint = world.checkpoint();
+		world.remove<Mass>(entity);
+		world.rollback(checkpoint);
+		local.run();
+		CHECK(sum == 12);
+	}
+
+	SUBCASE("systems sharing a filtered archetype see every change")
+	{
+		using ChangedSystem = Archetype<Iterate<Entity>, Changed<Position>>;
+		Entity entity = ECS::create();
+		ECS::update<Position>(entity, {0, 0, 0});
+		std::atomic<int> first = 0;
+		std::atomic<int> second = 0;
+		scheduler.add<ChangedSystem>([&]{ first += ECS::iterate<ChangedSystem>().size(); });
+		scheduler.add<ChangedSystem>([&]{ second += ECS::iterate<ChangedSystem>().size(); });
+		REQUIRE(scheduler.get_stages().size() == 1);
+		scheduler.run();
+		ECS::get<Position>(entity).x = 1;
+		scheduler.run();
+		scheduler.run();
+		CHECK(first == 2);
+		CHECK(second == 2);
+		CHECK(ECS::iterate<ChangedSystem>().size() == 1);
+		ECS::remove<Entity>(entity);
+	}
+}
+
+TEST_CASE("statistics tests")
+{
+	struct Velocity { int value; };
+	struct Flag {};
+	using MoveSystem = Archetype<Iterate<Position, const Velocity>, Exclude<Flag>>;
+	ECS::World world;
+	std::vector<Entity> entities = world.create_many(4);
+	for (Entity entity : entities) {
+		world.update<Position>(entity, {});
+		world.update<Velocity>(entity, {1});
+	}
+	world.bind<Velocity>(entities[0], entities[1]);
+	world.update<Flag>(entities[3]);
+
+	auto find = [](const auto& elements, std::string_view part) {
+		return std::ranges::find_if(elements, [&](const auto& element) {
+			return element.name.find(part) != std::string_view::npos;
+		});
+	};
+
+	SUBCASE("storages report their keys and memory")
+	{
+		Statistics statistics = world.statistics();
+		auto velocity = find(statistics.storages, "Velocity");
+		REQUIRE(velocity != statistics.storages.end());
+		CHECK(velocity->keys == 4);
+		CHECK(velocity->values == 3);
+		CHECK(velocity->capacity >= 3);
+		CHECK(velocity->bytes >= 3 * sizeof(Velocity));
+		CHECK(velocity->load_factor > 0);
+		auto flag = find(statistics.storages, "Flag");
+		REQUIRE(flag != statistics.storages.end());
+		CHECK(flag->keys == 1);
+		CHECK(flag->values == 0);
+	}
+
+	SUBCASE("queries count their searches and changes")
+	{
+		world.prepare<MoveSystem>();
+		world.reset_statistics();
+		world.iterate<MoveSystem>();
+		world.iterate<MoveSystem>();
+		world.remove<Flag>(entities[3]);
+		world.remove<Position>(entities[0]);
+		world.remove<Position>(entities[1]);
+		Statistics statistics = world.statistics();
+		auto query = find(statistics.queries, "Flag");
+		REQUIRE(query != statistics.queries.end());
+		CHECK(query->matches == 2);
+		CHECK(query->searches == 2);
+		CHECK(query->inserted == 1);
+		CHECK(query->removed == 2);
+		world.reset_statistics();
+		CHECK(find(world.statistics().queries, "Flag")->searches == 0);
+	}
+
+	SUBCASE("schedulers time their systems")
+	{
+		Scheduler scheduler(world);
+		scheduler.add<MoveSystem>([&] {
+			for (auto[position, velocity] : world.iterate<MoveSystem>()) {
+				position.x += velocity.value;
+			}
+		});
+		scheduler.run();
+		scheduler.run();
+		std::vector<SystemStats> systems = scheduler.statistics();
+		REQUIRE(systems.size() == 1);
+		CHECK(systems[0].runs == 2);
+		CHECK(systems[0].name.find("Velocity") != std::string_view::npos);
+		scheduler.reset_statistics();
+		CHECK(scheduler.statistics()[0].runs == 0);
+	}
+
+	SUBCASE("statistics are written as json")
+	{
+		Statistics statistics;
+		statistics.storages.push_back({"Quote\"", 1, 1, 2, 8, 0.5});
+		statistics.systems.push_back({"System", 3, 40});
+		std::ostringstream stream;
+		write_json(stream, statistics);
+		CHECK(stream.str() == "{\"storages\":[{\"name\":\"Quote\\\"\",\"keys\":1,\"values\":1,"
+			"\"capacity\":2,\"bytes\":8,\"load_factor\":0.5}],\"queries\":[],"
+			"\"systems\":[{\"name\":\"System\",\"runs\":3,\"nanoseconds\":40}]}");
+	}
+}
+
 TEST_CASE("family tests")
 {
 	Entity invalid;
@@ -415,4 +2190,60 @@ TEST_CASE("family tests")
 		CHECK(childFamilyB.get_siblings().size() == 1);
 		CHECK(childFamilyB.get_children().size() == 0);
 	}
+
+	SUBCASE("changing the parent moves the sub-tree")
+	{
+		Entity a = ECS::create();
+		Entity b = ECS::create();
+		Entity child = ECS::create(a);
+		Entity grandchild = ECS::create(child);
+		CHECK(ECS::get<Family>(grandchild).get_depth() == 2);
+
+		ECS::get<Family>(b).set_parent(grandchild);
+		CHECK(ECS::get<Family>(b).get_root() == a);
+		CHECK(ECS::get<Family>(b).get_depth() == 3);
+
+		ECS::get<Family>(child).set_parent(b);
+		CHECK(ECS::get<Family>(child).get_parent() == a);
+		ECS::get<Family>(child).set_parent();
+		CHECK(ECS::get<Family>(a).get_children().empty());
+		CHECK(ECS::get<Family>(b).get_root() == child);
+		CHECK(ECS::get<Family>(b).get_depth() == 2);
+		ECS::remove<Entity>(a);
+		ECS::remove<Entity>(child);
+		CHECK(!ECS::alive(b));
+	}
+
+	SUBCASE("removed children leave their parent")
+	{
+		Entity parent = ECS::create();
+		std::vector<Entity> children = ECS::create_many(3, parent);
+		ECS::remove<Entity>(children[1]);
+		std::set<Entity> remaining;
+		for (Entity child : ECS::get<Family>(parent).get_children()) {
+			remaining.insert(child);
+		}
+		CHECK(remaining == std::set<Entity>{children[0], children[2]});
+		CHECK(ECS::get<Family>(children[0]).get_siblings().size() == 1);
+		ECS::remove<Entity>(parent);
+		CHECK(!ECS::alive(children[2]));
+	}
+
+	SUBCASE("ordered traversal visits parents first")
+	{
+		ECS::World world;
+		Entity root = world.create();
+		Entity child = world.create(root);
+		Entity grandchild = world.create(child);
+		world.get<Family>(root).set_parent(world.create());
+		std::vector<uint64_t> order;
+		for (uint64_t key : world.hierarchy().ordered()) {
+			order.push_back(key);
+		}
+		CHECK(order.size() == 4);
+		for (uint64_t i = 1; i < order.size(); i++) {
+			CHECK(world.hierarchy().depth(order[i - 1]) <= world.hierarchy().depth(order[i]));
+		}
+		CHECK(order.back() == grandchild.value());
+	}
 };